@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace g1_tinyshell
+{
+
+// Brace expansion of one word: `pre{a,b}post` alternatives (which may nest) and
+// `{x..y[..step]}` integer or letter ranges. The word is parsed once into a small tree and
+// the N-th result is computed directly from N, so results can be generated one at a time
+// in constant memory (`for i in {1..100000000}`) or counted up front to size a vector.
+class BraceExpansion
+{
+public:
+    explicit BraceExpansion(const std::string& word);
+
+    // False if the word has no valid brace group (it expands to itself).
+    bool hasGroups() const;
+
+    // Number of words the expansion produces (saturates at UINT64_MAX).
+    uint64_t size() const;
+
+    // Writes the next word into `word`, reusing its buffer. Returns false after the last one.
+    bool next(std::string& word);
+
+    // Applies `transform` to every literal fragment once (e.g. to expand variables before
+    // generating). Returns false as soon as `transform` does.
+    template <typename Transform>
+    bool transformText(Transform transform)
+    {
+        for (Node& node : m_nodes)
+        {
+            if (node.kind == NodeKind::Text && !transform(node.text))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Cheap check for a '{' followed by a '}' (used before paying for a parse).
+    static bool mayHaveBraces(const std::string& word);
+
+private:
+    enum class NodeKind
+    {
+        Text,
+        Sequence,    // Parts concatenated in order
+        Alternation, // One Sequence per comma-separated option
+        Range
+    };
+
+    struct Node
+    {
+        NodeKind kind = NodeKind::Text;
+        std::string text;              // Text
+        std::vector<size_t> children;  // Sequence parts / Alternation options (indices into m_nodes)
+        std::vector<uint64_t> offsets; // Sequence: stride of each part; Alternation: first index of each option
+        int64_t range_start = 0;
+        uint64_t range_step = 1;
+        bool range_descending = false;
+        bool range_is_char = false;
+        size_t range_width = 0;        // Zero-padded width for `{01..10}`, 0 for none
+        uint64_t count = 1;
+    };
+
+    std::vector<Node> m_nodes;
+    size_t m_root;
+    bool m_hasGroups;
+    uint64_t m_nextIndex;
+
+    size_t parseSequence(const std::string& word, size_t begin, size_t end);
+    size_t parseGroup(const std::string& word, size_t open_pos, size_t close_pos,
+                      const std::vector<size_t>& comma_positions);
+    bool parseRange(const std::string& body, Node& node) const;
+    void appendWord(size_t node_index, uint64_t index, std::string& word) const;
+};
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace g1_tinyshell
+{
+
+// Name of the make-style dependency file (gcc -MD -MF) a build step may leave in its staging
+// directory. store() turns it into the entry's manifest of headers to revalidate.
+constexpr const char* K_BuildDependencyFile = "deps.d";
+
+// Content-addressed cache of compiler outputs for the `c` and `cpp` builtins.
+// An entry is a directory named after a key: a hash of everything that determines the output
+// (source contents, compiler identity and version, flags). Entries are built in a private
+// staging directory and published with rename(), so concurrent shells never see half an
+// entry. Each records the headers the compiler read (size, mtime and content hash), and
+// find() treats an entry whose headers changed as a miss. Entries are evicted least recently
+// used once the cache exceeds K_MaxBuildCacheBytes; a hit refreshes the entry's mtime.
+// The cache lives in $TINYSHELL_BUILD_CACHE, else $XDG_CACHE_HOME/tinyshell/build, else
+// ~/.cache/tinyshell/build.
+class BuildCache
+{
+public:
+    // Produces the entry's files in `staging_directory`; returns false (setting `error` if
+    // there is more to say than the compiler already printed) on failure.
+    using BuildStep = std::function<bool(const std::string& staging_directory, std::string& error)>;
+
+    static BuildCache& instance();
+
+    // Identity of the compiler `name` as found in PATH: resolved path, size, mtime and its
+    // `--version` banner (run once per shell). Empty if it is not found.
+    std::string compilerIdentity(const std::string& name);
+
+    // 32 hex digits. hashFile() returns an empty string (errno set) if the file is unreadable.
+    static std::string hashFile(const std::string& path);
+    static std::string hashStrings(const std::vector<std::string>& parts);
+
+    // Directory of the valid entry for `key`, marked as recently used; empty on a miss.
+    std::string find(const std::string& key);
+
+    // Runs `build` and publishes its output as the entry for `key`, replacing a stale one,
+    // then evicts old entries. Returns the entry directory, or empty with `error` set.
+    std::string store(const std::string& key, const BuildStep& build, std::string& error);
+
+    BuildCache(const BuildCache&) = delete;
+    BuildCache& operator=(const BuildCache&) = delete;
+
+private:
+    BuildCache();
+
+    std::string m_directory;
+    std::mutex m_mutex; // Guards m_compilerIdentities and eviction
+    std::unordered_map<std::string, std::string> m_compilerIdentities; // Keyed by path, size and mtime
+
+    bool ensureDirectory(std::string& error);
+    void evictUntilWithinLimit();
+};
+
+}
@@ -26,6 +26,18 @@ public:
     static std::string getHelpText(BuiltinCommandType type);
     static std::string listBuiltins();
 
+    // Names of the built-in commands, sorted (for completion).
+    static std::vector<std::string> getBuiltinNames();
+
+    // Splits a line read by `read` into the named variables: fields are separated by blanks and
+    // the last variable gets the rest of the line. Unless `raw`, a backslash quotes the next character.
+    static void assignReadFields(const std::string& line, const std::vector<std::string>& variable_names,
+                                 bool raw, Environment& environment);
+
+    // Parses `read` options (-r) and variable names; defaults to REPLY. Returns an error message or "".
+    static std::string parseReadArguments(const std::vector<std::string>& args, bool& raw,
+                                          std::vector<std::string>& variable_names);
+
 private:
     // --- Individual Built-in Implementations ---
     // Each returns an ExecutionResult.
@@ -42,6 +54,7 @@ private:
     static ExecutionResult builtinLs(const std::vector<std::string>& args);
     static ExecutionResult builtinMkdir(const std::vector<std::string>& args);
     static ExecutionResult builtinRm(const std::vector<std::string>& args);
+    static ExecutionResult builtinCp(const std::vector<std::string>& args);
     static ExecutionResult builtinCat(const std::vector<std::string>& args);
     static ExecutionResult builtinPath(const Environment& environment);
     static ExecutionResult builtinAddPath(const std::vector<std::string>& args, Environment& environment); // Conceptual
@@ -49,10 +62,13 @@ private:
     static ExecutionResult builtinCpp(const std::vector<std::string>& args);
     static ExecutionResult builtinHistory(const std::vector<std::string>& args, const ShellCore& shell_core);
     static ExecutionResult builtinTest(const std::vector<std::string>& args);
+    static ExecutionResult builtinRead(const std::vector<std::string>& args, Environment& environment, LineReader* input_reader);
+    static ExecutionResult builtinMapfile(const std::vector<std::string>& args, Environment& environment, LineReader* input_reader);
+    static ExecutionResult builtinPrintf(const std::vector<std::string>& args, Environment& environment);
     // static ExecutionResult builtinCatSpin(); // Optional
 
     // Helper for C/CPP compilation and execution
-    static ExecutionResult compileAndRun(const std::string& compiler, const std::string& source_file, const std::vector<std::string>& args);
+    static ExecutionResult compileAndRun(const std::string& compiler, const std::vector<std::string>& args);
 
     // Helper for test command expressions
     static bool evaluateTestExpression(const std::vector<std::string>& expression, std::string& error_msg);
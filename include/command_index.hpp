@@ -0,0 +1,84 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace g1_tinyshell
+{
+
+// Prefix tree of command names. Children are kept sorted, so completions come out in order.
+class CommandTrie
+{
+public:
+    CommandTrie();
+
+    void insert(const std::string& word);
+
+    // Appends the words starting with `prefix`, sorted.
+    void complete(const std::string& prefix, std::vector<std::string>& matches) const;
+
+    size_t size() const;
+
+private:
+    struct Node
+    {
+        std::vector<std::pair<char, uint32_t>> children;
+        bool terminal = false;
+    };
+
+    std::vector<Node> m_nodes; // 0 is the root
+    size_t m_wordCount;
+
+    void collect(uint32_t node, std::string& word, std::vector<std::string>& matches) const;
+};
+
+// The executables on $PATH, for command completion. A background thread reads the PATH
+// directories into a CommandTrie and publishes it; when asked to refresh, it rebuilds the trie
+// only if $PATH or the mtime of one of its directories changed. Readers take the published
+// trie and never wait for a directory scan.
+class CommandIndex
+{
+public:
+    CommandIndex(); // Starts the first build
+    ~CommandIndex();
+
+    CommandIndex(const CommandIndex&) = delete;
+    CommandIndex& operator=(const CommandIndex&) = delete;
+
+    // The latest trie (empty until the first build is done).
+    std::shared_ptr<const CommandTrie> snapshot() const;
+
+    // Wakes the thread to check for changes; returns at once.
+    void requestRefresh();
+
+private:
+    struct ScannedDirectory
+    {
+        std::string path;
+        struct timespec modification_time;
+    };
+
+    mutable std::mutex m_mutex; // Guards the next four
+    std::condition_variable m_wakeup;
+    bool m_refreshRequested;
+    bool m_stopping;
+    std::shared_ptr<const CommandTrie> m_trie;
+
+    // Used by the thread only: what the published trie was built from
+    std::string m_scannedPath;
+    std::vector<ScannedDirectory> m_scanned;
+    std::thread m_thread;
+
+    void run();
+    bool isUpToDate(const std::string& path_variable) const;
+    void rebuild(const std::string& path_variable);
+};
+
+}
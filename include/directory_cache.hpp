@@ -0,0 +1,84 @@
+#pragma once
+
+#include "globbing.hpp" // DirectoryEntry
+#include <cstddef>
+#include <ctime>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/types.h>
+
+namespace g1_tinyshell
+{
+
+// Process-wide cache of directory listings, shared by globbing, `ls` and completion.
+// Entries are keyed by the directory's (device, inode), so relative paths stay valid after `cd`.
+// Every lookup compares the directory's mtime. While an inotify watch is held on a directory,
+// its listing is also dropped when an event reports a change, which catches changes within
+// the mtime's granularity. Watches are capped (K_MaxDirectoryWatches); listings without one
+// are only trusted once their mtime is older than the read. Listings are evicted least-recently-used.
+// A forked child starts over with its own inotify instance, so it never drains the parent's events.
+class DirectoryCache
+{
+public:
+    using EntryList = std::vector<DirectoryEntry>;
+
+    static DirectoryCache& instance();
+
+    // Returns the entries of the directory at `path` (except "." and ".."), or nullptr if it
+    // cannot be opened. The returned list stays valid even if the cache later drops it.
+    std::shared_ptr<const EntryList> getEntries(const std::string& path);
+
+    // Drops every cached listing and watch.
+    void clear();
+
+    DirectoryCache(const DirectoryCache&) = delete;
+    DirectoryCache& operator=(const DirectoryCache&) = delete;
+
+private:
+    struct DirectoryKey
+    {
+        dev_t device;
+        ino_t inode;
+        bool operator==(const DirectoryKey& other) const { return device == other.device && inode == other.inode; }
+    };
+
+    struct DirectoryKeyHash
+    {
+        size_t operator()(const DirectoryKey& key) const
+        {
+            return std::hash<unsigned long long>()(static_cast<unsigned long long>(key.inode) * 31 + key.device);
+        }
+    };
+
+    struct CachedListing
+    {
+        std::shared_ptr<const EntryList> entries;
+        struct timespec modification_time;
+        int watch_descriptor; // -1 when validated by mtime only
+        bool trust_mtime;     // False if the listing was read in the same tick the directory changed
+        std::list<DirectoryKey>::iterator lru_position;
+    };
+
+    DirectoryCache();
+    ~DirectoryCache();
+
+    std::mutex m_mutex;
+    int m_inotifyFd;
+    pid_t m_ownerPid; // Process that created m_inotifyFd
+    size_t m_watchCount;
+    size_t m_cachedEntryCount; // Sum of listing sizes, bounded by K_MaxCachedEntries
+    std::unordered_map<DirectoryKey, CachedListing, DirectoryKeyHash> m_listings;
+    std::unordered_map<int, DirectoryKey> m_watchedKeys; // watch descriptor -> listing
+    std::list<DirectoryKey> m_lruOrder;                  // Front = most recently used
+
+    void resetIfForked();
+    void processInotifyEvents();
+    void evictListing(const DirectoryKey& key);
+    void evictUntilWithinLimits();
+};
+
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace g1_tinyshell
+{
+
+// Creates each directory in `paths`, in order. Without `parents` every operand is a single
+// mkdir() and an existing path is an error.
+// With `parents`, missing ancestors are created too and existing directories are accepted.
+// The operands are first merged into a tree of path components, so a prefix they share is
+// walked once: each directory is created with mkdirat() relative to its parent's open
+// descriptor, and only directories with children to create are opened (O_PATH). Creating 10k
+// siblings under one deep root resolves the root once rather than 10k times.
+// Returns one message per failure (empty when every directory exists afterwards).
+std::vector<std::string> make_directories(const std::vector<std::string>& paths, bool parents);
+
+}
@@ -3,7 +3,9 @@
 #include "tinyshell_globals.hpp"
 #include <string>
 #include <map>
+#include <vector>
 #include <optional> // To return optional values for getVar
+#include <memory>   // shared_ptr for copy-on-write variable store
 
 namespace g1_tinyshell
 {
@@ -11,17 +13,46 @@ namespace g1_tinyshell
 class Environment
 {
 public:
+    using ArrayMap = std::map<std::string, std::vector<std::string>>;
+
+    // Immutable view of the variable store taken by takeSnapshot().
+    struct VariableSnapshot
+    {
+        std::shared_ptr<const std::map<std::string, std::string>> variables;
+        std::shared_ptr<const ArrayMap> arrays;
+    };
+
     Environment();
 
-    // Sets or updates an internal shell variable.
+    // Sets or updates an internal shell variable. For an array this sets element 0.
     // Returns true on success, false on invalid variable name.
     bool setVariable(const std::string& variable_name, const std::string& value);
 
-    // Gets the value of an internal shell variable.
+    // Gets the value of an internal shell variable (element 0 for an array).
     // Returns the value if found, std::nullopt otherwise.
     std::optional<std::string> getVariable(const std::string& variable_name) const;
 
-    // Removes an internal shell variable.
+    // Appends `suffix` to the stored value in place, so the existing content is never copied
+    // (capacity grows geometrically). An unset variable starts from its system environment
+    // value, if any. For an array this appends to element 0.
+    bool appendToVariable(const std::string& variable_name, const std::string& suffix);
+
+    // Makes `variable_name` an indexed array holding `values` (replacing any scalar of that name).
+    // Arrays are dense: elements live in one contiguous vector.
+    bool setArray(const std::string& variable_name, std::vector<std::string> values);
+
+    // Sets one array element, filling any gap with empty elements. A scalar of the same name
+    // becomes element 0 first. With `append`, `value` is added to the end of the element instead.
+    bool setArrayElement(const std::string& variable_name, size_t index, const std::string& value, bool append = false);
+
+    // Adds elements to the end of an array (a scalar of the same name becomes element 0 first).
+    bool appendToArray(const std::string& variable_name, const std::vector<std::string>& values);
+
+    // Returns the array named `variable_name`, or nullptr if it is not an array.
+    // The pointer is invalidated by the next modification of the environment.
+    const std::vector<std::string>* getArray(const std::string& variable_name) const;
+
+    // Removes an internal shell variable or array.
     // Returns true if the variable existed and was removed, false otherwise.
     bool unsetVariable(const std::string& variable_name);
 
@@ -31,9 +62,20 @@ public:
     // Validates if a variable name is acceptable.
     static bool isValidVariableName(const std::string& variable_name);
 
+    // Captures the current variable store without copying it. The store is shared
+    // until the next modification, which then copies it once (copy-on-write).
+    VariableSnapshot takeSnapshot() const;
+
+    // Replaces the variable store with a previously taken snapshot.
+    void restoreSnapshot(const VariableSnapshot& snapshot);
+
 private:
-    std::map<std::string, std::string> m_variables;
-    // Could add parent environment pointer for scoping later if needed
+    std::shared_ptr<std::map<std::string, std::string>> m_variables;
+    std::shared_ptr<ArrayMap> m_arrays;
+
+    // Makes m_variables / m_arrays exclusively owned before they are modified.
+    void detachVariables();
+    void detachArrays();
 };
 
 }
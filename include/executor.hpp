@@ -23,6 +23,7 @@ public:
 private:
     Environment& m_environment; // Reference to the shell's environment
     ShellCore& m_shellCore;     // Reference to the shell core for history, exit status etc.
+    LineReader* m_loopInput;    // Input of the innermost `while ... done < file`, read by `read`
 
     // Specific execution handlers for different AST node types
     ExecutionResult executeSimpleCommand(const SimpleCommandNode& node);
@@ -30,6 +31,27 @@ private:
     ExecutionResult executeIfNode(const IfNode& node);
     ExecutionResult executeWhileNode(const WhileNode& node);
     ExecutionResult executeForNode(const ForNode& node);
+    ExecutionResult executeSubshellNode(const SubshellNode& node);
+    ExecutionResult executeAndOrListNode(const AndOrListNode& node);
+    ExecutionResult executeNotNode(const NotNode& node);
+    ExecutionResult executeCaseNode(const CaseNode& node);
+
+    // Runs `for v in <file` / `for v in $(command)`: lines are read through a LineReader one
+    // iteration at a time, so arbitrarily large inputs use constant memory.
+    ExecutionResult executeForLines(const ForNode& node);
+
+    // Runs `while ...; done < file` with `read` reading from the file through a LineReader.
+    // `while read [-r] var...` is driven directly from the reader without running `read`.
+    ExecutionResult executeWhileReadingFile(const WhileNode& node);
+
+    // The condition/body loop shared by both forms of `while`.
+    ExecutionResult runWhileLoop(const WhileNode& node);
+
+    // Runs a subshell body in a forked child, for bodies that need real process isolation.
+    ExecutionResult executeForkedSubshell(const SubshellNode& node);
+
+    // True if the node only runs builtins that can be undone by restoring variables and cwd.
+    static bool canRunInProcess(const AstNodePtr& node);
 
     // Helper to execute external commands
     ExecutionResult executeExternalCommand(const std::string& command, const std::vector<std::string>& arguments);
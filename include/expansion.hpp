@@ -2,6 +2,8 @@
 
 #include "tinyshell_globals.hpp"
 #include "environment.hpp"
+#include "brace_expansion.hpp"
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -21,7 +23,46 @@ public:
     // Returns true on success, false if an expansion error occurred.
     static bool expandArguments(std::vector<std::string>& arguments, const Environment& environment, std::string& error_message);
 
+    // Brace expansion ({a,b}, {1..N[..step]}) of the words flagged in unquoted_flags, then
+    // variable expansion; a word that is exactly `${name[@]}` becomes one word per element.
+    // unquoted_flags is rewritten to stay parallel to the result.
+    // The expanded words are counted first and stored in one pre-sized allocation.
+    static bool expandArguments(std::vector<std::string>& arguments, std::vector<bool>& unquoted_flags,
+                                const Environment& environment, std::string& error_message);
+
+    // Expands variables in the literal parts of a parsed brace word, once, so its words can
+    // then be generated lazily (used by `for` loops).
+    static bool prepareBraceExpansion(BraceExpansion& brace_expansion, const Environment& environment,
+                                      std::string& error_message);
+
+    // Performs pathname expansion (globbing) on already expanded words.
+    // Words flagged in glob_flags that contain wildcards are replaced by their sorted matches;
+    // a pattern with no matches is kept as-is (like POSIX shells without nullglob).
+    static void expandPathnames(std::vector<std::string>& words, const std::vector<bool>& glob_flags);
+
+    // If `word` is exactly `${name[@]}`, appends one word per array element (none if unset)
+    // and returns true. Otherwise returns false and leaves `words` alone.
+    static bool expandArrayWord(const std::string& word, const Environment& environment, std::vector<std::string>& words);
+
+    // Evaluates an array subscript: a number, `$NAME` or a bare variable name. May be negative.
+    static bool evaluateSubscript(const std::string& subscript, const Environment& environment, long long& index,
+                                  std::string& error_message);
+
+    // Returns the index of the `}` closing the `${` whose '{' is at open_pos (nested `${...}`
+    // and escaped characters are skipped), or npos if it is unclosed.
+    static size_t findParameterEnd(const std::string& text, size_t open_pos);
+
 private:
+    // Expands the text between `${` and `}`: a reference (NAME, NAME[i], NAME[@], ?), its
+    // length (`#`) or a reference followed by an operator: `-`, `+`, `?` (with optional `:`),
+    // `#`/`##` and `%`/`%%` (remove a glob-pattern prefix/suffix), `/p/r` `//p/r` `/#p/r`
+    // `/%p/r` (replace), and `:offset[:length]` (substring). Operands are expanded first.
+    static std::string expandBracedParameter(const std::string& parameter, const Environment& environment,
+                                             std::string& error_message);
+
+    // Value of a NAME, NAME[i] or NAME[@] reference (nullopt if unset), or its length.
+    static std::optional<std::string> lookupParameter(const std::string& reference, bool want_length,
+                                                      const Environment& environment, std::string& error_message);
     // Helper to handle $VAR and ${VAR} syntax within a word.
     static std::string performExpansion(const std::string& word, const Environment& environment, std::string& error_message);
 };
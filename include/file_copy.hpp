@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+
+namespace g1_tinyshell
+{
+
+// Copies everything from source_fd (from its current offset) to destination_fd without
+// passing the data through user space where the kernel allows it:
+// copy_file_range between regular files (server-side or reflink copies on filesystems that
+// support them), splice when either end is a pipe, sendfile from a regular file to anything
+// else, and a 1 MiB read/write loop as the fallback. Each method that reports itself
+// unsupported for this pair of descriptors falls through to the next.
+// Returns false with errno set on failure; bytes_copied counts what was transferred.
+bool copy_descriptor_data(int source_fd, int destination_fd, uint64_t& bytes_copied);
+
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <bitset>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace g1_tinyshell
+{
+
+// A shell wildcard pattern (`*`, `?`, `[...]`, `\x`) compiled once into the runs
+// of fixed-width elements found between its `*`s.
+// Matching never backtracks across a `*`: the first run is anchored at the start,
+// the last at the end, and each middle run takes its leftmost occurrence.
+class GlobPattern
+{
+public:
+    explicit GlobPattern(const std::string& pattern);
+
+    // Returns true if the whole text matches the pattern.
+    bool matches(const std::string& text) const;
+
+    // True if the pattern has no wildcards (it only matches its own unescaped text).
+    bool isLiteral() const;
+
+    // The pattern text with escapes removed; only meaningful when isLiteral().
+    const std::string& getLiteralText() const;
+
+    // True if the first element is a literal '.', i.e. the pattern can match dotfiles.
+    bool startsWithLiteralDot() const;
+
+    // Cheap check for `*`, `?` or `[` (used before paying for a compile).
+    static bool hasWildcards(const std::string& pattern);
+
+    // Backslash-escapes the wildcards, braces and case `|` of quoted text so it only matches
+    // itself. Existing `\x` escapes and `${...}` references are left for variable expansion.
+    // `found` tells whether there was anything to escape.
+    static std::string escape(const std::string& text, bool& found);
+
+    // Drops the escapes escape() adds (a pattern that matched nothing is used as a plain word).
+    static std::string unescape(const std::string& pattern);
+
+private:
+    enum class ElementType
+    {
+        Literal,
+        AnyChar,
+        CharClass
+    };
+
+    struct Element
+    {
+        ElementType type;
+        char literal;       // For ElementType::Literal
+        size_t class_index; // Index into m_charClasses for ElementType::CharClass
+    };
+
+    using Segment = std::vector<Element>;
+
+    std::vector<Segment> m_segments;            // Runs between '*'s (empty runs dropped)
+    std::vector<std::bitset<256>> m_charClasses;
+    bool m_hasStar;
+    bool m_anchoredStart; // Pattern does not start with '*'
+    bool m_anchoredEnd;   // Pattern does not end with '*'
+    bool m_isLiteral;
+    std::string m_literalText;
+
+    bool matchSegmentAt(const Segment& segment, const std::string& text, size_t position) const;
+    bool matchElement(const Element& element, unsigned char c) const;
+    size_t parseCharClass(const std::string& pattern, size_t start_pos); // Returns index past ']' or 0
+};
+
+// Maps a word to the first pattern (by target index) that matches it.
+// Literal patterns are resolved with one hash lookup; wildcard patterns are kept as
+// compiled GlobPatterns and only those ordered before the literal hit are tried.
+class PatternDispatcher
+{
+public:
+    // Registers a pattern that selects `target`. Targets must be added in ascending order.
+    void addPattern(const std::string& pattern, size_t target);
+
+    // Returns the smallest target whose pattern matches the text.
+    std::optional<size_t> find(const std::string& text) const;
+
+private:
+    std::unordered_map<std::string, size_t> m_literalTargets;
+    std::vector<std::pair<GlobPattern, size_t>> m_wildcardTargets;
+};
+
+}
@@ -4,13 +4,26 @@
 #include <string>
 #include <vector>
 
+// One directory entry as reported by getdents64.
+struct DirectoryEntry {
+    std::string name;
+    unsigned char type; // DT_* value from <dirent.h>; DT_UNKNOWN if the filesystem did not say
+};
+
+// Reads every entry of an open directory (except "." and "..") using large getdents64 batches,
+// so a directory costs a handful of syscalls regardless of its size.
+// Returns false if reading failed; entries read so far are kept.
+bool read_directory_entries(int dir_fd, std::vector<DirectoryEntry>& entries);
+
 // Function to perform filename globbing
-// Takes a pattern (potentially with *, ?, [...]) and returns matching filenames.
+// Takes a pattern (potentially with *, ?, [...], and `**` as a whole component for any number
+// of directory levels) and returns matching paths, sorted. `**` subtrees are walked in parallel.
+// Each wildcard component is matched against one directory listing; hidden entries only
+// match patterns that start with a literal '.'. Returns an empty vector if nothing matches.
 std::vector<std::string> perform_globbing(const std::string& pattern);
 
-// Helper function to match a single filename against a pattern (basic implementation)
-// This might not be needed if using FindFirstFile directly with the pattern.
+// Helper function to match a single filename against a pattern.
+// Uses the compiled, non-backtracking matcher from glob_pattern.hpp.
 bool match_pattern(const std::string& text, const std::string& pattern);
 
 #endif // GLOBBING_HPP
-
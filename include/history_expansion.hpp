@@ -0,0 +1,21 @@
+#pragma once
+
+#include "history_store.hpp"
+#include <string>
+
+namespace g1_tinyshell
+{
+
+// Bash-style history expansion of a command line, before it is lexed:
+//   !!            the previous command
+//   !n, !-n       entry n (as numbered by `history`), the n-th previous entry
+//   !prefix       the newest entry starting with prefix
+//   !?text[?]     the newest entry containing text
+//   !$            the last word of the previous command
+//   ^old^new[^]   (at the start of the line) the previous command with its first `old` replaced
+// Nothing expands inside single quotes, after a backslash, in a comment, in `$!` or `${!`, or
+// when the `!` is followed by a blank, `=`, `(`, `"` or the end of the line.
+// Returns false with `error` set when an event is not found; otherwise `expanded` holds the line.
+bool expand_history(const std::string& line, const HistoryStore& history, std::string& expanded, std::string& error);
+
+}
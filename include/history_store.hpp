@@ -0,0 +1,118 @@
+#pragma once
+
+#include "trigram_index.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace g1_tinyshell
+{
+
+// Command history, optionally persisted to an append-only log shared by every shell.
+// Each record is one line, `<unix time>\t<command>\n`, with `\` and newlines in the command
+// escaped. A record is appended with a single O_APPEND write(), so concurrent shells
+// interleave whole records. At startup the file is mmap()ed and only an index of record
+// offsets is built; commands are decoded when they are read.
+// The history holds each distinct command once, at its last use: running a command again
+// appends a new record and moves the entry to the end.
+// Once the file holds more than 1.25x max_file_entries records, a background thread
+// rewrites it with the newest max_file_entries distinct commands and rename()s it into place.
+// An exclusive flock() on `<file>.lock` keeps appenders out meanwhile, and they reopen the new file.
+// Substring and prefix searches go through a TrigramIndex, built for the loaded file on a
+// background thread (searches scan linearly until it is ready) and updated by every add().
+class HistoryStore
+{
+public:
+    HistoryStore();
+    ~HistoryStore(); // Stops the index builder and waits for a running compaction
+
+    HistoryStore(const HistoryStore&) = delete;
+    HistoryStore& operator=(const HistoryStore&) = delete;
+
+    // Sets the in-memory limit. Without open() the history is not persisted.
+    void setMaxEntries(size_t max_entries);
+
+    // Loads the history file at `path` and appends every later entry to it.
+    // Returns false with errno set if it cannot be read (the history then stays in memory).
+    bool open(const std::string& path, size_t max_file_entries);
+
+    void add(const std::string& command);
+
+    size_t size() const;
+    bool empty() const;
+    std::string at(size_t index) const; // 0 is the oldest entry kept
+    int64_t timestampAt(size_t index) const; // Last use
+
+    // Finds the newest entry before `before` (an index; size() searches everything) that
+    // contains `pattern`. Each call answers one step of an incremental reverse search.
+    bool searchBackward(const std::string& pattern, size_t before, size_t& match) const;
+
+    // The same for entries starting with `prefix` (`!prefix`).
+    bool searchPrefix(const std::string& prefix, size_t before, size_t& match) const;
+
+private:
+    // Open-addressing map from command hash to sequence. With a node per entry,
+    // std::unordered_map made loading a million-entry history several times slower.
+    class CommandTable
+    {
+    public:
+        void reserve(size_t count);
+        // Returns the value stored under `hash`, inserting `value` first if there is none.
+        uint32_t& emplace(uint64_t hash, uint32_t value, bool& inserted);
+        uint32_t* find(uint64_t hash);
+        void erase(uint64_t hash);
+
+    private:
+        std::vector<uint64_t> m_hashes; // 0 marks a free slot
+        std::vector<uint32_t> m_values;
+        size_t m_count = 0;
+        unsigned m_shift = 64; // Slots are chosen by the top bits, which the hash mixes best
+
+        size_t slotOf(uint64_t hash) const;
+    };
+
+    std::string m_path;
+    int m_fd;     // O_APPEND descriptor, -1 when not persisted
+    int m_lockFd; // `<path>.lock`
+    const char* m_map;
+    size_t m_mapSize;
+    std::vector<uint64_t> m_offsets; // Start of each mapped record, plus the end of the last one
+
+    // Entries are numbered by sequence: mapped record r is r, session entry k (counting the
+    // popped ones) is mappedCount() + k. m_live lists the sequences of the history, oldest
+    // first; an entry run again or past the limit leaves it, and its session text is released.
+    std::deque<std::pair<int64_t, std::string>> m_sessionEntries; // Added since the file was loaded
+    size_t m_sessionPopped; // Session entries older than every live one
+    std::deque<uint32_t> m_live;
+    CommandTable m_latest; // Hash of the encoded command -> its sequence
+    size_t m_maxEntries;
+    size_t m_maxFileEntries;
+    size_t m_fileRecords; // As far as this shell knows
+    std::thread m_compaction;
+    std::atomic<bool> m_compacting;
+
+    mutable std::mutex m_indexMutex; // Guards m_index, m_indexReady and (for the builder) m_sessionEntries
+    TrigramIndex m_index;            // Keyed by sequence; an entry run again is removed from it
+    bool m_indexReady;
+    std::vector<uint32_t> m_supersededRecords; // Run again while the index was being built
+    std::atomic<bool> m_stopping;
+    std::thread m_indexBuilder;
+
+    size_t mappedCount() const;
+    std::pair<int64_t, std::string> entry(uint32_t sequence) const;
+    const char* mappedText(uint32_t record, size_t& length, int64_t& timestamp) const;
+    uint64_t entryHash(uint32_t sequence) const;
+    bool entryMatches(uint32_t sequence, const std::string& pattern, bool prefix) const;
+    bool findBackward(const std::string& pattern, bool prefix, size_t before, size_t& match) const;
+    void buildIndex(std::vector<uint32_t> records);
+    void appendRecord(const std::string& record);
+    void startCompaction();
+};
+
+}
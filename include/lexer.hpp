@@ -2,6 +2,7 @@
 
 #include "tinyshell_globals.hpp"
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace g1_tinyshell
@@ -10,7 +11,7 @@ namespace g1_tinyshell
 enum class TokenType
 {
     Word,         // Command or argument
-    Operator,     // e.g., ';', '&&', '||' (future extension)
+    Operator,     // '&&' or '||' (and-or list separators)
     RedirectIn,   // '<'
     RedirectOut,  // '>'
     RedirectAppend,// '>>'
@@ -25,9 +26,15 @@ enum class TokenType
     Done,         // 'done'
     For,          // 'for'
     In,           // 'in'
+    Case,         // 'case'
+    Esac,         // 'esac'
     Semicolon,    // ';'
+    DoubleSemicolon, // ';;' (ends a case clause)
+    LeftParen,    // '(' (subshell start)
+    RightParen,   // ')' (subshell end)
     Background,   // '&' (future extension)
     Variable,     // '$VAR' or '${VAR}' (for expansion phase)
+    CommandSubstitution, // '$(command)' (value is the inner command text)
     Comment,      // '#...'
     EndOfInput,
     Error
@@ -38,6 +45,7 @@ struct Token
     TokenType type;
     std::string value;
     size_t position; // Starting position in the original input line
+    bool quoted = false; // Came from a '...' or "..." string (no pathname expansion)
 };
 
 class Lexer
@@ -51,19 +59,28 @@ private:
     std::string m_input;
     size_t m_currentPosition;
     std::string m_errorMessage;
+    size_t m_previousWordEnd; // Input position just past the last word/variable token
+    std::vector<std::pair<std::string, bool>> m_wordPieces; // Value and `quoted` of each piece of the last word
 
     Token getNextToken();
+    // Appends a token; a word or variable that directly follows another one (no blank between,
+    // as in `a$x` or `pre"quoted"`) is joined with it into one Word. A `$NAME` that the next
+    // piece would extend becomes `${NAME}`. The word is only `quoted` (not globbed) if no
+    // unquoted piece has pattern characters; otherwise those of the quoted pieces are escaped.
+    void pushWordToken(std::vector<Token>& tokens, Token token);
     Token processWord();
-    Token processOperatorOrRedirect(); // Placeholder for future operators
+    Token processOperatorOrRedirect(); // '&&' / '||'; a lone '&' or '|' stays part of a word
     Token processVariable();
+    Token processCommandSubstitution(); // '$(' ... matching ')'
     Token processComment();
-    Token processQuotedString(char quote_char);
+    Token processQuotedString(char quote_char); // Value escapes `$` and `\` that must stay literal
 
     char peek() const;
     char advance();
     bool isAtEnd() const;
     bool isWhitespace(char c) const;
-    bool isOperatorChar(char c) const; // Placeholder
+    bool isOperatorChar(char c) const;
+    bool isAtDoubledOperator() const; // True if positioned at '&&' or '||'
     bool isSpecialChar(char c) const;
 };
 
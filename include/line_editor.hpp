@@ -0,0 +1,73 @@
+#pragma once
+
+#include "command_index.hpp"
+#include "environment.hpp"
+#include "history_store.hpp"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace g1_tinyshell
+{
+
+// Line input for an interactive terminal. The line is edited in raw mode (termios) and
+// redrawn after every key, scrolling sideways when it is wider than the terminal. The cursor
+// moves by UTF-8 code point, and wide characters take two columns.
+//   Left/Right, Ctrl-B/F, Alt-B/F   move by character / word
+//   Home/End, Ctrl-A/E              move to the start / end
+//   Backspace, Delete, Ctrl-D       delete (Ctrl-D on an empty line ends the input)
+//   Ctrl-K, Ctrl-U, Ctrl-W          delete to the end / to the start / the previous word
+//   Up/Down, Ctrl-P/N               walk the history
+//   Ctrl-R                          incremental reverse search of the history
+//   Ctrl-C, Ctrl-L                  drop the line / clear the screen
+//   Tab                             complete; a second Tab lists the candidates
+// Tab completes builtins and $PATH executables in command position, `$NAME` and `${NAME}`
+// elsewhere, and paths otherwise. Executables come from a CommandIndex snapshot and
+// directories from DirectoryCache, so a key press never waits for $PATH to be scanned.
+class LineEditor
+{
+public:
+    LineEditor(const HistoryStore& history, const Environment& environment);
+
+    LineEditor(const LineEditor&) = delete;
+    LineEditor& operator=(const LineEditor&) = delete;
+
+    // Shows `prompt` (which may contain color sequences) and reads a line into `line`.
+    // Returns false at end of input.
+    bool readLine(const std::string& prompt, std::string& line);
+
+private:
+    const HistoryStore& m_history;
+    const Environment& m_environment;
+    CommandIndex m_commands;
+
+    // State of the line being read
+    std::string m_prompt;
+    size_t m_promptWidth;
+    std::string m_buffer;
+    size_t m_cursor; // Byte offset, always at a code point boundary
+    size_t m_historyIndex; // history.size() while editing a new line
+    std::string m_draft;   // The new line, while walking the history
+    bool m_listOnTab;      // The previous key was a Tab that could not complete further
+
+    std::string m_input; // Bytes read but not yet handled
+    size_t m_inputPosition;
+
+    int readKey();
+    bool readByte(char& byte, int timeout_ms);
+    void refresh(const std::string& prompt, size_t prompt_width);
+    void refresh();
+    void writeOutput(const std::string& text);
+
+    void insertText(const std::string& text);
+    void moveWord(bool forward);
+    void deletePreviousWord();
+    void showHistoryEntry(size_t index);
+    int reverseSearch();
+
+    void complete();
+    bool isCommandPosition(size_t word_start) const;
+    void listCandidates(const std::vector<std::string>& candidates, size_t hidden_prefix);
+};
+
+}
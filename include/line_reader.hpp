@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace g1_tinyshell
+{
+
+// Reads newline-terminated lines from a file descriptor through one large buffer, so a line
+// costs a memchr instead of a syscall and memory stays flat however long the input is.
+// The descriptor is not owned. Lines are returned without their '\n'; a last line without
+// one is still returned.
+class LineReader
+{
+public:
+    static constexpr size_t K_DefaultBufferSize = 256 * 1024;
+
+    explicit LineReader(int fd, size_t buffer_size = K_DefaultBufferSize);
+
+    // Stores the next line in `line` (reusing its capacity). Returns false at end of input.
+    bool nextLine(std::string& line);
+
+    // True if reading stopped because of an I/O error rather than end of input.
+    bool hasError() const;
+
+private:
+    int m_fd;
+    std::vector<char> m_buffer;
+    size_t m_begin; // First unconsumed byte
+    size_t m_end;   // One past the last valid byte
+    bool m_atEof;
+    bool m_hasError;
+
+    // Reads more input after the unconsumed bytes. Returns false if nothing more can be read.
+    bool fillBuffer();
+};
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace g1_tinyshell
+{
+
+// Buffered writer for one file descriptor, used by every built-in that prints.
+// Output is collected in a 64 KiB buffer and written when it fills, so a loop of `echo`s into
+// a file or pipe costs a few large write() calls instead of one per line. On a terminal the
+// sink is line buffered, like stdio. Call flushAll() at command boundaries, before anything
+// else writes to the same descriptor (fork, std::system, std::cerr messages) and before
+// reading interactive input.
+class OutputSink
+{
+public:
+    static constexpr size_t K_DefaultBufferSize = 64 * 1024;
+
+    // The shared sink for `fd` (created on first use).
+    static OutputSink& forDescriptor(int fd);
+    static OutputSink& standardOutput();
+
+    // Flushes std::cout, std::cerr and every sink.
+    static void flushAll();
+
+    explicit OutputSink(int fd, size_t buffer_size = K_DefaultBufferSize);
+    ~OutputSink();
+
+    void write(const char* data, size_t size);
+    void put(char c);
+    void flush();
+
+    OutputSink& operator<<(const std::string& text)
+    {
+        write(text.data(), text.size());
+        return *this;
+    }
+    OutputSink& operator<<(const char* text);
+    OutputSink& operator<<(char c)
+    {
+        put(c);
+        return *this;
+    }
+    template <typename Number, typename = std::enable_if_t<std::is_arithmetic<Number>::value>>
+    OutputSink& operator<<(Number value)
+    {
+        return *this << std::to_string(value);
+    }
+
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+
+private:
+    int m_fd;
+    std::vector<char> m_buffer;
+    size_t m_used;
+    bool m_lineBuffered; // The descriptor is a terminal
+
+    // write() until everything is out; gives up on errors other than EINTR (e.g. EPIPE).
+    void writeAll(const char* data, size_t size);
+};
+
+}
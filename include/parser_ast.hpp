@@ -2,6 +2,7 @@
 
 #include "tinyshell_globals.hpp"
 #include "lexer.hpp"
+#include "glob_pattern.hpp"
 #include <vector>
 #include <string>
 #include <memory>
@@ -23,6 +24,7 @@ struct SimpleCommandNode : AstNodeBase
 {
     std::string command;
     std::vector<std::string> arguments;
+    std::vector<bool> glob_arguments; // Parallel to arguments: true if unquoted (pathname expansion applies)
 };
 
 // Represents a sequence of commands, e.g., commands separated by ';'
@@ -45,6 +47,7 @@ struct WhileNode : AstNodeBase
 {
     std::shared_ptr<AstNodeBase> condition_command;
     std::shared_ptr<AstNodeBase> body;
+    std::string input_file; // `done < file`: `read` in the loop reads from this file (may contain variables)
 };
 
 // Represents a for loop
@@ -52,7 +55,58 @@ struct ForNode : AstNodeBase
 {
     std::string variable_name;
     std::vector<std::string> word_list; // Words to iterate over
+    std::vector<bool> glob_words;       // Parallel to word_list: true if unquoted
     std::shared_ptr<AstNodeBase> body;
+
+    // `for v in <file` and `for v in $(command)` iterate over lines, read as a stream.
+    // At most one of these is set, and word_list is then empty.
+    std::string line_file;                      // Word naming the file (may contain variables)
+    std::shared_ptr<AstNodeBase> line_command;  // Parsed command whose output is read
+};
+
+// Represents a subshell `( list )`: the body runs with its own copy of the
+// variables and current directory, which are restored afterwards.
+struct SubshellNode : AstNodeBase
+{
+    std::shared_ptr<AstNodeBase> body;
+};
+
+enum class AndOrOperator
+{
+    And, // '&&': run the next command only if the previous one succeeded
+    Or   // '||': run the next command only if the previous one failed
+};
+
+// Represents an and-or list, e.g., `cmd1 && cmd2 || cmd3`.
+// operators[i] joins commands[i] and commands[i + 1]; evaluation is left to right.
+struct AndOrListNode : AstNodeBase
+{
+    std::vector<std::shared_ptr<AstNodeBase>> commands;
+    std::vector<AndOrOperator> operators;
+};
+
+// Represents `! command`: inverts the command's exit status.
+struct NotNode : AstNodeBase
+{
+    std::shared_ptr<AstNodeBase> command;
+};
+
+// One `pattern | pattern ) body ;;` clause of a case statement
+struct CaseClause
+{
+    std::vector<std::string> patterns;
+    std::shared_ptr<AstNodeBase> body;
+};
+
+// Represents `case word in clauses... esac`.
+// Patterns without `$` are compiled into `dispatcher` at parse time (target = clause index),
+// so selecting a clause is one lookup instead of a test per pattern.
+struct CaseNode : AstNodeBase
+{
+    std::string word;
+    std::vector<CaseClause> clauses;
+    PatternDispatcher dispatcher;
+    bool has_dynamic_patterns = false; // Some pattern needs expansion: match clause by clause
 };
 
 // Use std::variant to hold different node types
@@ -78,11 +132,14 @@ private:
 
     // Helper methods for parsing different structures
     AstNodePtr parseCommandSequence(); // Parses commands separated by ';'
-    AstNodePtr parseCommand();         // Parses a single command (simple, if, while, for)
+    AstNodePtr parseAndOrList();       // Parses commands joined by '&&' / '||'
+    AstNodePtr parseCommand();         // Parses a single command (simple, if, while, for, subshell, '!')
     AstNodePtr parseSimpleCommand();
     AstNodePtr parseIfCommand();
     AstNodePtr parseWhileCommand();
     AstNodePtr parseForCommand();
+    AstNodePtr parseSubshellCommand();
+    AstNodePtr parseCaseCommand();
 
     // Token manipulation helpers
     const Token& currentToken() const;
@@ -91,6 +148,7 @@ private:
     bool matchToken(TokenType type);
     bool expectToken(TokenType type, const std::string& error_context);
     bool isAtEnd() const;
+    bool isSequenceEnd() const; // True at EOI or a token that closes the enclosing block
 
     void setError(const std::string& message);
 };
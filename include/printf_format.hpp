@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace g1_tinyshell
+{
+
+// A `printf` format string parsed once into a list of operations: literal text (escapes
+// already decoded) and conversions (%d %i %o %u %x %X %c %s %b %e %E %f %F %g %G %a %A, with
+// flags, width and precision, `*` taking them from the arguments). Compiled formats are
+// cached by their text, so a `printf` in a loop body parses its format only once.
+class PrintfFormat
+{
+public:
+    // Returns the compiled form of `format`, from the process-wide cache.
+    static std::shared_ptr<const PrintfFormat> get(const std::string& format);
+
+    explicit PrintfFormat(const std::string& format);
+
+    // Appends the output for args[first_arg..] to `output`. As in POSIX printf the format is
+    // reused until every argument has been consumed; missing arguments read as "" or 0.
+    // Returns false (with a message) on an invalid format or number; the output is still produced.
+    bool format(const std::vector<std::string>& args, size_t first_arg, std::string& output,
+                std::string& error_message) const;
+
+private:
+    enum class OpType
+    {
+        Literal,
+        Conversion
+    };
+
+    struct Op
+    {
+        OpType type;
+        std::string text;         // Literal: the text; Conversion: snprintf spec ("%-*.3lld")
+        char conversion = '\0';   // Conversion character as written ('d', 's', 'b', ...)
+        bool width_from_arg = false;
+        bool precision_from_arg = false;
+    };
+
+    std::vector<Op> m_ops;
+    bool m_consumesArguments;   // False if there are no conversions: the format runs once
+    bool m_stopsOutput;         // The format contains `\c`: it is never reused
+    std::string m_errorMessage; // Set if the format itself is invalid
+
+    // Appends one conversion. Returns false at `\c` in a %b argument (stop all output).
+    bool appendConversion(const Op& op, const std::vector<std::string>& args, size_t& next_arg,
+                          std::string& output, std::string& error_message) const;
+};
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace g1_tinyshell
+{
+
+// Starts argv[0] (searched in PATH) with `argv` directly, without a shell, and waits for it.
+// Like std::system(), the shell ignores SIGINT and SIGQUIT while it waits, and the child
+// gets their default actions. Returns the exit status (128 + signal number if it was killed),
+// or -1 with errno set if it could not be started.
+int run_program(const std::vector<std::string>& argv);
+
+// What the `c` and `cpp` builtins compile.
+struct ProgramBuild
+{
+    std::string compiler;                   // "gcc" or "g++"
+    std::vector<std::string> sources;       // Translation units
+    std::vector<std::string> compile_flags; // Given to every unit (-O2, -march=native, -I, -D, ...)
+    std::vector<std::string> link_items;    // Flags and inputs for the link, in order (-l, -L, .o, .a, -O2, ...)
+};
+
+// Builds the program through the BuildCache: every translation unit is compiled (in parallel)
+// into its own cached object, keyed by its contents, path, working directory, compiler and
+// compile flags, so only changed units are recompiled. The objects are then linked once into a
+// cached executable keyed by the object keys and the link items (with the contents of input
+// files). Returns the executable's path; on failure returns an empty string with `status`
+// (the compiler's exit status, or 1) and `error` set.
+std::string build_program(const ProgramBuild& build, int& status, std::string& error);
+
+}
@@ -5,9 +5,11 @@
 #include "lexer.hpp"
 #include "parser_ast.hpp"
 #include "executor.hpp"
+#include "history_store.hpp"
+#include "line_editor.hpp"
+#include <memory>
 #include <string>
 #include <vector>
-#include <deque> // Use deque for efficient history management
 
 namespace g1_tinyshell
 {
@@ -24,7 +26,7 @@ public:
     void addToHistory(const std::string& command_line);
 
     // Retrieves the command history.
-    const std::deque<std::string>& getHistory() const;
+    const HistoryStore& getHistory() const;
 
     // Signals the REPL to stop.
     void requestExit();
@@ -35,14 +37,20 @@ public:
 private:
     Environment m_environment;
     Executor m_executor;
-    std::deque<std::string> m_commandHistory;
+    HistoryStore m_commandHistory;
+    std::unique_ptr<LineEditor> m_lineEditor; // Only when stdin and stdout are a terminal
+    bool m_historyExpansion; // `!` references are expanded (interactive input, or $TINYSHELL_HISTEXPAND=1)
     bool m_shouldExit;
 
-    // Reads a line of input from the user.
+    // Shows the prompt and reads a line of input from the user.
     std::string readLine();
 
-    // Displays the shell prompt.
-    void displayPrompt();
+    // The shell prompt, with its color sequences.
+    std::string promptText() const;
+
+    // Applies $TINYSHELL_HISTSIZE and persists history to $TINYSHELL_HISTFILE, or to
+    // ~/.tinyshell_history when the shell is interactive.
+    void openHistory();
 };
 
 }
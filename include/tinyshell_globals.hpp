@@ -11,10 +11,12 @@ namespace g1_tinyshell
 // Forward declarations
 class Environment;
 class Executor;
+class LineReader;
 // AST Node structs are defined in parser_ast.hpp
 
 // --- Constants ---
-constexpr int K_MaxHistorySize = 100;
+constexpr size_t K_DefaultHistorySize = 1000000;     // Entries kept in memory ($TINYSHELL_HISTSIZE)
+constexpr size_t K_DefaultHistoryFileSize = 1000000; // Records kept in the file ($TINYSHELL_HISTFILESIZE)
 constexpr const char* K_DefaultPromptColor = "\033[1;34m"; // Bold Blue
 constexpr const char* K_PathPromptColor = "\033[1;32m";    // Bold Green
 constexpr const char* K_ResetColor = "\033[0m";
@@ -35,6 +37,7 @@ enum class BuiltinCommandType
     Ls,
     Mkdir,
     Rm,
+    Cp,
     Cat,
     Path,
     AddPath,
@@ -42,6 +45,9 @@ enum class BuiltinCommandType
     Cpp,
     History,
     Test,
+    Read,
+    Mapfile,
+    Printf,
     CatSpin, // Optional
     Unknown
 };
@@ -62,6 +68,7 @@ struct CommandInfo
     std::string command_name;
     std::vector<std::string> arguments;
     BuiltinCommandType builtin_type = BuiltinCommandType::Unknown;
+    LineReader* input_reader = nullptr; // Input of an enclosing `while ... done < file`, or nullptr for stdin
     // Add fields for redirection, backgrounding if extending later
 };
 
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace g1_tinyshell
+{
+
+// Copies each source to `destination`: into it (keeping the source's name) when it is an
+// existing directory, which is required for more than one source, otherwise onto it.
+// Regular files are cloned with the FICLONE ioctl where the filesystem supports reflinks,
+// and otherwise copied in the kernel by copy_descriptor_data().
+// Directories need `recursive`. Their trees are copied on a WorkStealingPool bounded to a
+// few threads: one task per directory, with large directories' files split into batches.
+// Children are opened with openat()/mkdirat() relative to their parent's descriptors, and
+// symlinks are recreated rather than followed. Modes and timestamps are preserved; a
+// directory gets its own only after its last child is written, so its mtime sticks.
+// A copy never descends into the directory it is creating.
+// Returns one message per failure (empty when everything was copied).
+std::vector<std::string> copy_paths(const std::vector<std::string>& sources, const std::string& destination,
+                                    bool recursive);
+
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace g1_tinyshell
+{
+
+// Removes each path. Files and symlinks are unlinked. Directories are removed only if empty,
+// unless `recursive`: then the tree is deleted on a WorkStealingPool, one task per
+// directory. Each task opens its directory with openat() relative to its parent's fd, unlinks
+// the files with unlinkat() and queues the subdirectories. A directory removes itself when its
+// last subdirectory is gone, so removal proceeds bottom-up without a second pass.
+// With `force`, missing operands are not errors. Refuses `.`, `..` and `/` when recursive.
+// Returns one message per failure (empty when everything was removed).
+std::vector<std::string> remove_paths(const std::vector<std::string>& paths, bool recursive, bool force);
+
+}
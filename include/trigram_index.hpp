@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace g1_tinyshell
+{
+
+// Substring index over numbered texts: every 3-byte sequence maps to the ascending list of the
+// ids whose text contains it. A pattern can only occur in texts that contain all of its
+// trigrams, so a search walks the shortest of those lists and checks the others by binary
+// search. Callers verify the candidates, since trigrams say nothing about their order.
+// Texts are also filed under their first one, two and three bytes, for prefix searches.
+class TrigramIndex
+{
+public:
+    // Ids must be added in increasing order.
+    void add(uint32_t id, const char* text, size_t length);
+
+    // Takes `id` out of the lists of `text` (what it was added with). Recent ids sit at the end
+    // of their lists, so removing one that was just superseded is cheap.
+    void remove(uint32_t id, const char* text, size_t length);
+
+    // Largest candidate id below `before` for `pattern` (3 bytes or longer); pass the candidate
+    // back as `before` to continue. Returns false when there are no more.
+    bool previousCandidate(const std::string& pattern, uint32_t before, uint32_t& candidate) const;
+
+    // The same for texts starting with `prefix` (any non-empty length).
+    bool previousPrefixCandidate(const std::string& prefix, uint32_t before, uint32_t& candidate) const;
+
+    bool empty() const;
+
+private:
+    std::unordered_map<uint32_t, std::vector<uint32_t>> m_postings;
+    std::vector<uint32_t> m_scratch; // Trigrams of the text being added
+
+    void collectKeys(const char* text, size_t length); // Into m_scratch
+    bool addTrigramLists(const std::string& pattern, std::vector<const std::vector<uint32_t>*>& lists) const;
+    static bool previousInAll(std::vector<const std::vector<uint32_t>*>& lists, uint32_t before, uint32_t& candidate);
+};
+
+}
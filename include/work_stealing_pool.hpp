@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace g1_tinyshell
+{
+
+// Fixed-size thread pool for recursive, fan-out work such as directory tree walks.
+// Each worker owns a deque: tasks submitted from inside a task go to the submitting
+// worker's deque and are popped LIFO (depth-first, cache friendly); idle workers steal
+// FIFO from the other deques, taking the oldest (usually largest) pieces of work.
+class WorkStealingPool
+{
+public:
+    using Task = std::function<void()>;
+
+    // thread_count == 0 selects defaultThreadCount().
+    explicit WorkStealingPool(size_t thread_count = 0);
+    ~WorkStealingPool(); // Waits for outstanding tasks, then joins the workers
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // Queues a task. Safe to call from any thread, including from inside a running task.
+    void submit(Task task);
+
+    // Blocks until every submitted task (and every task they submitted) has finished.
+    void wait();
+
+    size_t getThreadCount() const;
+
+    // Hardware concurrency, clamped to [1, K_MaxPoolThreads].
+    static size_t defaultThreadCount();
+
+private:
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+    std::vector<std::thread> m_workers;
+    std::mutex m_stateMutex;
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_allTasksDone;
+    std::atomic<size_t> m_queuedTasks;  // Sitting in a deque
+    std::atomic<size_t> m_pendingTasks; // Submitted and not yet finished
+    std::atomic<size_t> m_nextQueue;    // Round-robin target for external submissions
+    bool m_stopping;
+
+    void workerLoop(size_t worker_index);
+    bool takeTask(size_t worker_index, Task& task);
+};
+
+}
@@ -0,0 +1,344 @@
+#include "../include/brace_expansion.hpp"
+#include "../include/expansion.hpp" // findParameterEnd
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <limits>
+
+namespace g1_tinyshell
+{
+
+namespace
+{
+constexpr uint64_t K_MaxCount = std::numeric_limits<uint64_t>::max();
+
+uint64_t saturating_multiply(uint64_t a, uint64_t b)
+{
+    if (a != 0 && b > K_MaxCount / a)
+    {
+        return K_MaxCount;
+    }
+    return a * b;
+}
+
+uint64_t saturating_add(uint64_t a, uint64_t b)
+{
+    return (b > K_MaxCount - a) ? K_MaxCount : a + b;
+}
+
+// Finds the '}' closing the '{' at open_pos (within [open_pos, end)) and the commas
+// directly inside it. Escaped characters and `${...}` do not count. Returns npos if unclosed.
+size_t find_group_end(const std::string& word, size_t open_pos, size_t end, std::vector<size_t>& comma_positions)
+{
+    size_t depth = 0;
+    for (size_t i = open_pos; i < end; ++i)
+    {
+        char c = word[i];
+        if (c == '\\')
+        {
+            ++i;
+        }
+        else if (c == '$' && i + 1 < end && word[i + 1] == '{')
+        {
+            size_t close_pos = Expansion::findParameterEnd(word, i + 1);
+            if (close_pos == std::string::npos || close_pos >= end)
+            {
+                return std::string::npos;
+            }
+            i = close_pos;
+        }
+        else if (c == '{')
+        {
+            ++depth;
+        }
+        else if (c == '}')
+        {
+            if (--depth == 0)
+            {
+                return i;
+            }
+        }
+        else if (c == ',' && depth == 1)
+        {
+            comma_positions.push_back(i);
+        }
+    }
+    return std::string::npos;
+}
+
+// Parses an optionally signed decimal integer. `zero_padded` is set for forms like "007".
+bool parse_range_integer(const std::string& text, int64_t& value, bool& zero_padded)
+{
+    size_t digits_start = (!text.empty() && (text[0] == '-' || text[0] == '+')) ? 1 : 0;
+    if (digits_start == text.length())
+    {
+        return false;
+    }
+    for (size_t i = digits_start; i < text.length(); ++i)
+    {
+        if (!std::isdigit(static_cast<unsigned char>(text[i])))
+        {
+            return false;
+        }
+    }
+    errno = 0;
+    long long parsed = std::strtoll(text.c_str(), nullptr, 10);
+    if (errno == ERANGE)
+    {
+        return false;
+    }
+    value = parsed;
+    zero_padded = text[digits_start] == '0' && text.length() - digits_start > 1;
+    return true;
+}
+}
+
+BraceExpansion::BraceExpansion(const std::string& word)
+    : m_root(0), m_hasGroups(false), m_nextIndex(0)
+{
+    m_root = parseSequence(word, 0, word.length());
+}
+
+bool BraceExpansion::hasGroups() const
+{
+    return m_hasGroups;
+}
+
+uint64_t BraceExpansion::size() const
+{
+    return m_nodes[m_root].count;
+}
+
+bool BraceExpansion::next(std::string& word)
+{
+    if (m_nextIndex >= size())
+    {
+        return false;
+    }
+    word.clear();
+    appendWord(m_root, m_nextIndex++, word);
+    return true;
+}
+
+bool BraceExpansion::mayHaveBraces(const std::string& word)
+{
+    size_t open_pos = word.find('{');
+    return open_pos != std::string::npos && word.find('}', open_pos + 1) != std::string::npos;
+}
+
+size_t BraceExpansion::parseSequence(const std::string& word, size_t begin, size_t end)
+{
+    std::vector<size_t> parts;
+    std::string text;
+    auto flush_text = [&]()
+    {
+        if (!text.empty())
+        {
+            Node text_node;
+            text_node.text = std::move(text);
+            m_nodes.push_back(std::move(text_node));
+            parts.push_back(m_nodes.size() - 1);
+            text.clear();
+        }
+    };
+
+    for (size_t i = begin; i < end;)
+    {
+        char c = word[i];
+        if (c == '\\' && i + 1 < end)
+        {
+            text.append(word, i, 2); // Escaped characters are kept for variable expansion
+            i += 2;
+            continue;
+        }
+        if (c == '$' && i + 1 < end && word[i + 1] == '{')
+        {
+            size_t close_pos = Expansion::findParameterEnd(word, i + 1);
+            if (close_pos != std::string::npos && close_pos < end)
+            {
+                text.append(word, i, close_pos + 1 - i); // `${NAME}` is not a brace group
+                i = close_pos + 1;
+                continue;
+            }
+        }
+        if (c == '{')
+        {
+            std::vector<size_t> comma_positions;
+            size_t close_pos = find_group_end(word, i, end, comma_positions);
+            if (close_pos != std::string::npos)
+            {
+                size_t group = parseGroup(word, i, close_pos, comma_positions);
+                if (group != std::string::npos)
+                {
+                    flush_text();
+                    parts.push_back(group);
+                    i = close_pos + 1;
+                    continue;
+                }
+            }
+            // Not a valid group (`{}`, `{a}`, unclosed): the brace is literal text
+        }
+        text += c;
+        ++i;
+    }
+    flush_text();
+
+    Node sequence;
+    sequence.kind = NodeKind::Sequence;
+    sequence.children = std::move(parts);
+    sequence.offsets.resize(sequence.children.size());
+    // The last part varies fastest: {a,b}{1,2} -> a1 a2 b1 b2
+    for (size_t k = sequence.children.size(); k-- > 0;)
+    {
+        sequence.offsets[k] = sequence.count;
+        sequence.count = saturating_multiply(sequence.count, m_nodes[sequence.children[k]].count);
+    }
+    m_nodes.push_back(std::move(sequence));
+    return m_nodes.size() - 1;
+}
+
+size_t BraceExpansion::parseGroup(const std::string& word, size_t open_pos, size_t close_pos,
+                                  const std::vector<size_t>& comma_positions)
+{
+    if (comma_positions.empty())
+    {
+        Node range;
+        if (!parseRange(word.substr(open_pos + 1, close_pos - open_pos - 1), range))
+        {
+            return std::string::npos;
+        }
+        m_hasGroups = true;
+        m_nodes.push_back(std::move(range));
+        return m_nodes.size() - 1;
+    }
+
+    Node alternation;
+    alternation.kind = NodeKind::Alternation;
+    alternation.count = 0;
+    size_t option_begin = open_pos + 1;
+    for (size_t i = 0; i <= comma_positions.size(); ++i)
+    {
+        size_t option_end = (i < comma_positions.size()) ? comma_positions[i] : close_pos;
+        size_t option = parseSequence(word, option_begin, option_end);
+        alternation.children.push_back(option);
+        alternation.offsets.push_back(alternation.count);
+        alternation.count = saturating_add(alternation.count, m_nodes[option].count);
+        option_begin = option_end + 1;
+    }
+    m_hasGroups = true;
+    m_nodes.push_back(std::move(alternation));
+    return m_nodes.size() - 1;
+}
+
+bool BraceExpansion::parseRange(const std::string& body, Node& node) const
+{
+    size_t first_dots = body.find("..");
+    if (first_dots == std::string::npos)
+    {
+        return false;
+    }
+    size_t second_dots = body.find("..", first_dots + 2);
+    std::string start_text = body.substr(0, first_dots);
+    std::string end_text = body.substr(first_dots + 2, second_dots == std::string::npos
+                                                           ? std::string::npos
+                                                           : second_dots - first_dots - 2);
+
+    int64_t step = 1;
+    if (second_dots != std::string::npos)
+    {
+        bool unused_padding = false;
+        if (!parse_range_integer(body.substr(second_dots + 2), step, unused_padding))
+        {
+            return false;
+        }
+    }
+
+    int64_t start_value = 0;
+    int64_t end_value = 0;
+    bool start_padded = false;
+    bool end_padded = false;
+    if (parse_range_integer(start_text, start_value, start_padded) &&
+        parse_range_integer(end_text, end_value, end_padded))
+    {
+        node.range_is_char = false;
+        if (start_padded || end_padded)
+        {
+            node.range_width = std::max(start_text.length(), end_text.length());
+        }
+    }
+    else if (start_text.length() == 1 && end_text.length() == 1 &&
+             std::isalpha(static_cast<unsigned char>(start_text[0])) &&
+             std::isalpha(static_cast<unsigned char>(end_text[0])))
+    {
+        node.range_is_char = true;
+        start_value = static_cast<unsigned char>(start_text[0]);
+        end_value = static_cast<unsigned char>(end_text[0]);
+    }
+    else
+    {
+        return false;
+    }
+
+    // Only the step's magnitude matters; the direction comes from the endpoints
+    uint64_t step_magnitude = (step < 0) ? 0 - static_cast<uint64_t>(step) : static_cast<uint64_t>(step);
+    node.kind = NodeKind::Range;
+    node.range_start = start_value;
+    node.range_step = (step_magnitude == 0) ? 1 : step_magnitude;
+    node.range_descending = end_value < start_value;
+    uint64_t distance = node.range_descending
+                            ? static_cast<uint64_t>(start_value) - static_cast<uint64_t>(end_value)
+                            : static_cast<uint64_t>(end_value) - static_cast<uint64_t>(start_value);
+    node.count = saturating_add(distance / node.range_step, 1);
+    return true;
+}
+
+void BraceExpansion::appendWord(size_t node_index, uint64_t index, std::string& word) const
+{
+    const Node& node = m_nodes[node_index];
+    switch (node.kind)
+    {
+        case NodeKind::Text:
+            word += node.text;
+            break;
+        case NodeKind::Sequence:
+            for (size_t k = 0; k < node.children.size(); ++k)
+            {
+                const Node& part = m_nodes[node.children[k]];
+                appendWord(node.children[k], (index / node.offsets[k]) % part.count, word);
+            }
+            break;
+        case NodeKind::Alternation:
+        {
+            size_t option = std::upper_bound(node.offsets.begin(), node.offsets.end(), index) - node.offsets.begin() - 1;
+            appendWord(node.children[option], index - node.offsets[option], word);
+            break;
+        }
+        case NodeKind::Range:
+        {
+            uint64_t delta = index * node.range_step;
+            uint64_t start = static_cast<uint64_t>(node.range_start);
+            int64_t value = static_cast<int64_t>(node.range_descending ? start - delta : start + delta);
+            if (node.range_is_char)
+            {
+                word += static_cast<char>(value);
+                break;
+            }
+            uint64_t magnitude = (value < 0) ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+            std::string digits = std::to_string(magnitude);
+            size_t width = digits.length() + (value < 0 ? 1 : 0);
+            if (value < 0)
+            {
+                word += '-';
+            }
+            if (node.range_width > width)
+            {
+                word.append(node.range_width - width, '0');
+            }
+            word += digits;
+            break;
+        }
+    }
+}
+
+}
@@ -0,0 +1,463 @@
+#include "../include/build_cache.hpp"
+#include "../include/directory_creation.hpp"
+#include "../include/globbing.hpp" // read_directory_entries
+#include "../include/tree_removal.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace g1_tinyshell
+{
+
+namespace
+{
+constexpr uint64_t K_MaxBuildCacheBytes = 512ull << 20;
+constexpr time_t K_StaleStagingSeconds = 24 * 60 * 60; // Left behind by a shell that died mid-build
+constexpr size_t K_HashReadSize = 1 << 16;
+constexpr const char* K_ManifestFile = "manifest";
+
+// Two independent 64-bit FNV-1a style lanes. Not cryptographic: the cache is private to the
+// user, so it only has to make accidental collisions negligible.
+class ContentHash
+{
+public:
+    void update(const void* data, size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            m_lanes[0] = (m_lanes[0] ^ bytes[i]) * 0x100000001b3ull;
+            m_lanes[1] = (m_lanes[1] ^ bytes[i]) * 0x9e3779b97f4a7c15ull;
+        }
+        m_length += size;
+    }
+
+    std::string hexDigest() const
+    {
+        char digest[33];
+        std::snprintf(digest, sizeof(digest), "%016llx%016llx",
+                      static_cast<unsigned long long>(finish(m_lanes[0] ^ m_length)),
+                      static_cast<unsigned long long>(finish(m_lanes[1] + m_length)));
+        return digest;
+    }
+
+private:
+    uint64_t m_lanes[2] = {0xcbf29ce484222325ull, 0x84222325cbf29ce4ull};
+    uint64_t m_length = 0;
+
+    static uint64_t finish(uint64_t value) // splitmix64's finalizer
+    {
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+        return value ^ (value >> 31);
+    }
+};
+
+std::string find_in_path(const std::string& name)
+{
+    if (name.find('/') != std::string::npos)
+    {
+        return access(name.c_str(), X_OK) == 0 ? name : "";
+    }
+    const char* path_var = std::getenv("PATH");
+    std::stringstream directories(path_var ? path_var : "/usr/bin:/bin");
+    std::string directory;
+    while (std::getline(directories, directory, ':'))
+    {
+        std::string candidate = (directory.empty() ? "." : directory) + "/" + name;
+        struct stat candidate_stat;
+        if (stat(candidate.c_str(), &candidate_stat) == 0 && S_ISREG(candidate_stat.st_mode) &&
+            access(candidate.c_str(), X_OK) == 0)
+        {
+            return candidate;
+        }
+    }
+    return "";
+}
+
+uint64_t modification_nanoseconds(const struct stat& file_stat)
+{
+    return static_cast<uint64_t>(file_stat.st_mtim.tv_sec) * 1000000000ull +
+           static_cast<uint64_t>(file_stat.st_mtim.tv_nsec);
+}
+
+// The prerequisites of a make rule as written by gcc -MD: `target: dep dep \<newline> dep`,
+// with spaces in names escaped as `\ ` and `$` as `$$`.
+std::vector<std::string> parse_dependency_file(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    std::vector<std::string> dependencies;
+    size_t pos = text.find(": ");
+    if (pos == std::string::npos)
+    {
+        return dependencies;
+    }
+    std::string current;
+    for (pos += 1; pos < text.size(); ++pos)
+    {
+        char c = text[pos];
+        if (c == '\\' && pos + 1 < text.size() && (text[pos + 1] == '\n' || text[pos + 1] == ' '))
+        {
+            if (text[pos + 1] == ' ')
+            {
+                current += ' ';
+            }
+            else if (!current.empty())
+            {
+                dependencies.push_back(std::move(current));
+                current.clear();
+            }
+            ++pos;
+        }
+        else if (c == '$' && pos + 1 < text.size() && text[pos + 1] == '$')
+        {
+            current += '$';
+            ++pos;
+        }
+        else if (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+        {
+            if (!current.empty())
+            {
+                dependencies.push_back(std::move(current));
+                current.clear();
+            }
+        }
+        else
+        {
+            current += c;
+        }
+    }
+    if (!current.empty())
+    {
+        dependencies.push_back(std::move(current));
+    }
+    return dependencies;
+}
+
+// Converts the staging directory's dependency file into the manifest find() checks:
+// one `size mtime_ns hash path` line per file, with paths made absolute.
+bool write_manifest(const std::string& staging_directory, std::string& error)
+{
+    std::string dependency_path = staging_directory + "/" + K_BuildDependencyFile;
+    std::vector<std::string> dependencies = parse_dependency_file(dependency_path);
+    unlink(dependency_path.c_str());
+
+    char cwd[PATH_MAX];
+    std::string base = getcwd(cwd, sizeof(cwd)) ? std::string(cwd) + "/" : "";
+    std::ofstream manifest(staging_directory + "/" + K_ManifestFile, std::ios::binary | std::ios::trunc);
+    std::sort(dependencies.begin(), dependencies.end());
+    dependencies.erase(std::unique(dependencies.begin(), dependencies.end()), dependencies.end());
+    for (const std::string& dependency : dependencies)
+    {
+        std::string absolute_path = (dependency[0] == '/') ? dependency : base + dependency;
+        struct stat dependency_stat;
+        std::string hash = BuildCache::hashFile(absolute_path);
+        if (stat(absolute_path.c_str(), &dependency_stat) != 0 || hash.empty())
+        {
+            continue; // Gone already (a generated header); the source hash still keys the entry
+        }
+        manifest << dependency_stat.st_size << ' ' << modification_nanoseconds(dependency_stat) << ' ' << hash
+                 << ' ' << absolute_path << '\n';
+    }
+    manifest.close();
+    if (!manifest)
+    {
+        error = "Cannot write build cache manifest in `" + staging_directory + "`";
+        return false;
+    }
+    return true;
+}
+
+// Sum of the sizes of the files directly inside an entry directory.
+uint64_t entry_size(const std::string& entry_path)
+{
+    int entry_fd = open(entry_path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (entry_fd < 0)
+    {
+        return 0;
+    }
+    std::vector<DirectoryEntry> files;
+    read_directory_entries(entry_fd, files);
+    uint64_t total = 0;
+    for (const DirectoryEntry& file : files)
+    {
+        struct stat file_stat;
+        if (fstatat(entry_fd, file.name.c_str(), &file_stat, AT_SYMLINK_NOFOLLOW) == 0)
+        {
+            total += static_cast<uint64_t>(file_stat.st_blocks) * 512;
+        }
+    }
+    close(entry_fd);
+    return total;
+}
+}
+
+BuildCache& BuildCache::instance()
+{
+    static BuildCache cache;
+    return cache;
+}
+
+BuildCache::BuildCache()
+{
+    const char* override_directory = std::getenv("TINYSHELL_BUILD_CACHE");
+    const char* xdg_cache = std::getenv("XDG_CACHE_HOME");
+    const char* home = std::getenv("HOME");
+    if (override_directory && *override_directory)
+    {
+        m_directory = override_directory;
+    }
+    else if (xdg_cache && *xdg_cache)
+    {
+        m_directory = std::string(xdg_cache) + "/tinyshell/build";
+    }
+    else if (home && *home)
+    {
+        m_directory = std::string(home) + "/.cache/tinyshell/build";
+    }
+    else
+    {
+        m_directory = "/tmp/tinyshell-build-" + std::to_string(getuid());
+    }
+}
+
+std::string BuildCache::compilerIdentity(const std::string& name)
+{
+    std::string path = find_in_path(name);
+    char resolved[PATH_MAX];
+    struct stat compiler_stat;
+    if (path.empty() || !realpath(path.c_str(), resolved) || stat(resolved, &compiler_stat) != 0)
+    {
+        return "";
+    }
+    // An upgrade replaces the binary, so (path, size, mtime) decides when to ask again
+    std::string binary_identity = std::string(resolved) + " " + std::to_string(compiler_stat.st_size) + " " +
+                                  std::to_string(modification_nanoseconds(compiler_stat));
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_compilerIdentities.find(binary_identity);
+        if (it != m_compilerIdentities.end())
+        {
+            return it->second;
+        }
+    }
+
+    std::string banner;
+    std::string command = "'" + path + "' --version 2>/dev/null";
+    if (FILE* pipe = popen(command.c_str(), "r"))
+    {
+        char line[512];
+        if (std::fgets(line, sizeof(line), pipe))
+        {
+            banner = line;
+        }
+        while (std::fgets(line, sizeof(line), pipe))
+        {
+        }
+        pclose(pipe);
+    }
+    std::string identity = binary_identity + "\n" + banner;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_compilerIdentities[binary_identity] = identity;
+    return identity;
+}
+
+std::string BuildCache::hashFile(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return "";
+    }
+    ContentHash hash;
+    std::vector<char> buffer(K_HashReadSize);
+    while (true)
+    {
+        ssize_t bytes_read = read(fd, buffer.data(), buffer.size());
+        if (bytes_read == 0)
+        {
+            break;
+        }
+        if (bytes_read < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            int error_number = errno;
+            close(fd);
+            errno = error_number;
+            return "";
+        }
+        hash.update(buffer.data(), static_cast<size_t>(bytes_read));
+    }
+    close(fd);
+    return hash.hexDigest();
+}
+
+std::string BuildCache::hashStrings(const std::vector<std::string>& parts)
+{
+    ContentHash hash;
+    for (const std::string& part : parts)
+    {
+        uint64_t length = part.size(); // Length-prefixed, so {"ab","c"} != {"a","bc"}
+        hash.update(&length, sizeof(length));
+        hash.update(part.data(), part.size());
+    }
+    return hash.hexDigest();
+}
+
+std::string BuildCache::find(const std::string& key)
+{
+    std::string entry = m_directory + "/" + key;
+    std::ifstream manifest(entry + "/" + K_ManifestFile);
+    if (!manifest)
+    {
+        return "";
+    }
+    std::string line;
+    while (std::getline(manifest, line))
+    {
+        std::istringstream fields(line);
+        unsigned long long size = 0;
+        unsigned long long modification_time = 0;
+        std::string hash;
+        std::string path;
+        if (!(fields >> size >> modification_time >> hash) || !std::getline(fields >> std::ws, path))
+        {
+            return "";
+        }
+        struct stat dependency_stat;
+        if (stat(path.c_str(), &dependency_stat) != 0 || static_cast<unsigned long long>(dependency_stat.st_size) != size)
+        {
+            return "";
+        }
+        // Touched but unchanged (a checkout, a rewrite with the same bytes) still counts as a hit
+        if (modification_nanoseconds(dependency_stat) != modification_time && hashFile(path) != hash)
+        {
+            return "";
+        }
+    }
+    utimensat(AT_FDCWD, entry.c_str(), nullptr, 0); // Most recently used for eviction
+    return entry;
+}
+
+std::string BuildCache::store(const std::string& key, const BuildStep& build, std::string& error)
+{
+    if (!ensureDirectory(error))
+    {
+        return "";
+    }
+    static std::atomic<unsigned> staging_counter{0};
+    std::string staging = m_directory + "/.staging-" + std::to_string(getpid()) + "-" +
+                          std::to_string(staging_counter.fetch_add(1));
+    if (mkdir(staging.c_str(), 0777) != 0)
+    {
+        error = "Cannot create `" + staging + "`: " + std::strerror(errno);
+        return "";
+    }
+    if (!build(staging, error) || !write_manifest(staging, error))
+    {
+        remove_paths({staging}, true, true);
+        return "";
+    }
+
+    std::string entry = m_directory + "/" + key;
+    if (rename(staging.c_str(), entry.c_str()) != 0)
+    {
+        // A stale entry (or one another shell just published) is in the way: replace it
+        remove_paths({entry}, true, true);
+        if (rename(staging.c_str(), entry.c_str()) != 0)
+        {
+            error = "Cannot publish build cache entry `" + entry + "`: " + std::strerror(errno);
+            remove_paths({staging}, true, true);
+            return "";
+        }
+    }
+    evictUntilWithinLimit();
+    return entry;
+}
+
+bool BuildCache::ensureDirectory(std::string& error)
+{
+    std::vector<std::string> errors = make_directories({m_directory}, true);
+    if (!errors.empty())
+    {
+        error = "Build cache unavailable: " + errors.front();
+        return false;
+    }
+    return true;
+}
+
+void BuildCache::evictUntilWithinLimit()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    int cache_fd = open(m_directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (cache_fd < 0)
+    {
+        return;
+    }
+    std::vector<DirectoryEntry> names;
+    read_directory_entries(cache_fd, names);
+
+    struct CacheEntry
+    {
+        struct timespec last_used;
+        uint64_t size;
+        std::string path;
+    };
+    std::vector<CacheEntry> entries;
+    uint64_t total_size = 0;
+    time_t now = std::time(nullptr);
+    for (const DirectoryEntry& name : names)
+    {
+        struct stat entry_stat;
+        if (fstatat(cache_fd, name.name.c_str(), &entry_stat, AT_SYMLINK_NOFOLLOW) != 0 || !S_ISDIR(entry_stat.st_mode))
+        {
+            continue;
+        }
+        std::string path = m_directory + "/" + name.name;
+        if (name.name[0] == '.')
+        {
+            if (name.name.compare(0, 9, ".staging-") == 0 && now - entry_stat.st_mtim.tv_sec > K_StaleStagingSeconds)
+            {
+                remove_paths({path}, true, true);
+            }
+            continue;
+        }
+        uint64_t size = entry_size(path);
+        total_size += size;
+        entries.push_back({entry_stat.st_mtim, size, std::move(path)});
+    }
+    close(cache_fd);
+    if (total_size <= K_MaxBuildCacheBytes)
+    {
+        return;
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const CacheEntry& a, const CacheEntry& b)
+    {
+        return a.last_used.tv_sec != b.last_used.tv_sec ? a.last_used.tv_sec < b.last_used.tv_sec
+                                                        : a.last_used.tv_nsec < b.last_used.tv_nsec;
+    });
+    // The newest entry (the one just stored) always survives, even if it alone is over the limit
+    for (size_t i = 0; i + 1 < entries.size() && total_size > K_MaxBuildCacheBytes; ++i)
+    {
+        remove_paths({entries[i].path}, true, true);
+        total_size -= entries[i].size;
+    }
+}
+
+}
@@ -1,5 +1,16 @@
 #include "../include/builtins.hpp"
 #include "../include/shell_core.hpp" // Include ShellCore for history access etc.
+#include "../include/directory_cache.hpp"
+#include "../include/directory_creation.hpp"
+#include "../include/line_reader.hpp"
+#include "../include/expansion.hpp"
+#include "../include/printf_format.hpp"
+#include "../include/program_build.hpp"
+#include "../include/output_sink.hpp"
+#include "../include/file_copy.hpp"
+#include "../include/work_stealing_pool.hpp"
+#include "../include/tree_copy.hpp"
+#include "../include/tree_removal.hpp"
 #include <iostream>
 #include <cstdlib> // system, getenv, exit
 #include <filesystem> // C++17 filesystem operations
@@ -11,6 +22,17 @@
 #include <cstdio> // std::remove for temp files
 #include <limits> // numeric_limits
 #include <algorithm> // std::find_if
+#include <cerrno>
+#include <cstring> // memchr, strerror
+#include <iterator> // istreambuf_iterator
+#include <ctime>
+#include <unordered_map>
+#include <dirent.h> // DT_* entry types
+#include <fcntl.h>
+#include <grp.h>
+#include <pwd.h>
+#include <sys/stat.h> // statx
+#include <unistd.h>
 
 // Define platform-specific home directory retrieval
 #ifdef _WIN32
@@ -36,6 +58,7 @@ const std::map<std::string, BuiltinCommandType> K_BuiltinCommands = {
     {"ls", BuiltinCommandType::Ls},
     {"mkdir", BuiltinCommandType::Mkdir},
     {"rm", BuiltinCommandType::Rm},
+    {"cp", BuiltinCommandType::Cp},
     {"cat", BuiltinCommandType::Cat},
     {"path", BuiltinCommandType::Path},
     {"addpath", BuiltinCommandType::AddPath},
@@ -43,10 +66,17 @@ const std::map<std::string, BuiltinCommandType> K_BuiltinCommands = {
     {"cpp", BuiltinCommandType::Cpp},
     {"history", BuiltinCommandType::History},
     {"test", BuiltinCommandType::Test},
+    {"read", BuiltinCommandType::Read},
+    {"mapfile", BuiltinCommandType::Mapfile},
+    {"printf", BuiltinCommandType::Printf},
     {"[", BuiltinCommandType::Test} // Alias for test
     // {"cat_spin", BuiltinCommandType::CatSpin} // Optional
 };
 
+// Arrays are dense, so an element may land at most this far past the end: the gap is filled
+// with empty elements, and `A[1000000000000]=x` must not try to allocate them all.
+constexpr size_t K_MaxArrayIndexGap = 1 << 16;
+
 BuiltinCommandType Builtins::getBuiltinType(const std::string& command_name)
 {
     auto it = K_BuiltinCommands.find(command_name);
@@ -57,6 +87,16 @@ BuiltinCommandType Builtins::getBuiltinType(const std::string& command_name)
     return BuiltinCommandType::Unknown;
 }
 
+std::vector<std::string> Builtins::getBuiltinNames()
+{
+    std::vector<std::string> names;
+    for (const auto& builtin : K_BuiltinCommands)
+    {
+        names.push_back(builtin.first);
+    }
+    return names;
+}
+
 ExecutionResult Builtins::executeBuiltin(const CommandInfo& command_info, Environment& environment, ShellCore& shell_core)
 {
     switch (command_info.builtin_type)
@@ -73,6 +113,7 @@ ExecutionResult Builtins::executeBuiltin(const CommandInfo& command_info, Enviro
         case BuiltinCommandType::Ls:      return builtinLs(command_info.arguments);
         case BuiltinCommandType::Mkdir:   return builtinMkdir(command_info.arguments);
         case BuiltinCommandType::Rm:      return builtinRm(command_info.arguments);
+        case BuiltinCommandType::Cp:      return builtinCp(command_info.arguments);
         case BuiltinCommandType::Cat:     return builtinCat(command_info.arguments);
         case BuiltinCommandType::Path:    return builtinPath(environment);
         case BuiltinCommandType::AddPath: return builtinAddPath(command_info.arguments, environment);
@@ -80,6 +121,9 @@ ExecutionResult Builtins::executeBuiltin(const CommandInfo& command_info, Enviro
         case BuiltinCommandType::Cpp:     return builtinCpp(command_info.arguments);
         case BuiltinCommandType::History: return builtinHistory(command_info.arguments, shell_core);
         case BuiltinCommandType::Test:    return builtinTest(command_info.arguments);
+        case BuiltinCommandType::Read:    return builtinRead(command_info.arguments, environment, command_info.input_reader);
+        case BuiltinCommandType::Mapfile: return builtinMapfile(command_info.arguments, environment, command_info.input_reader);
+        case BuiltinCommandType::Printf:  return builtinPrintf(command_info.arguments, environment);
         // case BuiltinCommandType::CatSpin: return builtinCatSpin();
         default: // Should not happen if getBuiltinType is used correctly
             return {1, "Internal error: Unknown built-in type.", true};
@@ -118,15 +162,16 @@ ExecutionResult Builtins::builtinExit(const std::vector<std::string>& args, Shel
 
 ExecutionResult Builtins::builtinEcho(const std::vector<std::string>& args)
 {
+    OutputSink& out = OutputSink::standardOutput();
     for (size_t i = 0; i < args.size(); ++i)
     {
-        std::cout << args[i];
+        out << args[i];
         if (i < args.size() - 1)
         {
-            std::cout << " ";
+            out << ' ';
         }
     }
-    std::cout << std::endl;
+    out << '\n';
     return {0, "", true};
 }
 
@@ -134,7 +179,7 @@ ExecutionResult Builtins::builtinHelp(const std::vector<std::string>& args)
 {
     if (args.empty())
     {
-        std::cout << listBuiltins() << std::endl;
+        OutputSink::standardOutput() << listBuiltins() << '\n';
     }
     else
     {
@@ -143,7 +188,7 @@ ExecutionResult Builtins::builtinHelp(const std::vector<std::string>& args)
         {
             return {1, "help: no help topics match `" + args[0] + "`", true};
         }
-        std::cout << getHelpText(type) << std::endl;
+        OutputSink::standardOutput() << getHelpText(type) << '\n';
     }
     return {0, "", true};
 }
@@ -152,11 +197,12 @@ ExecutionResult Builtins::builtinIntro(const std::vector<std::string>& args)
 {
     // Basic implementation without color handling for simplicity first
     // Color could be added later based on args[0]
-    std::cout << "Tinyshell Project - Group 1:" << std::endl;
-    std::cout << "  Đặng Tiến Cường (20220020)" << std::endl;
-    std::cout << "  Trần Huy Dương (20230025)" << std::endl;
-    std::cout << "  Phạm Gia Hưng (20230036)" << std::endl;
-    std::cout << "  Ngô Vũ Minh (20230084)" << std::endl;
+    OutputSink& out = OutputSink::standardOutput();
+    out << "Tinyshell Project - Group 1:\n";
+    out << "  Đặng Tiến Cường (20220020)\n";
+    out << "  Trần Huy Dương (20230025)\n";
+    out << "  Phạm Gia Hưng (20230036)\n";
+    out << "  Ngô Vũ Minh (20230084)\n";
     return {0, "", true};
 }
 
@@ -166,10 +212,18 @@ ExecutionResult Builtins::builtinSetVar(const std::vector<std::string>& args, En
     {
         // Maybe list all variables like shell `set`?
         // For now, require VAR=value format.
-        return {1, "setvar: Usage: setvar VAR=value", true};
+        return {1, "setvar: Usage: setvar [-a] VAR=value", true};
     }
 
-    std::string assignment = args[0];
+    // `setvar -a VAR=value` is the same as `setvar VAR+=value`
+    size_t first_arg = (args[0] == "-a") ? 1 : 0;
+    bool append = first_arg == 1;
+    if (first_arg >= args.size())
+    {
+        return {1, "setvar: Usage: setvar [-a] VAR=value", true};
+    }
+
+    const std::string& assignment = args[first_arg];
     size_t equals_pos = assignment.find("=");
 
     if (equals_pos == std::string::npos || equals_pos == 0)
@@ -177,14 +231,80 @@ ExecutionResult Builtins::builtinSetVar(const std::vector<std::string>& args, En
         return {1, "setvar: Invalid format. Usage: setvar VAR=value", true};
     }
 
-    std::string var_name = assignment.substr(0, equals_pos);
+    size_t name_end = equals_pos;
+    if (assignment[equals_pos - 1] == '+')
+    {
+        append = true;
+        --name_end;
+    }
+    std::string var_name = assignment.substr(0, name_end);
     std::string value = assignment.substr(equals_pos + 1);
 
+    // `setvar NAME=( words... )`: the parser passes "NAME=(", the words, then ")"
+    if (value == "(" && args.size() >= first_arg + 2 && args.back() == ")")
+    {
+        if (!Environment::isValidVariableName(var_name))
+        {
+            return {1, "setvar: Invalid variable name: " + var_name, true};
+        }
+        std::vector<std::string> elements(args.begin() + first_arg + 1, args.end() - 1);
+        if (append)
+        {
+            environment.appendToArray(var_name, elements);
+        }
+        else
+        {
+            environment.setArray(var_name, std::move(elements));
+        }
+        return {0, "", true};
+    }
+
+    // `setvar NAME[index]=value`
+    size_t bracket_pos = var_name.find('[');
+    if (bracket_pos != std::string::npos && var_name.back() == ']')
+    {
+        std::string subscript = var_name.substr(bracket_pos + 1, var_name.length() - bracket_pos - 2);
+        var_name.resize(bracket_pos);
+        if (!Environment::isValidVariableName(var_name))
+        {
+            return {1, "setvar: Invalid variable name: " + var_name, true};
+        }
+        long long index = 0;
+        std::string error_message;
+        if (!Expansion::evaluateSubscript(subscript, environment, index, error_message))
+        {
+            return {1, "setvar: " + error_message, true};
+        }
+        const std::vector<std::string>* array = environment.getArray(var_name);
+        size_t length = array ? array->size() : (environment.getVariable(var_name) ? 1 : 0);
+        if (index < 0)
+        {
+            index += static_cast<long long>(length);
+            if (index < 0)
+            {
+                return {1, "setvar: Array index out of range: " + subscript, true};
+            }
+        }
+        if (static_cast<unsigned long long>(index) > length + K_MaxArrayIndexGap)
+        {
+            return {1, "setvar: Array index too far past the end (max " + std::to_string(length + K_MaxArrayIndexGap) +
+                           "): " + subscript, true};
+        }
+        environment.setArrayElement(var_name, static_cast<size_t>(index), value, append);
+        return {0, "", true};
+    }
+
     if (!Environment::isValidVariableName(var_name))
     {
         return {1, "setvar: Invalid variable name: " + var_name, true};
     }
 
+    if (append)
+    {
+        // Grows the stored string in place: building a value in a loop stays linear
+        environment.appendToVariable(var_name, value);
+        return {0, "", true};
+    }
     environment.setVariable(var_name, value);
     return {0, "", true};
 }
@@ -205,7 +325,7 @@ ExecutionResult Builtins::builtinGetVar(const std::vector<std::string>& args, co
     std::optional<std::string> value = environment.getVariable(var_name);
     if (value.has_value())
     {
-        std::cout << value.value() << std::endl;
+        OutputSink::standardOutput() << value.value() << '\n';
         return {0, "", true};
     }
     else
@@ -314,143 +434,599 @@ ExecutionResult Builtins::builtinPwd()
     {
         return {1, "pwd: Cannot determine current path: " + ec.message(), true};
     }
-    std::cout << current_path.string() << std::endl;
+    OutputSink::standardOutput() << current_path.string() << '\n';
     return {0, "", true};
 }
 
-ExecutionResult Builtins::builtinLs(const std::vector<std::string>& args)
+namespace
 {
-    std::filesystem::path target_path = "."; // Default to current directory
-    if (!args.empty())
+constexpr size_t K_ParallelStatThreshold = 256; // Smaller directories are stat'ed inline
+constexpr size_t K_StatBatchSize = 128;         // Entries per pool task
+constexpr size_t K_MaxStatThreads = 8;
+
+// Splits args into single-letter flags (in order) and operands; `--` ends the options.
+// Returns the "invalid option" error for the first flag not in allowed, or "" on success.
+// usage starts with the command name, e.g. "rm [-rf] <path...>".
+std::string parse_short_options(const std::vector<std::string>& args, const std::string& allowed,
+                                const std::string& usage, std::string& flags, std::vector<std::string>& operands)
+{
+    bool options_done = false;
+    for (const std::string& arg : args)
     {
-        target_path = args[0];
+        if (options_done || arg.size() < 2 || arg[0] != '-')
+        {
+            operands.push_back(arg);
+            continue;
+        }
+        if (arg == "--")
+        {
+            options_done = true;
+            continue;
+        }
+        for (size_t i = 1; i < arg.size(); ++i)
+        {
+            if (allowed.find(arg[i]) == std::string::npos)
+            {
+                return usage.substr(0, usage.find(' ')) + ": invalid option -- '" + arg[i] + "'\nUsage: " + usage;
+            }
+            flags += arg[i];
+        }
     }
+    return "";
+}
 
-    std::error_code ec;
-    if (!std::filesystem::exists(target_path, ec) || ec)
+std::string join_errors(const std::vector<std::string>& errors)
+{
+    std::string error_message;
+    for (const std::string& error : errors)
+    {
+        error_message += (error_message.empty() ? "" : "\n") + error;
+    }
+    return error_message;
+}
+
+struct LsOptions
+{
+    bool long_format = false;
+    bool all = false;
+    bool recursive = false;
+    bool by_size = false;
+    bool by_time = false;
+    bool reverse = false;
+};
+
+struct LsEntry
+{
+    LsEntry(std::string entry_name, unsigned char entry_type) : name(std::move(entry_name)), type(entry_type) {}
+
+    std::string name;
+    unsigned char type = DT_UNKNOWN;
+    struct statx info {};
+    bool has_info = false;
+    std::string link_target; // -l only
+};
+
+// Fills in entry.info with statx() relative to dir_fd (symlinks are not followed).
+void stat_entry(int dir_fd, LsEntry& entry, unsigned int mask, bool read_link)
+{
+    entry.has_info = statx(dir_fd, entry.name.c_str(), AT_SYMLINK_NOFOLLOW, mask, &entry.info) == 0;
+    if (!entry.has_info)
     {
-        return {1, "ls: Cannot access `" + target_path.string() + "`: No such file or directory", true};
+        return;
     }
-    if (!std::filesystem::is_directory(target_path, ec) || ec)
+    entry.type = IFTODT(entry.info.stx_mode);
+    if (read_link && S_ISLNK(entry.info.stx_mode))
     {
-        // If it's a file, just print its name
-        std::cout << target_path.filename().string() << std::endl;
-        return {0, "", true};
+        char target[4096];
+        ssize_t length = readlinkat(dir_fd, entry.name.c_str(), target, sizeof(target));
+        if (length > 0)
+        {
+            entry.link_target.assign(target, static_cast<size_t>(length));
+        }
     }
+}
 
-    try
+// stat()s every entry. Large directories are split into batches run on a small pool, so the
+// per-file latency (high on network filesystems) overlaps instead of adding up.
+void stat_entries(int dir_fd, std::vector<LsEntry>& entries, unsigned int mask, bool read_link)
+{
+    if (entries.size() < K_ParallelStatThreshold)
     {
-        for (const auto& entry : std::filesystem::directory_iterator(target_path))
+        for (LsEntry& entry : entries)
         {
-            std::cout << entry.path().filename().string() << std::endl;
+            stat_entry(dir_fd, entry, mask, read_link);
         }
+        return;
     }
-    catch (const std::filesystem::filesystem_error& e)
+    WorkStealingPool pool(std::min(WorkStealingPool::defaultThreadCount(), K_MaxStatThreads));
+    for (size_t begin = 0; begin < entries.size(); begin += K_StatBatchSize)
     {
-        return {1, "ls: Cannot read directory `" + target_path.string() + "`: " + std::string(e.what()), true};
+        size_t end = std::min(begin + K_StatBatchSize, entries.size());
+        pool.submit([&entries, dir_fd, mask, read_link, begin, end]()
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                stat_entry(dir_fd, entries[i], mask, read_link);
+            }
+        });
     }
-
-    return {0, "", true};
+    pool.wait();
 }
 
-ExecutionResult Builtins::builtinMkdir(const std::vector<std::string>& args)
+void sort_entries(std::vector<LsEntry>& entries, const LsOptions& options)
 {
-    if (args.size() != 1)
+    auto by_name = [](const LsEntry& a, const LsEntry& b) { return a.name < b.name; };
+    if (options.by_size)
     {
-        return {1, "mkdir: Usage: mkdir <dirname>", true};
+        std::sort(entries.begin(), entries.end(), [&](const LsEntry& a, const LsEntry& b)
+        {
+            if (a.info.stx_size != b.info.stx_size)
+            {
+                return a.info.stx_size > b.info.stx_size; // Largest first
+            }
+            return by_name(a, b);
+        });
     }
-    std::filesystem::path dir_path = args[0];
-    std::error_code ec;
-    if (std::filesystem::create_directory(dir_path, ec))
+    else if (options.by_time)
     {
-        return {0, "", true};
+        std::sort(entries.begin(), entries.end(), [&](const LsEntry& a, const LsEntry& b)
+        {
+            if (a.info.stx_mtime.tv_sec != b.info.stx_mtime.tv_sec)
+            {
+                return a.info.stx_mtime.tv_sec > b.info.stx_mtime.tv_sec; // Newest first
+            }
+            if (a.info.stx_mtime.tv_nsec != b.info.stx_mtime.tv_nsec)
+            {
+                return a.info.stx_mtime.tv_nsec > b.info.stx_mtime.tv_nsec;
+            }
+            return by_name(a, b);
+        });
     }
     else
     {
-        std::string error_msg = "mkdir: Cannot create directory `" + dir_path.string() + "`: " + ec.message();
-        if (std::filesystem::exists(dir_path)) // More specific error if it exists
+        std::sort(entries.begin(), entries.end(), by_name);
+    }
+    if (options.reverse)
+    {
+        std::reverse(entries.begin(), entries.end());
+    }
+}
+
+std::string format_mode(uint16_t mode)
+{
+    char text[11];
+    switch (mode & S_IFMT)
+    {
+        case S_IFDIR:  text[0] = 'd'; break;
+        case S_IFLNK:  text[0] = 'l'; break;
+        case S_IFCHR:  text[0] = 'c'; break;
+        case S_IFBLK:  text[0] = 'b'; break;
+        case S_IFIFO:  text[0] = 'p'; break;
+        case S_IFSOCK: text[0] = 's'; break;
+        default:       text[0] = '-'; break;
+    }
+    const char* letters = "rwxrwxrwx";
+    for (int bit = 0; bit < 9; ++bit)
+    {
+        text[1 + bit] = (mode & (0400 >> bit)) ? letters[bit] : '-';
+    }
+    if (mode & S_ISUID) text[3] = (mode & S_IXUSR) ? 's' : 'S';
+    if (mode & S_ISGID) text[6] = (mode & S_IXGRP) ? 's' : 'S';
+    if (mode & S_ISVTX) text[9] = (mode & S_IXOTH) ? 't' : 'T';
+    text[10] = '\0';
+    return text;
+}
+
+// User and group names, looked up once per id.
+const std::string& owner_name(uint32_t id, bool group)
+{
+    static std::unordered_map<uint32_t, std::string> user_names;
+    static std::unordered_map<uint32_t, std::string> group_names;
+    std::unordered_map<uint32_t, std::string>& names = group ? group_names : user_names;
+    auto it = names.find(id);
+    if (it == names.end())
+    {
+        const char* name = nullptr;
+        if (group)
+        {
+            struct group* entry = getgrgid(id);
+            name = entry ? entry->gr_name : nullptr;
+        }
+        else
+        {
+            struct passwd* entry = getpwuid(id);
+            name = entry ? entry->pw_name : nullptr;
+        }
+        it = names.emplace(id, name ? name : std::to_string(id)).first;
+    }
+    return it->second;
+}
+
+std::string format_time(const struct statx_timestamp& timestamp, time_t now)
+{
+    time_t seconds = static_cast<time_t>(timestamp.tv_sec);
+    struct tm local_time;
+    localtime_r(&seconds, &local_time);
+    char text[32];
+    // Like GNU ls: the year replaces the time for files older than six months (or in the future)
+    constexpr time_t K_SixMonths = 31556952 / 2;
+    bool recent = seconds <= now && now - seconds < K_SixMonths;
+    strftime(text, sizeof(text), recent ? "%b %e %H:%M" : "%b %e  %Y", &local_time);
+    return text;
+}
+
+void append_padded(std::string& line, const std::string& text, size_t width, bool left_align)
+{
+    if (!left_align)
+    {
+        line.append(width > text.length() ? width - text.length() : 0, ' ');
+    }
+    line += text;
+    if (left_align)
+    {
+        line.append(width > text.length() ? width - text.length() : 0, ' ');
+    }
+}
+
+void write_long_listing(OutputSink& out, const std::vector<LsEntry>& entries, bool show_total)
+{
+    size_t link_width = 0;
+    size_t user_width = 0;
+    size_t group_width = 0;
+    size_t size_width = 0;
+    uint64_t total_blocks = 0;
+    for (const LsEntry& entry : entries)
+    {
+        if (!entry.has_info)
         {
-            error_msg = "mkdir: Cannot create directory `" + dir_path.string() + "`: File exists";
+            continue;
         }
-        return {1, error_msg, true};
+        link_width = std::max(link_width, std::to_string(entry.info.stx_nlink).length());
+        user_width = std::max(user_width, owner_name(entry.info.stx_uid, false).length());
+        group_width = std::max(group_width, owner_name(entry.info.stx_gid, true).length());
+        size_width = std::max(size_width, std::to_string(entry.info.stx_size).length());
+        total_blocks += entry.info.stx_blocks;
+    }
+    if (show_total)
+    {
+        out << "total " << (total_blocks + 1) / 2 << '\n'; // 512-byte blocks -> KiB
+    }
+
+    time_t now = time(nullptr);
+    std::string line;
+    for (const LsEntry& entry : entries)
+    {
+        line.clear();
+        if (!entry.has_info)
+        {
+            line = "?????????? ? ? ? ? ? " + entry.name;
+        }
+        else
+        {
+            line = format_mode(entry.info.stx_mode);
+            line += ' ';
+            append_padded(line, std::to_string(entry.info.stx_nlink), link_width, false);
+            line += ' ';
+            append_padded(line, owner_name(entry.info.stx_uid, false), user_width, true);
+            line += ' ';
+            append_padded(line, owner_name(entry.info.stx_gid, true), group_width, true);
+            line += ' ';
+            append_padded(line, std::to_string(entry.info.stx_size), size_width, false);
+            line += ' ';
+            line += format_time(entry.info.stx_mtime, now);
+            line += ' ';
+            line += entry.name;
+            if (!entry.link_target.empty())
+            {
+                line += " -> " + entry.link_target;
+            }
+        }
+        line += '\n';
+        out << line;
     }
 }
 
-ExecutionResult Builtins::builtinRm(const std::vector<std::string>& args)
+unsigned int stat_mask(const LsOptions& options)
 {
-    if (args.size() != 1)
+    unsigned int mask = STATX_TYPE;
+    if (options.long_format)
     {
-        return {1, "rm: Usage: rm <filename_or_empty_dirname>", true};
+        mask |= STATX_MODE | STATX_NLINK | STATX_UID | STATX_GID | STATX_SIZE | STATX_MTIME | STATX_BLOCKS;
     }
-    std::filesystem::path path_to_remove = args[0];
-    std::error_code ec;
+    if (options.by_size)
+    {
+        mask |= STATX_SIZE;
+    }
+    if (options.by_time)
+    {
+        mask |= STATX_MTIME;
+    }
+    return mask;
+}
 
-    // Check existence first for a better error message
-    if (!std::filesystem::exists(path_to_remove, ec))
+// Lists one directory (dir_fd stays owned by the caller) and, with -R, its subdirectories.
+// `cached_entries` is the shared DirectoryCache listing for top-level operands, or nullptr.
+void list_directory(int dir_fd, const std::string& path, const DirectoryCache::EntryList* cached_entries,
+                    const LsOptions& options, bool show_header, OutputSink& out, std::string& error_message)
+{
+    std::vector<DirectoryEntry> raw_entries;
+    if (!cached_entries)
     {
-        return {1, "rm: Cannot remove `" + path_to_remove.string() + "`: No such file or directory", true};
+        if (!read_directory_entries(dir_fd, raw_entries))
+        {
+            error_message += (error_message.empty() ? "" : "\n") + std::string("ls: Cannot read directory `") +
+                             path + "`: " + std::strerror(errno);
+            return;
+        }
+        cached_entries = &raw_entries;
     }
 
-    // Check if it's a directory and if it's empty (basic check)
-    if (std::filesystem::is_directory(path_to_remove, ec))
+    std::vector<LsEntry> entries;
+    entries.reserve(cached_entries->size() + 2);
+    if (options.all)
+    {
+        entries.push_back({".", DT_DIR});
+        entries.push_back({"..", DT_DIR});
+    }
+    for (const DirectoryEntry& raw_entry : *cached_entries)
     {
-        if (!std::filesystem::is_empty(path_to_remove, ec))
+        if (options.all || raw_entry.name[0] != '.')
         {
-             return {1, "rm: Cannot remove `" + path_to_remove.string() + "`: Directory not empty", true};
+            entries.push_back({raw_entry.name, raw_entry.type});
         }
     }
-    else if (ec) // Error checking if it's a directory
+
+    // Metadata is only fetched when the output needs it (or the entry type is unknown)
+    bool need_info = options.long_format || options.by_size || options.by_time;
+    if (!need_info && options.recursive)
+    {
+        need_info = std::any_of(entries.begin(), entries.end(),
+                                [](const LsEntry& entry) { return entry.type == DT_UNKNOWN; });
+    }
+    if (need_info)
     {
-         return {1, "rm: Cannot check status of `" + path_to_remove.string() + "`: " + ec.message(), true};
+        stat_entries(dir_fd, entries, stat_mask(options), options.long_format);
     }
+    sort_entries(entries, options);
 
-    // Attempt removal
-    if (std::filesystem::remove(path_to_remove, ec))
+    if (show_header)
     {
-        return {0, "", true};
+        out << path << ":\n";
+    }
+    if (options.long_format)
+    {
+        write_long_listing(out, entries, true);
     }
     else
     {
-        return {1, "rm: Cannot remove `" + path_to_remove.string() + "`: " + ec.message(), true};
+        for (const LsEntry& entry : entries)
+        {
+            out << entry.name << '\n';
+        }
+    }
+
+    if (!options.recursive)
+    {
+        return;
+    }
+    for (const LsEntry& entry : entries)
+    {
+        if (entry.type != DT_DIR || entry.name == "." || entry.name == "..")
+        {
+            continue; // Symlinks to directories are not followed
+        }
+        std::string child_path = (path == "/") ? "/" + entry.name : path + "/" + entry.name;
+        int child_fd = openat(dir_fd, entry.name.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        out << '\n';
+        if (child_fd < 0)
+        {
+            error_message += (error_message.empty() ? "" : "\n") + std::string("ls: Cannot open directory `") +
+                             child_path + "`: " + std::strerror(errno);
+            continue;
+        }
+        list_directory(child_fd, child_path, nullptr, options, true, out, error_message);
+        close(child_fd);
     }
 }
+}
 
-ExecutionResult Builtins::builtinCat(const std::vector<std::string>& args)
+ExecutionResult Builtins::builtinLs(const std::vector<std::string>& args)
 {
-    if (args.size() != 1)
+    LsOptions options;
+    std::string flags;
+    std::vector<std::string> operands;
+    std::string option_error = parse_short_options(args, "laRStr", "ls [-laRStr] [path...]", flags, operands);
+    if (!option_error.empty())
     {
-        return {1, "cat: Usage: cat <filename>", true};
+        return {2, option_error, true};
+    }
+    for (char flag : flags)
+    {
+        switch (flag)
+        {
+            case 'l': options.long_format = true; break;
+            case 'a': options.all = true; break;
+            case 'R': options.recursive = true; break;
+            case 'S': options.by_size = true; options.by_time = false; break;
+            case 't': options.by_time = true; options.by_size = false; break;
+            case 'r': options.reverse = true; break;
+        }
+    }
+    if (operands.empty())
+    {
+        operands.push_back(".");
+    }
+
+    // Like other ls implementations: file operands first (as one listing), then directories
+    OutputSink& out = OutputSink::standardOutput();
+    std::string error_message;
+    std::vector<LsEntry> file_operands;
+    std::vector<std::string> directory_operands;
+    for (const std::string& operand : operands)
+    {
+        struct stat operand_stat;
+        if (stat(operand.c_str(), &operand_stat) != 0)
+        {
+            error_message += (error_message.empty() ? "" : "\n") + std::string("ls: Cannot access `") + operand +
+                             "`: " + std::strerror(errno);
+        }
+        else if (S_ISDIR(operand_stat.st_mode))
+        {
+            directory_operands.push_back(operand);
+        }
+        else
+        {
+            LsEntry entry(operand, DT_UNKNOWN);
+            stat_entry(AT_FDCWD, entry, stat_mask(options) | STATX_TYPE, options.long_format);
+            file_operands.push_back(std::move(entry));
+        }
     }
-    std::filesystem::path file_path = args[0];
-    std::error_code ec;
 
-    if (!std::filesystem::exists(file_path, ec) || ec)
+    sort_entries(file_operands, options);
+    if (options.long_format)
     {
-        return {1, "cat: `" + file_path.string() + "`: No such file or directory", true};
+        write_long_listing(out, file_operands, false);
     }
-    if (std::filesystem::is_directory(file_path, ec) || ec)
+    else
     {
-        return {1, "cat: `" + file_path.string() + "`: Is a directory", true};
+        for (const LsEntry& entry : file_operands)
+        {
+            out << entry.name << '\n';
+        }
     }
 
-    std::ifstream input_file(file_path);
-    if (!input_file.is_open())
+    std::sort(directory_operands.begin(), directory_operands.end());
+    bool show_headers = options.recursive || operands.size() > 1;
+    for (size_t i = 0; i < directory_operands.size(); ++i)
     {
-        return {1, "cat: `" + file_path.string() + "`: Permission denied or other error opening file", true};
+        const std::string& path = directory_operands[i];
+        if (i > 0 || !file_operands.empty())
+        {
+            out << '\n';
+        }
+        int dir_fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        // Shared with globbing: listing a directory that was just globbed (or listed) hits memory
+        std::shared_ptr<const DirectoryCache::EntryList> cached = DirectoryCache::instance().getEntries(path);
+        if (dir_fd < 0 || !cached)
+        {
+            error_message += (error_message.empty() ? "" : "\n") + std::string("ls: Cannot read directory `") +
+                             path + "`: " + std::strerror(dir_fd < 0 ? errno : EACCES);
+            if (dir_fd >= 0)
+            {
+                close(dir_fd);
+            }
+            continue;
+        }
+        list_directory(dir_fd, path, cached.get(), options, show_headers, out, error_message);
+        close(dir_fd);
     }
 
-    std::string line;
-    while (std::getline(input_file, line))
+    return {error_message.empty() ? 0 : 1, error_message, true};
+}
+
+ExecutionResult Builtins::builtinMkdir(const std::vector<std::string>& args)
+{
+    std::string flags;
+    std::vector<std::string> operands;
+    std::string option_error = parse_short_options(args, "p", "mkdir [-p] <dirname...>", flags, operands);
+    if (!option_error.empty())
+    {
+        return {1, option_error, true};
+    }
+    bool parents = !flags.empty();
+    if (operands.empty())
     {
-        std::cout << line << std::endl;
+        return {1, "mkdir: Usage: mkdir [-p] <dirname...>", true};
     }
 
-    if (input_file.bad())
+    std::vector<std::string> errors = make_directories(operands, parents);
+    return {errors.empty() ? 0 : 1, join_errors(errors), true};
+}
+
+ExecutionResult Builtins::builtinRm(const std::vector<std::string>& args)
+{
+    std::string flags;
+    std::vector<std::string> operands;
+    std::string option_error = parse_short_options(args, "rRf", "rm [-rf] <path...>", flags, operands);
+    if (!option_error.empty())
     {
-         return {1, "cat: Error reading file `" + file_path.string() + "`", true};
+        return {1, option_error, true};
+    }
+    bool recursive = flags.find_first_of("rR") != std::string::npos;
+    bool force = flags.find('f') != std::string::npos;
+    if (operands.empty())
+    {
+        return {force ? 0 : 1, force ? "" : "rm: Usage: rm [-rf] <path...>", true};
     }
 
-    return {0, "", true};
+    std::vector<std::string> errors = remove_paths(operands, recursive, force);
+    return {errors.empty() ? 0 : 1, join_errors(errors), true};
+}
+
+ExecutionResult Builtins::builtinCp(const std::vector<std::string>& args)
+{
+    std::string flags;
+    std::vector<std::string> operands;
+    std::string option_error = parse_short_options(args, "rR", "cp [-r] <source...> <destination>", flags, operands);
+    if (!option_error.empty())
+    {
+        return {1, option_error, true};
+    }
+    bool recursive = !flags.empty();
+    if (operands.size() < 2)
+    {
+        return {1, "cp: Usage: cp [-r] <source...> <destination>", true};
+    }
+
+    std::string destination = operands.back();
+    operands.pop_back();
+    std::vector<std::string> errors = copy_paths(operands, destination, recursive);
+    return {errors.empty() ? 0 : 1, join_errors(errors), true};
+}
+
+ExecutionResult Builtins::builtinCat(const std::vector<std::string>& args)
+{
+    // File data goes straight to the descriptor, so earlier buffered output must go first
+    OutputSink::flushAll();
+
+    std::vector<std::string> operands = args.empty() ? std::vector<std::string>{"-"} : args;
+    std::string error_message;
+    auto report_error = [&](const std::string& operand, const std::string& reason)
+    {
+        error_message += (error_message.empty() ? "" : "\n") + std::string("cat: `") + operand + "`: " + reason;
+    };
+
+    for (const std::string& operand : operands)
+    {
+        if (operand == "-")
+        {
+            // Shell stdin is shared with the command reader: copy it through std::cin
+            OutputSink& out = OutputSink::standardOutput();
+            std::vector<char> buffer(OutputSink::K_DefaultBufferSize);
+            while (std::cin.read(buffer.data(), static_cast<std::streamsize>(buffer.size())) || std::cin.gcount() > 0)
+            {
+                out.write(buffer.data(), static_cast<size_t>(std::cin.gcount()));
+            }
+            std::cin.clear();
+            out.flush();
+            continue;
+        }
+
+        int input_fd = open(operand.c_str(), O_RDONLY | O_CLOEXEC);
+        if (input_fd < 0)
+        {
+            report_error(operand, std::strerror(errno));
+            continue;
+        }
+        uint64_t bytes_copied = 0;
+        if (!copy_descriptor_data(input_fd, STDOUT_FILENO, bytes_copied))
+        {
+            report_error(operand, std::strerror(errno));
+        }
+        close(input_fd);
+    }
+
+    return {error_message.empty() ? 0 : 1, error_message, true};
 }
 
 ExecutionResult Builtins::builtinPath(const Environment& environment)
@@ -459,7 +1035,7 @@ ExecutionResult Builtins::builtinPath(const Environment& environment)
     const char* path_var = std::getenv("PATH");
     if (path_var != nullptr)
     {
-        std::cout << path_var << std::endl;
+        OutputSink::standardOutput() << path_var << '\n';
     }
     else
     {
@@ -510,26 +1086,49 @@ ExecutionResult Builtins::builtinC(const std::vector<std::string>& args)
 {
     if (args.empty())
     {
-        return {1, "c: Usage: c <source.c> [compile_args...]", true};
+        return {1, "c: Usage: c [flags...] <source.c...> [-- args...]", true};
     }
-    std::string source_file = args[0];
-    std::vector<std::string> compile_args(args.begin() + 1, args.end());
-    return compileAndRun("gcc", source_file, compile_args);
+    return compileAndRun("gcc", args);
 }
 
 ExecutionResult Builtins::builtinCpp(const std::vector<std::string>& args)
 {
     if (args.empty())
     {
-        return {1, "cpp: Usage: cpp <source.cpp> [compile_args...]", true};
+        return {1, "cpp: Usage: cpp [flags...] <source.cpp...> [-- args...]", true};
     }
-    std::string source_file = args[0];
-    std::vector<std::string> compile_args(args.begin() + 1, args.end());
-    return compileAndRun("g++", source_file, compile_args);
+    return compileAndRun("g++", args);
 }
 
 ExecutionResult Builtins::builtinHistory(const std::vector<std::string>& args, const ShellCore& shell_core)
 {
+    const auto& history = shell_core.getHistory();
+    OutputSink& out = OutputSink::standardOutput();
+    if (!args.empty() && args[0] == "-s")
+    {
+        if (args.size() < 2)
+        {
+            return {1, "history: -s: Pattern required", true};
+        }
+        std::string pattern = args[1];
+        for (size_t i = 2; i < args.size(); ++i)
+        {
+            pattern += " " + args[i];
+        }
+        // The same backward steps a reverse-search prompt takes, printed oldest first
+        std::vector<size_t> matches;
+        size_t match = history.size();
+        while (history.searchBackward(pattern, match, match))
+        {
+            matches.push_back(match);
+        }
+        for (auto it = matches.rbegin(); it != matches.rend(); ++it)
+        {
+            out << "  " << (*it + 1) << "  " << history.at(*it) << '\n';
+        }
+        return {matches.empty() ? 1 : 0, "", true};
+    }
+
     int count = -1; // Default: show all
     if (!args.empty())
     {
@@ -552,7 +1151,6 @@ ExecutionResult Builtins::builtinHistory(const std::vector<std::string>& args, c
         }
     }
 
-    const auto& history = shell_core.getHistory();
     int start_index = 0;
     if (count > 0 && static_cast<int>(history.size()) > count)
     {
@@ -561,8 +1159,7 @@ ExecutionResult Builtins::builtinHistory(const std::vector<std::string>& args, c
 
     for (size_t i = start_index; i < history.size(); ++i)
     {
-        // Consider adding line numbers
-        std::cout << "  " << (i + 1) << "  " << history[i] << std::endl;
+        out << "  " << (i + 1) << "  " << history.at(i) << '\n';
     }
 
     return {0, "", true};
@@ -601,53 +1198,87 @@ ExecutionResult Builtins::builtinTest(const std::vector<std::string>& args)
 
 // --- Helper Functions ---
 
-ExecutionResult Builtins::compileAndRun(const std::string& compiler, const std::string& source_file, const std::vector<std::string>& args)
+ExecutionResult Builtins::compileAndRun(const std::string& compiler, const std::vector<std::string>& args)
 {
-    std::error_code ec;
-    if (!std::filesystem::exists(source_file, ec) || !std::filesystem::is_regular_file(source_file, ec))
+    // Leading arguments are sources and compiler flags; the program's own arguments start at
+    // `--` or at the first argument that is neither
+    ProgramBuild build;
+    build.compiler = compiler;
+    size_t i = 0;
+    for (; i < args.size(); ++i)
+    {
+        const std::string& arg = args[i];
+        if (arg == "--")
+        {
+            ++i;
+            break;
+        }
+        if (arg.size() > 1 && arg[0] == '-')
+        {
+            if (arg == "-o" || arg == "-c" || arg == "-S" || arg == "-E")
+            {
+                return {1, compiler + ": `" + arg + "` is not supported; the build cache chooses the output", true};
+            }
+            // `-I dir` and friends take the next argument as their value
+            std::vector<std::string> words = {arg};
+            bool takes_value = arg == "-I" || arg == "-D" || arg == "-U" || arg == "-L" || arg == "-l" ||
+                               arg == "-include" || arg == "-isystem" || arg == "-x";
+            if (takes_value && i + 1 < args.size())
+            {
+                words.push_back(args[++i]);
+            }
+            bool link_only = arg.compare(0, 2, "-l") == 0 || arg.compare(0, 2, "-L") == 0 || arg.compare(0, 4, "-Wl,") == 0;
+            bool compile_only = arg.compare(0, 2, "-I") == 0 || arg.compare(0, 2, "-D") == 0 || arg.compare(0, 2, "-U") == 0 ||
+                                arg == "-include" || arg == "-isystem" || arg == "-x" || arg.compare(0, 5, "-std=") == 0;
+            for (const std::string& word : words)
+            {
+                if (!link_only)
+                {
+                    build.compile_flags.push_back(word);
+                }
+                if (!compile_only)
+                {
+                    build.link_items.push_back(word);
+                }
+            }
+            continue;
+        }
+        std::string extension = std::filesystem::path(arg).extension().string();
+        if (extension == ".c" || extension == ".cc" || extension == ".cpp" || extension == ".cxx" || extension == ".C")
+        {
+            build.sources.push_back(arg);
+        }
+        else if (extension == ".o" || extension == ".a" || extension == ".so")
+        {
+            build.link_items.push_back(arg);
+        }
+        else
+        {
+            break;
+        }
+    }
+    if (build.sources.empty())
     {
-        return {1, compiler + ": Source file not found or is not a regular file: " + source_file, true};
+        return {1, compiler + ": No source file given", true};
     }
 
-    // Create a temporary executable name
-    std::filesystem::path temp_dir = std::filesystem::temp_directory_path(ec);
-    if (ec)
+    int build_status = 0;
+    std::string build_error;
+    std::string executable = build_program(build, build_status, build_error);
+    if (executable.empty())
     {
-        temp_dir = "."; // Fallback to current directory
+        return {build_status, build_error, true};
     }
-    std::filesystem::path temp_executable = temp_dir / (std::filesystem::path(source_file).stem().string() + "_temp_exec");
-#ifdef _WIN32
-    temp_executable += ".exe";
-#endif
-
-    // Construct compile command
-    std::stringstream compile_command_ss;
-    compile_command_ss << compiler << " \"" << source_file << "\" -o \"" << temp_executable.string() << "\"";
-    // Add extra compile args if any (simple space separation, no complex quoting handled)
-    // This part is basic and might fail with complex arguments.
-    // for (const auto& arg : args) { compile_command_ss << " " << arg; }
 
-    // Execute compile command
-    int compile_status = std::system(compile_command_ss.str().c_str());
-    if (compile_status != 0)
+    // Execute the compiled program directly with its arguments; it stays in the cache for the next run
+    std::vector<std::string> run_argv = {executable};
+    run_argv.insert(run_argv.end(), args.begin() + i, args.end());
+    OutputSink::flushAll();
+    int run_status = run_program(run_argv);
+    if (run_status < 0)
     {
-        std::filesystem::remove(temp_executable, ec); // Clean up even if compile failed
-        return {compile_status, compiler + ": Compilation failed (exit code: " + std::to_string(compile_status) + ")", true};
+        return {126, compiler + ": Cannot run `" + executable + "`: " + std::strerror(errno), true};
     }
-
-    // Construct run command
-    std::stringstream run_command_ss;
-    run_command_ss << "\"" << temp_executable.string() << "\"";
-    // Add runtime args
-    for (const auto& arg : args) { run_command_ss << " \"" << arg << "\""; } // Basic quoting for args
-
-    // Execute the compiled program
-    int run_status = std::system(run_command_ss.str().c_str());
-
-    // Clean up temporary executable
-    std::filesystem::remove(temp_executable, ec);
-    // Ignore cleanup error? Maybe log it.
-
     return {run_status, "", true};
 }
 
@@ -739,6 +1370,271 @@ bool Builtins::compareIntegers(long long val1, const std::string& op, long long
     return false; // Should not happen if called correctly
 }
 
+std::string Builtins::parseReadArguments(const std::vector<std::string>& args, bool& raw,
+                                         std::vector<std::string>& variable_names)
+{
+    raw = false;
+    variable_names.clear();
+    for (const std::string& arg : args)
+    {
+        if (variable_names.empty() && arg == "-r")
+        {
+            raw = true;
+        }
+        else if (Environment::isValidVariableName(arg))
+        {
+            variable_names.push_back(arg);
+        }
+        else
+        {
+            return "read: `" + arg + "`: Not a valid identifier";
+        }
+    }
+    if (variable_names.empty())
+    {
+        variable_names.push_back("REPLY");
+    }
+    return "";
+}
+
+void Builtins::assignReadFields(const std::string& line, const std::vector<std::string>& variable_names,
+                                bool raw, Environment& environment)
+{
+    auto is_blank = [](char c) { return c == ' ' || c == '\t'; };
+    size_t position = 0;
+    std::string field;
+    for (size_t i = 0; i < variable_names.size(); ++i)
+    {
+        bool last_variable = i + 1 == variable_names.size();
+        while (position < line.length() && is_blank(line[position]))
+        {
+            ++position;
+        }
+        field.clear();
+        size_t kept_length = 0; // Field length without trailing blanks
+        while (position < line.length())
+        {
+            char c = line[position];
+            if (!raw && c == '\\' && position + 1 < line.length())
+            {
+                field += line[position + 1];
+                position += 2;
+                kept_length = field.length();
+                continue;
+            }
+            if (is_blank(c) && !last_variable)
+            {
+                break;
+            }
+            field += c;
+            ++position;
+            if (!is_blank(c))
+            {
+                kept_length = field.length();
+            }
+        }
+        field.resize(kept_length);
+        environment.setVariable(variable_names[i], field);
+    }
+}
+
+ExecutionResult Builtins::builtinRead(const std::vector<std::string>& args, Environment& environment, LineReader* input_reader)
+{
+    bool raw = false;
+    std::vector<std::string> variable_names;
+    std::string error_message = parseReadArguments(args, raw, variable_names);
+    if (!error_message.empty())
+    {
+        return {2, error_message, true};
+    }
+
+    // Loop input comes through the loop's buffered reader. Plain stdin is shared with the
+    // command reader, so it is read through std::cin to never consume lines meant for the shell.
+    std::string line;
+    if (!input_reader)
+    {
+        OutputSink::flushAll(); // A prompt printed just before must be visible while we wait
+    }
+    bool got_line = input_reader ? input_reader->nextLine(line) : static_cast<bool>(std::getline(std::cin, line));
+    if (!got_line)
+    {
+        for (const std::string& variable_name : variable_names)
+        {
+            environment.setVariable(variable_name, "");
+        }
+        return {1, "", true};
+    }
+    assignReadFields(line, variable_names, raw, environment);
+    return {0, "", true};
+}
+
+namespace
+{
+// Reads everything from fd: one read() sized from fstat for regular files, chunks otherwise.
+bool read_whole_fd(int fd, std::string& content)
+{
+    struct stat file_stat;
+    size_t capacity = (fstat(fd, &file_stat) == 0 && S_ISREG(file_stat.st_mode)) ? file_stat.st_size + 1 : 64 * 1024;
+    content.resize(capacity);
+    size_t length = 0;
+    while (true)
+    {
+        if (length == content.size())
+        {
+            content.resize(content.size() * 2);
+        }
+        ssize_t bytes_read = read(fd, &content[length], content.size() - length);
+        if (bytes_read < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (bytes_read < 0)
+        {
+            return false;
+        }
+        if (bytes_read == 0)
+        {
+            break;
+        }
+        length += bytes_read;
+    }
+    content.resize(length);
+    return true;
+}
+
+// Splits text into lines with memchr (vectorized in the C library): one pass to count them,
+// so the array is allocated once, and one pass to copy them.
+void split_lines(const std::string& text, bool strip_newlines, std::vector<std::string>& lines)
+{
+    const char* data = text.data();
+    const char* end = data + text.size();
+    size_t line_count = 0;
+    for (const char* cursor = data; cursor < end; ++line_count)
+    {
+        const char* newline = static_cast<const char*>(std::memchr(cursor, '\n', end - cursor));
+        cursor = newline ? newline + 1 : end;
+    }
+    lines.reserve(lines.size() + line_count);
+    for (const char* cursor = data; cursor < end;)
+    {
+        const char* newline = static_cast<const char*>(std::memchr(cursor, '\n', end - cursor));
+        const char* line_end = newline ? newline : end;
+        size_t kept = (line_end - cursor) + ((newline && !strip_newlines) ? 1 : 0);
+        lines.emplace_back(cursor, kept);
+        cursor = newline ? newline + 1 : end;
+    }
+}
+}
+
+ExecutionResult Builtins::builtinMapfile(const std::vector<std::string>& args, Environment& environment, LineReader* input_reader)
+{
+    bool strip_newlines = false;
+    std::string array_name;
+    std::string input_path;
+    for (size_t i = 0; i < args.size(); ++i)
+    {
+        if (args[i] == "-t")
+        {
+            strip_newlines = true;
+        }
+        else if (args[i] == "<" && i + 1 < args.size())
+        {
+            input_path = args[++i];
+        }
+        else if (array_name.empty() && Environment::isValidVariableName(args[i]))
+        {
+            array_name = args[i];
+        }
+        else
+        {
+            return {2, "mapfile: Usage: mapfile [-t] [array] [< file]", true};
+        }
+    }
+    if (array_name.empty())
+    {
+        array_name = "MAPFILE";
+    }
+
+    std::vector<std::string> lines;
+    if (!input_path.empty())
+    {
+        int input_fd = open(input_path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (input_fd < 0)
+        {
+            return {1, "mapfile: Cannot open `" + input_path + "`: " + std::strerror(errno), true};
+        }
+        std::string content;
+        bool read_ok = read_whole_fd(input_fd, content);
+        close(input_fd);
+        if (!read_ok)
+        {
+            return {1, "mapfile: Error reading `" + input_path + "`", true};
+        }
+        split_lines(content, strip_newlines, lines);
+    }
+    else if (input_reader)
+    {
+        // Rest of the enclosing `while ... done < file` input
+        std::string line;
+        while (input_reader->nextLine(line))
+        {
+            lines.push_back(strip_newlines ? line : line + '\n');
+        }
+    }
+    else
+    {
+        // Shell stdin is shared with the command reader: take the rest of it through std::cin
+        OutputSink::flushAll();
+        std::string content((std::istreambuf_iterator<char>(std::cin)), std::istreambuf_iterator<char>());
+        split_lines(content, strip_newlines, lines);
+    }
+
+    environment.setArray(array_name, std::move(lines));
+    return {0, "", true};
+}
+
+ExecutionResult Builtins::builtinPrintf(const std::vector<std::string>& args, Environment& environment)
+{
+    size_t format_index = 0;
+    std::string target_variable;
+    if (format_index < args.size() && args[format_index] == "-v")
+    {
+        if (format_index + 1 >= args.size())
+        {
+            return {2, "printf: -v: option requires an argument", true};
+        }
+        target_variable = args[format_index + 1];
+        if (!Environment::isValidVariableName(target_variable))
+        {
+            return {2, "printf: `" + target_variable + "': not a valid identifier", true};
+        }
+        format_index += 2;
+    }
+    if (format_index < args.size() && args[format_index] == "--")
+    {
+        ++format_index;
+    }
+    if (format_index >= args.size())
+    {
+        return {2, "printf: Usage: printf [-v var] format [arguments]", true};
+    }
+
+    std::shared_ptr<const PrintfFormat> format = PrintfFormat::get(args[format_index]);
+    std::string output;
+    std::string error_message;
+    bool ok = format->format(args, format_index + 1, output, error_message);
+
+    if (!target_variable.empty())
+    {
+        environment.setVariable(target_variable, output);
+    }
+    else
+    {
+        OutputSink::standardOutput().write(output.data(), output.size());
+    }
+    return {ok ? 0 : 1, error_message, true};
+}
+
 // --- Help Text Generation ---
 
 std::string Builtins::listBuiltins()
@@ -754,17 +1650,22 @@ std::string Builtins::listBuiltins()
     ss << "  unsetvar VAR     Unset internal shell variable VAR.\n";
     ss << "  cd [dir]         Change the current directory.\n";
     ss << "  pwd              Print the current working directory.\n";
-    ss << "  ls [path]        List directory contents (basic).\n";
-    ss << "  mkdir <dirname>  Create a directory.\n";
-    ss << "  rm <path>        Remove a file or empty directory.\n";
-    ss << "  cat <filename>   Concatenate and print files.\n";
+    ss << "  ls [-laRStr] [path...] List directory contents.\n";
+    ss << "  mkdir [-p] <dirname...> Create directories.\n";
+    ss << "  rm [-rf] <path...> Remove files or directories.\n";
+    ss << "  cp [-r] <src...> <dst> Copy files or directory trees.\n";
+    ss << "  cat [file...]    Concatenate and print files.\n";
     ss << "  path             Display the system PATH variable.\n";
     ss << "  addpath <dir>    Add directory to internal TINYSHELL_PATH (conceptual).\n";
-    ss << "  c <src> [args]   Compile and run a C source file using gcc.\n";
-    ss << "  cpp <src> [args] Compile and run a C++ source file using g++.\n";
+    ss << "  c [flags] <src...> [-- args] Compile and run a C program using gcc.\n";
+    ss << "  cpp [flags] <src...> [-- args] Compile and run a C++ program using g++.\n";
     ss << "  history [n]      Display command history (last n commands).\n";
+    ss << "  history -s pat   Search command history for a substring.\n";
     ss << "  test expr        Evaluate conditional expression.\n";
     ss << "  [ expr ]         Alias for test command.\n";
+    ss << "  read [-r] [var]  Read a line into variables (default REPLY).\n";
+    ss << "  mapfile [-t] arr [< file] Read all lines into array arr.\n";
+    ss << "  printf [-v var] fmt [args] Format and print arguments.\n";
     // ss << "  cat_spin         (Optional fun command).\n";
     return ss.str();
 }
@@ -777,21 +1678,25 @@ std::string Builtins::getHelpText(BuiltinCommandType type)
         case BuiltinCommandType::Echo:    return "echo [args...]: Write arguments to standard output.\n    Outputs the ARGs, separated by spaces, followed by a newline.";
         case BuiltinCommandType::Help:    return "help [pattern...]: Display help for built-in commands.\n    Displays brief summaries of built-in commands. If PATTERN is specified,\n    gives detailed help on command matching PATTERN.";
         case BuiltinCommandType::Intro:   return "intro [color]: Display group information.\n    Shows the names and IDs of Group 1 members. Optional color argument (not fully implemented). ";
-        case BuiltinCommandType::SetVar:  return "setvar VAR=value: Set internal shell variable.\n    Assigns VALUE to the internal shell variable VAR.";
+        case BuiltinCommandType::SetVar:  return "setvar [-a] VAR=value: Set internal shell variable.\n    Assigns VALUE to the internal shell variable VAR.\n    VAR+=value (or -a) appends VALUE in place; NAME+=( words ) appends array elements.";
         case BuiltinCommandType::GetVar:  return "getvar VAR: Display the value of internal variable VAR.\n    Prints the value of the specified internal variable.";
         case BuiltinCommandType::UnsetVar:return "unsetvar VAR: Unset internal shell variable VAR.\n    Removes the specified variable from the internal shell environment.";
         case BuiltinCommandType::Cd:      return "cd [dir]: Change the shell working directory.\n    Change the current directory to DIR. The default DIR is the value of the\n    HOME environment variable.";
         case BuiltinCommandType::Pwd:     return "pwd: Print the name of the current working directory.";
-        case BuiltinCommandType::Ls:      return "ls [path]: List directory contents (basic).\n    Lists files and directories in the specified path (or current directory).";
-        case BuiltinCommandType::Mkdir:   return "mkdir <dirname>: Create a directory.\n    Creates a directory named DIRNAME.";
-        case BuiltinCommandType::Rm:      return "rm <path>: Remove a file or empty directory.\n    Removes the specified file or empty directory.";
-        case BuiltinCommandType::Cat:     return "cat <filename>: Concatenate and print files.\n    Displays the content of the specified file.";
+        case BuiltinCommandType::Ls:      return "ls [-laRStr] [path...]: List directory contents.\n    Lists each PATH (default: the current directory), sorted by name.\n    -l long format   -a include hidden entries   -R recurse into subdirectories\n    -S sort by size  -t sort by modification time  -r reverse the order";
+        case BuiltinCommandType::Mkdir:   return "mkdir [-p] <dirname...>: Create directories.\n    Creates a directory named DIRNAME for each operand.\n    -p also creates missing parent directories and accepts existing ones; a prefix shared\n    by several operands is resolved only once.";
+        case BuiltinCommandType::Rm:      return "rm [-rf] <path...>: Remove files or directories.\n    Removes each PATH. Without -r a directory is only removed if it is empty.\n    -r removes directories with their contents, deleting subtrees in parallel.\n    -f ignores nonexistent paths.";
+        case BuiltinCommandType::Cp:      return "cp [-r] <source...> <destination>: Copy files or directories.\n    Copies SOURCE to DESTINATION, or each SOURCE into DESTINATION if it is a directory.\n    Files are reflinked where the filesystem allows it, otherwise copied in the kernel.\n    -r copies directories with their contents, walking subtrees in parallel.\n    Modes and timestamps are preserved; symlinks inside a tree are copied as symlinks.";
+        case BuiltinCommandType::Cat:     return "cat [file...]: Concatenate and print files.\n    Writes each FILE to standard output, byte for byte. `-` or no FILE reads standard input.\n    Data is moved inside the kernel (copy_file_range, splice or sendfile) when possible.";
         case BuiltinCommandType::Path:    return "path: Display the system PATH variable.\n    Prints the value of the PATH environment variable from the system.";
         case BuiltinCommandType::AddPath: return "addpath <dir>: Add directory to internal TINYSHELL_PATH (conceptual).\n    Appends the specified directory to an internal variable TINYSHELL_PATH.\n    Warning: Does not affect system PATH used by external commands.";
-        case BuiltinCommandType::C:       return "c <src.c> [args...]: Compile and run a C source file.\n    Compiles SRC.C using 'gcc' and runs the resulting executable with ARGS.";
-        case BuiltinCommandType::Cpp:     return "cpp <src.cpp> [args...]: Compile and run a C++ source file.\n    Compiles SRC.CPP using 'g++' and runs the resulting executable with ARGS.";
-        case BuiltinCommandType::History: return "history [n]: Display command history.\n    Displays the command history list. If N is specified, displays the last N commands.";
+        case BuiltinCommandType::C:       return "c [flags...] <src.c...> [--] [args...]: Compile and run a C program.\n    Compiles each SRC.C using 'gcc' (in parallel), links them and runs the result with ARGS.\n    FLAGS (-O2, -march=native, -I, -D, -l, -L, ...) go to the compiler; ARGS start at `--` or at\n    the first argument that is neither a flag nor a source. Objects and executables are cached by\n    content, so only changed sources are recompiled and an unchanged program is not rebuilt.";
+        case BuiltinCommandType::Cpp:     return "cpp [flags...] <src.cpp...> [--] [args...]: Compile and run a C++ program.\n    Like `c`, using 'g++'.";
+        case BuiltinCommandType::History: return "history [n] | history -s pattern: Display or search command history.\n    Displays the command history list. If N is specified, displays the last N commands.\n    -s    Displays the entries containing PATTERN (the remaining arguments, joined by spaces).";
         case BuiltinCommandType::Test:    return "test expression | [ expression ]: Evaluate conditional expression.\n    Evaluates EXPRESSION and returns status 0 (true) or 1 (false).\n    Operators: -e, -f, -d (file tests), =, != (string), -eq, -ne, -gt, -ge, -lt, -le (integer).";
+        case BuiltinCommandType::Read:    return "read [-r] [var...]: Read a line from standard input.\n    Splits the line on blanks into the VARs; the last VAR gets the rest of the line.\n    Without VARs the line is stored in REPLY. -r keeps backslashes literally.\n    Returns status 1 at end of input. Inside `while ... done < file` it reads from FILE.";
+        case BuiltinCommandType::Printf:  return "printf [-v var] format [arguments...]: Format and print ARGUMENTS under control of FORMAT.\n    FORMAT takes escapes (\\n, \\t, \\NNN, \\xHH) and conversions %d %i %o %u %x %X %c %s %b\n    %e %f %g %a with flags, width and precision (`*` reads them from the arguments).\n    FORMAT is reused until all ARGUMENTS are consumed. With -v VAR the output is\n    stored in VAR instead of being printed. Formats are parsed once and cached.";
+        case BuiltinCommandType::Mapfile: return "mapfile [-t] array [< file]: Read lines into an indexed array.\n    Reads FILE (or standard input) with one bulk read and stores line N in ARRAY[N].\n    -t removes the trailing newline from each line. The default ARRAY is MAPFILE.";
         // case BuiltinCommandType::CatSpin: return "cat_spin: Optional fun command.";
         default: return "No help available for this command.";
     }
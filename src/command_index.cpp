@@ -0,0 +1,235 @@
+#include "../include/command_index.hpp"
+#include "../include/globbing.hpp" // read_directory_entries
+#include <algorithm>
+#include <cstdlib>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace g1_tinyshell
+{
+
+namespace
+{
+std::vector<std::string> split_path_variable(const std::string& path_variable)
+{
+    std::vector<std::string> directories;
+    size_t start = 0;
+    while (start <= path_variable.size())
+    {
+        size_t end = path_variable.find(':', start);
+        if (end == std::string::npos)
+        {
+            end = path_variable.size();
+        }
+        // An empty element means the current directory, which completion covers as paths
+        if (end > start)
+        {
+            directories.push_back(path_variable.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    return directories;
+}
+
+bool is_executable(int dir_fd, const DirectoryEntry& entry)
+{
+    if (entry.type == DT_DIR)
+    {
+        return false;
+    }
+    if (entry.type != DT_REG)
+    {
+        struct stat entry_stat; // Symlink or unknown type: follow it
+        if (fstatat(dir_fd, entry.name.c_str(), &entry_stat, 0) != 0 || S_ISDIR(entry_stat.st_mode))
+        {
+            return false;
+        }
+    }
+    return faccessat(dir_fd, entry.name.c_str(), X_OK, 0) == 0;
+}
+}
+
+CommandTrie::CommandTrie()
+    : m_nodes(1), m_wordCount(0)
+{
+}
+
+void CommandTrie::insert(const std::string& word)
+{
+    uint32_t node = 0;
+    for (char c : word)
+    {
+        std::vector<std::pair<char, uint32_t>>& children = m_nodes[node].children;
+        auto it = std::lower_bound(children.begin(), children.end(), std::make_pair(c, uint32_t(0)));
+        if (it != children.end() && it->first == c)
+        {
+            node = it->second;
+            continue;
+        }
+        uint32_t child = static_cast<uint32_t>(m_nodes.size());
+        children.insert(it, {c, child});
+        m_nodes.emplace_back(); // Invalidates `children`
+        node = child;
+    }
+    if (!m_nodes[node].terminal)
+    {
+        m_nodes[node].terminal = true;
+        ++m_wordCount;
+    }
+}
+
+void CommandTrie::complete(const std::string& prefix, std::vector<std::string>& matches) const
+{
+    uint32_t node = 0;
+    for (char c : prefix)
+    {
+        const std::vector<std::pair<char, uint32_t>>& children = m_nodes[node].children;
+        auto it = std::lower_bound(children.begin(), children.end(), std::make_pair(c, uint32_t(0)));
+        if (it == children.end() || it->first != c)
+        {
+            return;
+        }
+        node = it->second;
+    }
+    std::string word = prefix;
+    collect(node, word, matches);
+}
+
+size_t CommandTrie::size() const
+{
+    return m_wordCount;
+}
+
+void CommandTrie::collect(uint32_t node, std::string& word, std::vector<std::string>& matches) const
+{
+    if (m_nodes[node].terminal)
+    {
+        matches.push_back(word);
+    }
+    for (const auto& child : m_nodes[node].children)
+    {
+        word.push_back(child.first);
+        collect(child.second, word, matches);
+        word.pop_back();
+    }
+}
+
+CommandIndex::CommandIndex()
+    : m_refreshRequested(true), m_stopping(false), m_trie(std::make_shared<CommandTrie>())
+{
+    m_thread = std::thread(&CommandIndex::run, this);
+}
+
+CommandIndex::~CommandIndex()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wakeup.notify_one();
+    m_thread.join();
+}
+
+std::shared_ptr<const CommandTrie> CommandIndex::snapshot() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_trie;
+}
+
+void CommandIndex::requestRefresh()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_refreshRequested = true;
+    }
+    m_wakeup.notify_one();
+}
+
+void CommandIndex::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_wakeup.wait(lock, [this]() { return m_refreshRequested || m_stopping; });
+        if (m_stopping)
+        {
+            return;
+        }
+        m_refreshRequested = false;
+        lock.unlock();
+        const char* path_variable = std::getenv("PATH"); // The shell never calls setenv()
+        std::string path = path_variable ? path_variable : "";
+        if (!isUpToDate(path))
+        {
+            rebuild(path);
+        }
+        lock.lock();
+    }
+}
+
+// A few stat() calls: PATH directories rarely change, and rescanning them costs thousands.
+bool CommandIndex::isUpToDate(const std::string& path_variable) const
+{
+    if (path_variable != m_scannedPath || m_scanned.empty())
+    {
+        return false;
+    }
+    for (const ScannedDirectory& directory : m_scanned)
+    {
+        struct stat directory_stat;
+        if (stat(directory.path.c_str(), &directory_stat) != 0)
+        {
+            if (directory.modification_time.tv_sec != -1)
+            {
+                return false; // Removed
+            }
+            continue;
+        }
+        if (directory_stat.st_mtim.tv_sec != directory.modification_time.tv_sec ||
+            directory_stat.st_mtim.tv_nsec != directory.modification_time.tv_nsec)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CommandIndex::rebuild(const std::string& path_variable)
+{
+    auto trie = std::make_shared<CommandTrie>();
+    std::vector<ScannedDirectory> scanned;
+    std::vector<DirectoryEntry> entries;
+    for (const std::string& directory : split_path_variable(path_variable))
+    {
+        ScannedDirectory record{directory, {-1, 0}}; // -1: missing, noticed if it appears
+        int dir_fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        struct stat directory_stat;
+        if (dir_fd >= 0 && fstat(dir_fd, &directory_stat) == 0)
+        {
+            // Taken before reading, so a change during the scan triggers another one
+            record.modification_time = directory_stat.st_mtim;
+            entries.clear();
+            read_directory_entries(dir_fd, entries);
+            for (const DirectoryEntry& entry : entries)
+            {
+                if (is_executable(dir_fd, entry))
+                {
+                    trie->insert(entry.name);
+                }
+            }
+        }
+        if (dir_fd >= 0)
+        {
+            close(dir_fd);
+        }
+        scanned.push_back(record);
+    }
+    m_scannedPath = path_variable;
+    m_scanned = std::move(scanned);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_trie = std::move(trie);
+}
+
+}
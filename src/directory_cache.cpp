@@ -0,0 +1,252 @@
+#include "../include/directory_cache.hpp"
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace g1_tinyshell
+{
+
+constexpr size_t K_MaxDirectoryWatches = 256;      // inotify watches are a per-user kernel resource
+constexpr size_t K_MaxCachedDirectories = 1024;
+constexpr size_t K_MaxCachedEntries = 1 << 20;     // Total entries across all listings
+constexpr uint32_t K_DirectoryWatchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                          IN_DELETE_SELF | IN_ONLYDIR;
+
+DirectoryCache& DirectoryCache::instance()
+{
+    static DirectoryCache cache;
+    return cache;
+}
+
+DirectoryCache::DirectoryCache()
+    : m_inotifyFd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)), m_ownerPid(getpid()), m_watchCount(0), m_cachedEntryCount(0)
+{
+    // If inotify is unavailable (m_inotifyFd < 0), every listing falls back to mtime checks.
+}
+
+DirectoryCache::~DirectoryCache()
+{
+    if (m_inotifyFd >= 0)
+    {
+        close(m_inotifyFd);
+    }
+}
+
+std::shared_ptr<const DirectoryCache::EntryList> DirectoryCache::getEntries(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    resetIfForked();
+
+    struct stat dir_stat;
+    if (stat(path.c_str(), &dir_stat) != 0 || !S_ISDIR(dir_stat.st_mode))
+    {
+        return nullptr;
+    }
+    processInotifyEvents();
+
+    DirectoryKey key{dir_stat.st_dev, dir_stat.st_ino};
+    auto it = m_listings.find(key);
+    if (it != m_listings.end())
+    {
+        CachedListing& listing = it->second;
+        // The mtime is checked even under a watch, in case another process read the events
+        bool unchanged = (listing.watch_descriptor >= 0 || listing.trust_mtime) &&
+                         listing.modification_time.tv_sec == dir_stat.st_mtim.tv_sec &&
+                         listing.modification_time.tv_nsec == dir_stat.st_mtim.tv_nsec;
+        m_lruOrder.splice(m_lruOrder.begin(), m_lruOrder, listing.lru_position);
+        if (listing.entries && unchanged)
+        {
+            return listing.entries;
+        }
+        if (listing.entries)
+        {
+            m_cachedEntryCount -= listing.entries->size();
+            listing.entries.reset();
+        }
+    }
+
+    // Watch before reading, so a change made while reading invalidates the new listing.
+    int watch_descriptor = (it != m_listings.end()) ? it->second.watch_descriptor : -1;
+    if (watch_descriptor < 0 && m_inotifyFd >= 0 && m_watchCount < K_MaxDirectoryWatches)
+    {
+        watch_descriptor = inotify_add_watch(m_inotifyFd, path.c_str(), K_DirectoryWatchMask);
+        if (watch_descriptor >= 0 && m_watchedKeys.emplace(watch_descriptor, key).second)
+        {
+            ++m_watchCount;
+        }
+    }
+
+    struct timespec read_time;
+    clock_gettime(CLOCK_REALTIME, &read_time);
+
+    auto entries = std::make_shared<EntryList>();
+    int dir_fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    bool read_ok = dir_fd >= 0 && read_directory_entries(dir_fd, *entries);
+    if (dir_fd >= 0)
+    {
+        close(dir_fd);
+    }
+    if (!read_ok || entries->size() > K_MaxCachedEntries)
+    {
+        // Unreadable, incomplete or too big to keep: do not hold a watch for it
+        if (it != m_listings.end())
+        {
+            evictListing(key);
+        }
+        else if (watch_descriptor >= 0 && m_watchedKeys.erase(watch_descriptor) > 0)
+        {
+            inotify_rm_watch(m_inotifyFd, watch_descriptor);
+            --m_watchCount;
+        }
+        if (dir_fd < 0)
+        {
+            return nullptr;
+        }
+        return entries;
+    }
+
+    if (it == m_listings.end())
+    {
+        m_lruOrder.push_front(key);
+        it = m_listings.emplace(key, CachedListing{}).first;
+        it->second.lru_position = m_lruOrder.begin();
+    }
+    CachedListing& listing = it->second;
+    listing.entries = entries;
+    listing.modification_time = dir_stat.st_mtim;
+    listing.watch_descriptor = watch_descriptor;
+    // A change in the same second as the read might not move the mtime: re-read next time
+    listing.trust_mtime = dir_stat.st_mtim.tv_sec < read_time.tv_sec - 1;
+    m_cachedEntryCount += entries->size();
+
+    evictUntilWithinLimits();
+    return entries;
+}
+
+void DirectoryCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    resetIfForked();
+    while (!m_lruOrder.empty())
+    {
+        evictListing(m_lruOrder.back());
+    }
+}
+
+// A child created by fork() shares the parent's inotify instance: reading it would steal the
+// parent's events and removing a watch would remove the parent's. Drop everything inherited.
+void DirectoryCache::resetIfForked()
+{
+    if (m_ownerPid == getpid())
+    {
+        return;
+    }
+    if (m_inotifyFd >= 0)
+    {
+        close(m_inotifyFd);
+    }
+    m_listings.clear();
+    m_watchedKeys.clear();
+    m_lruOrder.clear();
+    m_watchCount = 0;
+    m_cachedEntryCount = 0;
+    m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    m_ownerPid = getpid();
+}
+
+void DirectoryCache::processInotifyEvents()
+{
+    if (m_inotifyFd < 0)
+    {
+        return;
+    }
+
+    alignas(struct inotify_event) char buffer[16384];
+    while (true)
+    {
+        ssize_t bytes_read = read(m_inotifyFd, buffer, sizeof(buffer));
+        if (bytes_read <= 0)
+        {
+            return; // EAGAIN: queue drained
+        }
+
+        for (ssize_t offset = 0; offset < bytes_read;)
+        {
+            const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(buffer + offset);
+            offset += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                // Lost events: nothing watched can be trusted any more
+                for (auto& key_listing : m_listings)
+                {
+                    if (key_listing.second.entries && key_listing.second.watch_descriptor >= 0)
+                    {
+                        m_cachedEntryCount -= key_listing.second.entries->size();
+                        key_listing.second.entries.reset();
+                    }
+                }
+                continue;
+            }
+
+            auto watched_it = m_watchedKeys.find(event->wd);
+            if (watched_it == m_watchedKeys.end())
+            {
+                continue; // Watch already removed by eviction
+            }
+            auto listing_it = m_listings.find(watched_it->second);
+            if (event->mask & IN_IGNORED)
+            {
+                // Directory deleted or unmounted: the kernel dropped the watch
+                m_watchedKeys.erase(watched_it);
+                --m_watchCount;
+                if (listing_it != m_listings.end())
+                {
+                    listing_it->second.watch_descriptor = -1;
+                    evictListing(listing_it->first);
+                }
+                continue;
+            }
+            if (listing_it != m_listings.end() && listing_it->second.entries)
+            {
+                // Keep the watch; the listing is re-read on the next lookup
+                m_cachedEntryCount -= listing_it->second.entries->size();
+                listing_it->second.entries.reset();
+            }
+        }
+    }
+}
+
+void DirectoryCache::evictListing(const DirectoryKey& key)
+{
+    auto it = m_listings.find(key);
+    if (it == m_listings.end())
+    {
+        return;
+    }
+    CachedListing& listing = it->second;
+    if (listing.watch_descriptor >= 0)
+    {
+        inotify_rm_watch(m_inotifyFd, listing.watch_descriptor);
+        m_watchedKeys.erase(listing.watch_descriptor);
+        --m_watchCount;
+    }
+    if (listing.entries)
+    {
+        m_cachedEntryCount -= listing.entries->size();
+    }
+    m_lruOrder.erase(listing.lru_position);
+    m_listings.erase(it);
+}
+
+void DirectoryCache::evictUntilWithinLimits()
+{
+    while (m_lruOrder.size() > 1 &&
+           (m_listings.size() > K_MaxCachedDirectories || m_cachedEntryCount > K_MaxCachedEntries))
+    {
+        evictListing(m_lruOrder.back());
+    }
+}
+
+}
@@ -0,0 +1,151 @@
+#include "../include/directory_creation.hpp"
+#include <cerrno>
+#include <cstring>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace g1_tinyshell
+{
+
+namespace
+{
+constexpr mode_t K_DirectoryMode = 0777; // Before the umask, as mkdir(1) does
+
+// One path component shared by every operand that goes through it
+struct ComponentNode
+{
+    std::string name;
+    std::string path; // For messages
+    std::vector<size_t> children; // In the order the operands named them
+    std::unordered_map<std::string, size_t> child_index;
+};
+
+class ComponentTree
+{
+public:
+    ComponentTree()
+    {
+        m_nodes.resize(2); // The current directory and `/`
+        m_nodes[K_RootIndex].path = "/";
+    }
+
+    void addPath(const std::string& path)
+    {
+        size_t node_index = (!path.empty() && path[0] == '/') ? K_RootIndex : K_CwdIndex;
+        size_t pos = 0;
+        while (pos < path.size())
+        {
+            size_t end = path.find('/', pos);
+            if (end == std::string::npos)
+            {
+                end = path.size();
+            }
+            std::string name = path.substr(pos, end - pos);
+            pos = end + 1;
+            if (name.empty() || name == ".")
+            {
+                continue;
+            }
+            auto found = m_nodes[node_index].child_index.find(name);
+            if (found != m_nodes[node_index].child_index.end())
+            {
+                node_index = found->second;
+                continue;
+            }
+            ComponentNode child;
+            child.name = name;
+            child.path = path.substr(0, end);
+            m_nodes.push_back(std::move(child));
+            size_t child_index = m_nodes.size() - 1;
+            m_nodes[node_index].children.push_back(child_index);
+            m_nodes[node_index].child_index.emplace(name, child_index);
+            node_index = child_index;
+        }
+    }
+
+    std::vector<std::string> create()
+    {
+        std::vector<std::string> errors;
+        createChildren(K_CwdIndex, AT_FDCWD, errors);
+        if (!m_nodes[K_RootIndex].children.empty())
+        {
+            int root_fd = open("/", O_PATH | O_DIRECTORY | O_CLOEXEC);
+            if (root_fd < 0)
+            {
+                errors.push_back(std::string("mkdir: Cannot open `/`: ") + std::strerror(errno));
+                return errors;
+            }
+            createChildren(K_RootIndex, root_fd, errors);
+            close(root_fd);
+        }
+        return errors;
+    }
+
+private:
+    static constexpr size_t K_CwdIndex = 0;
+    static constexpr size_t K_RootIndex = 1;
+
+    std::vector<ComponentNode> m_nodes;
+
+    // Depth-first, so at most one descriptor per level of the deepest operand is open
+    void createChildren(size_t node_index, int dir_fd, std::vector<std::string>& errors)
+    {
+        for (size_t child_index : m_nodes[node_index].children)
+        {
+            const ComponentNode& child = m_nodes[child_index];
+            bool existed = mkdirat(dir_fd, child.name.c_str(), K_DirectoryMode) != 0;
+            if (existed && errno != EEXIST)
+            {
+                errors.push_back("mkdir: Cannot create directory `" + child.path + "`: " + std::strerror(errno));
+                continue;
+            }
+            if (child.children.empty())
+            {
+                // A leaf only has to exist as a directory; stat it only if mkdirat found something
+                struct stat child_stat;
+                if (existed && (fstatat(dir_fd, child.name.c_str(), &child_stat, 0) != 0 || !S_ISDIR(child_stat.st_mode)))
+                {
+                    errors.push_back("mkdir: Cannot create directory `" + child.path + "`: File exists");
+                }
+                continue;
+            }
+            int child_fd = openat(dir_fd, child.name.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+            if (child_fd < 0)
+            {
+                int error_number = (errno == ENOTDIR) ? EEXIST : errno;
+                errors.push_back("mkdir: Cannot create directory `" + child.path + "`: " + std::strerror(error_number));
+                continue;
+            }
+            createChildren(child_index, child_fd, errors);
+            close(child_fd);
+        }
+    }
+};
+}
+
+std::vector<std::string> make_directories(const std::vector<std::string>& paths, bool parents)
+{
+    if (parents)
+    {
+        ComponentTree tree;
+        for (const std::string& path : paths)
+        {
+            tree.addPath(path);
+        }
+        return tree.create();
+    }
+
+    std::vector<std::string> errors;
+    for (const std::string& path : paths)
+    {
+        if (mkdir(path.c_str(), K_DirectoryMode) != 0)
+        {
+            errors.push_back("mkdir: Cannot create directory `" + path + "`: " + std::strerror(errno));
+        }
+    }
+    return errors;
+}
+
+}
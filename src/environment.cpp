@@ -1,11 +1,13 @@
 #include "../include/environment.hpp"
 #include <cstdlib> // For getenv
 #include <cctype>  // For isalnum
+#include <algorithm> // std::max
 
 namespace g1_tinyshell
 {
 
 Environment::Environment()
+    : m_variables(std::make_shared<std::map<std::string, std::string>>()), m_arrays(std::make_shared<ArrayMap>())
 {
     // Initialize with some common environment variables if needed,
     // but primarily manage internal shell variables.
@@ -15,22 +17,37 @@ Environment::Environment()
 
 bool Environment::setVariable(const std::string& variable_name, const std::string& value)
 {
-    if (!isValidVariableName(variable_name))
+    // "?" is the exit-status parameter; it is set by the shell, not by user assignments.
+    if (!isValidVariableName(variable_name) && variable_name != "?")
     {
         return false;
     }
-    m_variables[variable_name] = value;
+    if (m_arrays->count(variable_name) > 0)
+    {
+        return setArrayElement(variable_name, 0, value);
+    }
+    detachVariables();
+    (*m_variables)[variable_name] = value;
     return true;
 }
 
 std::optional<std::string> Environment::getVariable(const std::string& variable_name) const
 {
     // First, check internal variables
-    auto it = m_variables.find(variable_name);
-    if (it != m_variables.end())
+    auto it = m_variables->find(variable_name);
+    if (it != m_variables->end())
     {
         return it->second;
     }
+    auto array_it = m_arrays->find(variable_name);
+    if (array_it != m_arrays->end())
+    {
+        if (array_it->second.empty())
+        {
+            return std::string();
+        }
+        return array_it->second.front();
+    }
 
     // Second, check system environment variables (read-only access)
     // Note: This makes system env vars accessible but not modifiable via setvar/unsetvar
@@ -51,18 +68,136 @@ bool Environment::unsetVariable(const std::string& variable_name)
         return false; // Or maybe allow unsetting invalid names?
                       // Sticking to valid names for consistency.
     }
-    auto it = m_variables.find(variable_name);
-    if (it != m_variables.end())
+    if (m_arrays->find(variable_name) != m_arrays->end())
+    {
+        detachArrays();
+        m_arrays->erase(variable_name);
+        return true;
+    }
+    if (m_variables->find(variable_name) != m_variables->end())
     {
-        m_variables.erase(it);
+        detachVariables();
+        m_variables->erase(variable_name);
         return true;
     }
     return false; // Variable did not exist in the internal map
 }
 
+bool Environment::setArray(const std::string& variable_name, std::vector<std::string> values)
+{
+    if (!isValidVariableName(variable_name))
+    {
+        return false;
+    }
+    if (m_variables->find(variable_name) != m_variables->end())
+    {
+        detachVariables();
+        m_variables->erase(variable_name);
+    }
+    detachArrays();
+    (*m_arrays)[variable_name] = std::move(values);
+    return true;
+}
+
+namespace
+{
+// Appends with explicit geometric growth, whatever the library's own append policy is.
+void append_in_place(std::string& target, const std::string& suffix)
+{
+    size_t required = target.size() + suffix.size();
+    if (required > target.capacity())
+    {
+        target.reserve(std::max(required, target.capacity() * 2));
+    }
+    target += suffix;
+}
+}
+
+bool Environment::appendToVariable(const std::string& variable_name, const std::string& suffix)
+{
+    if (!isValidVariableName(variable_name))
+    {
+        return false;
+    }
+    if (m_arrays->count(variable_name) > 0)
+    {
+        return setArrayElement(variable_name, 0, suffix, true);
+    }
+    detachVariables();
+    auto it = m_variables->find(variable_name);
+    if (it == m_variables->end())
+    {
+        const char* env_value = std::getenv(variable_name.c_str());
+        it = m_variables->emplace(variable_name, env_value ? env_value : "").first;
+    }
+    append_in_place(it->second, suffix);
+    return true;
+}
+
+bool Environment::appendToArray(const std::string& variable_name, const std::vector<std::string>& values)
+{
+    if (!isValidVariableName(variable_name))
+    {
+        return false;
+    }
+    const std::vector<std::string>* existing = getArray(variable_name);
+    size_t next_index = existing ? existing->size() : (getVariable(variable_name) ? 1 : 0);
+    if (values.empty())
+    {
+        return next_index == 0 || setArrayElement(variable_name, 0, "", true); // Still converts a scalar
+    }
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        setArrayElement(variable_name, next_index + i, values[i]);
+    }
+    return true;
+}
+
+bool Environment::setArrayElement(const std::string& variable_name, size_t index, const std::string& value, bool append)
+{
+    if (!isValidVariableName(variable_name))
+    {
+        return false;
+    }
+    detachArrays();
+    auto array_it = m_arrays->find(variable_name);
+    if (array_it == m_arrays->end())
+    {
+        std::vector<std::string> values;
+        auto scalar_it = m_variables->find(variable_name);
+        if (scalar_it != m_variables->end())
+        {
+            values.push_back(scalar_it->second);
+            detachVariables();
+            m_variables->erase(variable_name);
+        }
+        array_it = m_arrays->emplace(variable_name, std::move(values)).first;
+    }
+    std::vector<std::string>& values = array_it->second;
+    if (index >= values.size())
+    {
+        values.resize(index + 1);
+    }
+    if (append)
+    {
+        append_in_place(values[index], value);
+    }
+    else
+    {
+        values[index] = value;
+    }
+    return true;
+}
+
+const std::vector<std::string>* Environment::getArray(const std::string& variable_name) const
+{
+    auto array_it = m_arrays->find(variable_name);
+    return array_it != m_arrays->end() ? &array_it->second : nullptr;
+}
+
 const std::map<std::string, std::string>& Environment::getAllVariables() const
 {
-    return m_variables;
+    return *m_variables;
 }
 
 // Basic validation: starts with letter or underscore, followed by letters, numbers, or underscore.
@@ -87,5 +222,36 @@ bool Environment::isValidVariableName(const std::string& variable_name)
     return true;
 }
 
+Environment::VariableSnapshot Environment::takeSnapshot() const
+{
+    return {m_variables, m_arrays};
+}
+
+void Environment::restoreSnapshot(const VariableSnapshot& snapshot)
+{
+    if (!snapshot.variables || !snapshot.arrays)
+    {
+        return;
+    }
+    // The snapshot is shared read-only; detachVariables() copies it on the next write.
+    m_variables = std::const_pointer_cast<std::map<std::string, std::string>>(snapshot.variables);
+    m_arrays = std::const_pointer_cast<ArrayMap>(snapshot.arrays);
+}
+
+void Environment::detachVariables()
+{
+    if (m_variables.use_count() > 1)
+    {
+        m_variables = std::make_shared<std::map<std::string, std::string>>(*m_variables);
+    }
 }
 
+void Environment::detachArrays()
+{
+    if (m_arrays.use_count() > 1)
+    {
+        m_arrays = std::make_shared<ArrayMap>(*m_arrays);
+    }
+}
+
+}
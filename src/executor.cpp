@@ -1,17 +1,26 @@
 #include "../include/executor.hpp"
 #include "../include/shell_core.hpp"
 #include "../include/expansion.hpp"
+#include "../include/glob_pattern.hpp"
+#include "../include/line_reader.hpp"
+#include "../include/output_sink.hpp"
 #include <iostream>
 #include <cstdlib>
 #include <sstream>
 #include <variant>
 #include <algorithm> // For std::all_of if needed, or remove
+#include <memory>
+#include <cerrno>
+#include <cstring>    // strerror
+#include <fcntl.h>    // open() for the subshell cwd snapshot
+#include <unistd.h>   // fchdir, fork, _exit
+#include <sys/wait.h> // waitpid
 
 namespace g1_tinyshell
 {
 
 Executor::Executor(Environment& environment, ShellCore& shell_core)
-    : m_environment(environment), m_shellCore(shell_core)
+    : m_environment(environment), m_shellCore(shell_core), m_loopInput(nullptr)
 {
 }
 
@@ -47,6 +56,22 @@ ExecutionResult Executor::execute(AstNodePtr node)
     {
         return executeForNode(*for_cmd);
     }
+    else if (auto subshell_cmd = std::dynamic_pointer_cast<SubshellNode>(node))
+    {
+        return executeSubshellNode(*subshell_cmd);
+    }
+    else if (auto and_or_cmd = std::dynamic_pointer_cast<AndOrListNode>(node))
+    {
+        return executeAndOrListNode(*and_or_cmd);
+    }
+    else if (auto not_cmd = std::dynamic_pointer_cast<NotNode>(node))
+    {
+        return executeNotNode(*not_cmd);
+    }
+    else if (auto case_cmd = std::dynamic_pointer_cast<CaseNode>(node))
+    {
+        return executeCaseNode(*case_cmd);
+    }
     else
     {
         return {1, "Internal error: Unknown AST node type encountered.", true};
@@ -57,9 +82,10 @@ ExecutionResult Executor::executeSimpleCommand(const SimpleCommandNode& node)
 {
     std::string command_name = node.command;
     std::vector<std::string> arguments = node.arguments;
+    std::vector<bool> glob_flags = node.glob_arguments;
     std::string expansion_error;
 
-    if (!command_name.empty() && command_name[0] == '$')
+    if (command_name.find_first_of("$\\") != std::string::npos)
     {
         command_name = Expansion::expandWord(command_name, m_environment, expansion_error);
         if (!expansion_error.empty())
@@ -73,11 +99,12 @@ ExecutionResult Executor::executeSimpleCommand(const SimpleCommandNode& node)
          return {0, "", true};
     }
 
-    if (!Expansion::expandArguments(arguments, m_environment, expansion_error))
+    if (!Expansion::expandArguments(arguments, glob_flags, m_environment, expansion_error))
     {
         setLastExitStatus(1);
         return {1, "Error expanding arguments: " + expansion_error, true};
     }
+    Expansion::expandPathnames(arguments, glob_flags);
 
     BuiltinCommandType builtin_type = Builtins::getBuiltinType(command_name);
     if (builtin_type != BuiltinCommandType::Unknown)
@@ -86,6 +113,7 @@ ExecutionResult Executor::executeSimpleCommand(const SimpleCommandNode& node)
         cmd_info.type = CommandType::Builtin;
         cmd_info.command_name = command_name;
         cmd_info.builtin_type = builtin_type;
+        cmd_info.input_reader = m_loopInput;
 
         if (command_name == "cd") {
             if (arguments.empty()) {
@@ -163,6 +191,81 @@ ExecutionResult Executor::executeIfNode(const IfNode& node)
 }
 
 ExecutionResult Executor::executeWhileNode(const WhileNode& node)
+{
+    if (!node.input_file.empty())
+    {
+        return executeWhileReadingFile(node);
+    }
+    return runWhileLoop(node);
+}
+
+ExecutionResult Executor::executeWhileReadingFile(const WhileNode& node)
+{
+    std::string expansion_error;
+    std::string file_path = Expansion::expandWord(node.input_file, m_environment, expansion_error);
+    if (!expansion_error.empty())
+    {
+        setLastExitStatus(1);
+        return {1, "Error expanding file name in while loop: " + expansion_error, true};
+    }
+    int input_fd = open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (input_fd < 0)
+    {
+        setLastExitStatus(1);
+        return {1, "while: Cannot open `" + file_path + "`: " + std::strerror(errno), true};
+    }
+    posix_fadvise(input_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    LineReader reader(input_fd);
+    LineReader* outer_input = m_loopInput;
+    m_loopInput = &reader;
+
+    // `while read [-r] var...` with literal arguments: feed lines straight into the variables
+    AstNodePtr condition = node.condition_command;
+    auto condition_sequence = std::dynamic_pointer_cast<CommandSequenceNode>(condition);
+    if (condition_sequence && condition_sequence->commands.size() == 1)
+    {
+        condition = condition_sequence->commands.front();
+    }
+    auto read_command = std::dynamic_pointer_cast<SimpleCommandNode>(condition);
+    bool raw = false;
+    std::vector<std::string> variable_names;
+    bool direct_read = read_command && read_command->command == "read" &&
+                       Builtins::parseReadArguments(read_command->arguments, raw, variable_names).empty();
+
+    ExecutionResult last_body_result = {0, "", true};
+    if (direct_read)
+    {
+        std::string line;
+        while (reader.nextLine(line))
+        {
+            Builtins::assignReadFields(line, variable_names, raw, m_environment);
+            last_body_result = execute(node.body);
+            if (!last_body_result.continue_shell)
+            {
+                break;
+            }
+        }
+        if (last_body_result.continue_shell)
+        {
+            // Same end state as the failing `read` that ends the loop
+            for (const std::string& variable_name : variable_names)
+            {
+                m_environment.setVariable(variable_name, "");
+            }
+        }
+    }
+    else
+    {
+        last_body_result = runWhileLoop(node);
+    }
+
+    m_loopInput = outer_input;
+    close(input_fd);
+    return last_body_result;
+}
+
+ExecutionResult Executor::runWhileLoop(const WhileNode& node)
 {
     ExecutionResult last_body_result = {0, "", true};
     while (true)
@@ -182,38 +285,89 @@ ExecutionResult Executor::executeWhileNode(const WhileNode& node)
 
 ExecutionResult Executor::executeForNode(const ForNode& node)
 {
+    if (!node.line_file.empty() || node.line_command)
+    {
+        return executeForLines(node);
+    }
+
     ExecutionResult last_body_result = {0, "", true};
     std::string expansion_error;
-    std::vector<std::string> expanded_words;
-    for (const std::string& word : node.word_list)
+
+    // Every word is expanded before the first iteration, but brace words ({1..N}, {a,b})
+    // stay generators and produce one value per iteration, so `for i in {1..100000000}`
+    // starts at once and runs in constant memory.
+    struct ForWord
     {
+        std::unique_ptr<BraceExpansion> generator;
+        std::vector<std::string> values; // Used when there is no generator
+    };
+    std::vector<ForWord> words(node.word_list.size());
+    for (size_t i = 0; i < node.word_list.size(); ++i)
+    {
+        const std::string& word = node.word_list[i];
+        bool unquoted = i < node.glob_words.size() && node.glob_words[i];
+        if (unquoted && BraceExpansion::mayHaveBraces(word))
+        {
+            words[i].generator = std::make_unique<BraceExpansion>(word);
+            if (words[i].generator->hasGroups())
+            {
+                if (!Expansion::prepareBraceExpansion(*words[i].generator, m_environment, expansion_error))
+                {
+                    setLastExitStatus(1);
+                    return {1, "Error expanding word list in for loop: " + expansion_error, true};
+                }
+                continue;
+            }
+            words[i].generator.reset();
+        }
+        if (Expansion::expandArrayWord(word, m_environment, words[i].values))
+        {
+            continue; // `${arr[@]}`: the elements are copied once, never re-split
+        }
         std::string expanded_word = Expansion::expandWord(word, m_environment, expansion_error);
         if (!expansion_error.empty())
         {
              setLastExitStatus(1);
              return {1, "Error expanding word list in for loop: " + expansion_error, true};
         }
-        expanded_words.push_back(expanded_word);
+        words[i].values.push_back(expanded_word);
+        Expansion::expandPathnames(words[i].values, std::vector<bool>(1, unquoted));
     }
 
     std::optional<std::string> original_value = m_environment.getVariable(node.variable_name);
-
-    for (const std::string& word_value : expanded_words)
+    auto run_iteration = [&](const std::string& word_value)
     {
         m_environment.setVariable(node.variable_name, word_value);
         last_body_result = execute(node.body);
+        return last_body_result.continue_shell;
+    };
 
-        if (!last_body_result.continue_shell)
+    bool keep_running = true;
+    std::string generated_word;
+    std::vector<std::string> generated_matches;
+    for (size_t i = 0; i < words.size() && keep_running; ++i)
+    {
+        if (!words[i].generator)
+        {
+            for (size_t j = 0; j < words[i].values.size() && keep_running; ++j)
+            {
+                keep_running = run_iteration(words[i].values[j]);
+            }
+            continue;
+        }
+        while (keep_running && words[i].generator->next(generated_word))
         {
-            if (original_value.has_value())
+            if (!GlobPattern::hasWildcards(generated_word))
             {
-                m_environment.setVariable(node.variable_name, original_value.value());
+                keep_running = run_iteration(generated_word);
+                continue;
             }
-            else
+            generated_matches.assign(1, generated_word);
+            Expansion::expandPathnames(generated_matches, std::vector<bool>(1, true));
+            for (size_t j = 0; j < generated_matches.size() && keep_running; ++j)
             {
-                m_environment.unsetVariable(node.variable_name);
+                keep_running = run_iteration(generated_matches[j]);
             }
-            return last_body_result;
         }
     }
 
@@ -228,6 +382,309 @@ ExecutionResult Executor::executeForNode(const ForNode& node)
     return last_body_result;
 }
 
+ExecutionResult Executor::executeForLines(const ForNode& node)
+{
+    int input_fd = -1;
+    pid_t producer_pid = -1;
+    if (node.line_command)
+    {
+        // The command runs in a child writing into a pipe; the loop body runs here as lines arrive
+        int pipe_fds[2];
+        if (pipe(pipe_fds) != 0)
+        {
+            setLastExitStatus(1);
+            return {1, "for: Cannot create pipe: " + std::string(std::strerror(errno)), true};
+        }
+        OutputSink::flushAll(); // The child must not inherit (and repeat) buffered output
+        producer_pid = fork();
+        if (producer_pid < 0)
+        {
+            close(pipe_fds[0]);
+            close(pipe_fds[1]);
+            setLastExitStatus(1);
+            return {1, "for: fork failed", true};
+        }
+        if (producer_pid == 0)
+        {
+            close(pipe_fds[0]);
+            dup2(pipe_fds[1], STDOUT_FILENO);
+            close(pipe_fds[1]);
+            ExecutionResult result = execute(node.line_command);
+            OutputSink::flushAll();
+            if (!result.error_message.empty())
+            {
+                std::cerr << "Tinyshell: " << result.error_message << std::endl;
+            }
+            _exit(result.exit_status & 0xFF);
+        }
+        close(pipe_fds[1]);
+        input_fd = pipe_fds[0];
+    }
+    else
+    {
+        std::string expansion_error;
+        std::string file_path = Expansion::expandWord(node.line_file, m_environment, expansion_error);
+        if (!expansion_error.empty())
+        {
+            setLastExitStatus(1);
+            return {1, "Error expanding file name in for loop: " + expansion_error, true};
+        }
+        input_fd = open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (input_fd < 0)
+        {
+            setLastExitStatus(1);
+            return {1, "for: Cannot open `" + file_path + "`: " + std::strerror(errno), true};
+        }
+        posix_fadvise(input_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    ExecutionResult last_body_result = {0, "", true};
+    bool body_ran = false;
+    std::optional<std::string> original_value = m_environment.getVariable(node.variable_name);
+    LineReader reader(input_fd);
+    std::string line;
+    while (reader.nextLine(line))
+    {
+        m_environment.setVariable(node.variable_name, line);
+        last_body_result = execute(node.body);
+        body_ran = true;
+        if (!last_body_result.continue_shell)
+        {
+            break;
+        }
+    }
+    bool read_failed = reader.hasError();
+    close(input_fd); // An unfinished producer gets SIGPIPE and exits
+
+    if (producer_pid > 0)
+    {
+        int wait_status = 0;
+        if (waitpid(producer_pid, &wait_status, 0) == producer_pid && !body_ran)
+        {
+            // Nothing ran, so the loop reports the substitution's status (`for x in $(false)` is 1)
+            last_body_result.exit_status = WIFEXITED(wait_status) ? WEXITSTATUS(wait_status)
+                                                                  : 128 + WTERMSIG(wait_status);
+            setLastExitStatus(last_body_result.exit_status);
+        }
+    }
+    if (original_value.has_value())
+    {
+        m_environment.setVariable(node.variable_name, original_value.value());
+    }
+    else
+    {
+        m_environment.unsetVariable(node.variable_name);
+    }
+    if (read_failed && last_body_result.continue_shell)
+    {
+        return {1, "for: Error reading loop input", true};
+    }
+    return last_body_result;
+}
+
+ExecutionResult Executor::executeAndOrListNode(const AndOrListNode& node)
+{
+    ExecutionResult last_result = execute(node.commands.front());
+    for (size_t i = 0; i < node.operators.size(); ++i)
+    {
+        if (!last_result.continue_shell)
+        {
+            return last_result;
+        }
+        bool succeeded = last_result.exit_status == 0;
+        bool run_next = node.operators[i] == AndOrOperator::And ? succeeded : !succeeded;
+        if (!run_next)
+        {
+            continue; // Skipped command: status of the last executed one carries over
+        }
+        if (!last_result.error_message.empty())
+        {
+            // Report the failure now; otherwise the next command's result would hide it.
+            OutputSink::flushAll();
+            std::cerr << "Tinyshell: " << last_result.error_message << std::endl;
+        }
+        last_result = execute(node.commands[i + 1]);
+    }
+    return last_result;
+}
+
+ExecutionResult Executor::executeNotNode(const NotNode& node)
+{
+    ExecutionResult result = execute(node.command);
+    if (!result.continue_shell)
+    {
+        return result;
+    }
+    result.exit_status = result.exit_status == 0 ? 1 : 0;
+    setLastExitStatus(result.exit_status);
+    return result;
+}
+
+ExecutionResult Executor::executeCaseNode(const CaseNode& node)
+{
+    std::string expansion_error;
+    std::string word_value = Expansion::expandWord(node.word, m_environment, expansion_error);
+    if (!expansion_error.empty())
+    {
+        setLastExitStatus(1);
+        return {1, "Error expanding case word: " + expansion_error, true};
+    }
+
+    std::optional<size_t> selected_clause;
+    if (!node.has_dynamic_patterns)
+    {
+        selected_clause = node.dispatcher.find(word_value);
+    }
+    else
+    {
+        // Patterns referencing variables can only be compiled once expanded
+        for (size_t i = 0; i < node.clauses.size() && !selected_clause.has_value(); ++i)
+        {
+            for (const std::string& pattern : node.clauses[i].patterns)
+            {
+                std::string expanded_pattern = Expansion::expandWord(pattern, m_environment, expansion_error);
+                if (!expansion_error.empty())
+                {
+                    setLastExitStatus(1);
+                    return {1, "Error expanding case pattern: " + expansion_error, true};
+                }
+                if (GlobPattern(expanded_pattern).matches(word_value))
+                {
+                    selected_clause = i;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (!selected_clause.has_value())
+    {
+        setLastExitStatus(0);
+        return {0, "", true};
+    }
+    return execute(node.clauses[selected_clause.value()].body);
+}
+
+ExecutionResult Executor::executeSubshellNode(const SubshellNode& node)
+{
+    if (!canRunInProcess(node.body))
+    {
+        return executeForkedSubshell(node);
+    }
+
+    // Builtin-only body: snapshot variables (copy-on-write) and the cwd as a directory fd,
+    // run in this process, then put both back.
+    int cwd_fd = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (cwd_fd < 0)
+    {
+        return executeForkedSubshell(node);
+    }
+    Environment::VariableSnapshot variables_snapshot = m_environment.takeSnapshot();
+
+    ExecutionResult result = execute(node.body);
+
+    m_environment.restoreSnapshot(variables_snapshot);
+    if (fchdir(cwd_fd) != 0)
+    {
+        result.error_message = "subshell: Cannot restore working directory";
+        result.exit_status = 1;
+    }
+    close(cwd_fd);
+
+    result.continue_shell = true;
+    setLastExitStatus(result.exit_status);
+    return result;
+}
+
+ExecutionResult Executor::executeForkedSubshell(const SubshellNode& node)
+{
+    OutputSink::flushAll(); // The child must not inherit (and repeat) buffered output
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        setLastExitStatus(1);
+        return {1, "subshell: fork failed", true};
+    }
+    if (pid == 0)
+    {
+        ExecutionResult result = execute(node.body);
+        OutputSink::flushAll();
+        if (!result.error_message.empty())
+        {
+            std::cerr << "Tinyshell: " << result.error_message << std::endl;
+        }
+        _exit(result.exit_status & 0xFF);
+    }
+
+    int wait_status = 0;
+    if (waitpid(pid, &wait_status, 0) < 0)
+    {
+        setLastExitStatus(1);
+        return {1, "subshell: waitpid failed", true};
+    }
+    int exit_status = WIFEXITED(wait_status) ? WEXITSTATUS(wait_status) : 128 + WTERMSIG(wait_status);
+    setLastExitStatus(exit_status);
+    return {exit_status, "", true};
+}
+
+bool Executor::canRunInProcess(const AstNodePtr& node)
+{
+    if (!node)
+    {
+        return true;
+    }
+    if (auto simple_cmd = std::dynamic_pointer_cast<SimpleCommandNode>(node))
+    {
+        // `$cmd` may expand to anything; `exit` must only end the subshell.
+        if (simple_cmd->command.empty() || simple_cmd->command.find('$') != std::string::npos)
+        {
+            return false;
+        }
+        BuiltinCommandType builtin_type = Builtins::getBuiltinType(simple_cmd->command);
+        return builtin_type != BuiltinCommandType::Unknown && builtin_type != BuiltinCommandType::Exit;
+    }
+    if (auto sequence_cmd = std::dynamic_pointer_cast<CommandSequenceNode>(node))
+    {
+        return std::all_of(sequence_cmd->commands.begin(), sequence_cmd->commands.end(), canRunInProcess);
+    }
+    if (auto if_cmd = std::dynamic_pointer_cast<IfNode>(node))
+    {
+        for (const auto& elif_pair : if_cmd->elif_branches)
+        {
+            if (!canRunInProcess(elif_pair.first) || !canRunInProcess(elif_pair.second)) return false;
+        }
+        return canRunInProcess(if_cmd->condition_command) && canRunInProcess(if_cmd->then_branch) &&
+               canRunInProcess(if_cmd->else_branch);
+    }
+    if (auto while_cmd = std::dynamic_pointer_cast<WhileNode>(node))
+    {
+        return canRunInProcess(while_cmd->condition_command) && canRunInProcess(while_cmd->body);
+    }
+    if (auto for_cmd = std::dynamic_pointer_cast<ForNode>(node))
+    {
+        return canRunInProcess(for_cmd->body);
+    }
+    if (auto subshell_cmd = std::dynamic_pointer_cast<SubshellNode>(node))
+    {
+        return canRunInProcess(subshell_cmd->body);
+    }
+    if (auto and_or_cmd = std::dynamic_pointer_cast<AndOrListNode>(node))
+    {
+        return std::all_of(and_or_cmd->commands.begin(), and_or_cmd->commands.end(), canRunInProcess);
+    }
+    if (auto not_cmd = std::dynamic_pointer_cast<NotNode>(node))
+    {
+        return canRunInProcess(not_cmd->command);
+    }
+    if (auto case_cmd = std::dynamic_pointer_cast<CaseNode>(node))
+    {
+        return std::all_of(case_cmd->clauses.begin(), case_cmd->clauses.end(),
+                           [](const CaseClause& clause) { return canRunInProcess(clause.body); });
+    }
+    return false;
+}
+
 ExecutionResult Executor::executeExternalCommand(const std::string& command, const std::vector<std::string>& arguments)
 {
     std::stringstream command_stream;
@@ -248,6 +705,7 @@ ExecutionResult Executor::executeExternalCommand(const std::string& command, con
     }
 
     std::string full_command = command_stream.str();
+    OutputSink::flushAll(); // Builtin output so far must reach the fd before the command's own
     int system_ret = std::system(full_command.c_str());
     int exit_status = 0;
     std::string error_message = "";
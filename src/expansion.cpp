@@ -1,6 +1,12 @@
 #include "../include/expansion.hpp"
+#include "../include/globbing.hpp"
+#include "../include/glob_pattern.hpp"
 #include <sstream>
+#include <algorithm>
 #include <cctype>
+#include <cstring>
+#include <iterator> // make_move_iterator
+#include <memory>
 
 namespace g1_tinyshell
 {
@@ -28,8 +34,633 @@ bool Expansion::expandArguments(std::vector<std::string>& arguments, const Envir
     return true;
 }
 
+// Upper bound on words materialized from braces outside `for` loops.
+constexpr uint64_t K_MaxBraceWords = 1 << 22;
+
+bool Expansion::expandArguments(std::vector<std::string>& arguments, std::vector<bool>& unquoted_flags,
+                                const Environment& environment, std::string& error_message)
+{
+    error_message = "";
+    std::vector<std::unique_ptr<BraceExpansion>> brace_words(arguments.size());
+    bool changes_word_count = false; // Brace words or `${name[@]}`
+    uint64_t total_words = 0;
+    for (size_t i = 0; i < arguments.size(); ++i)
+    {
+        if (arguments[i].find("[@]}") != std::string::npos)
+        {
+            changes_word_count = true;
+        }
+        if (i < unquoted_flags.size() && unquoted_flags[i] && BraceExpansion::mayHaveBraces(arguments[i]))
+        {
+            auto brace_expansion = std::make_unique<BraceExpansion>(arguments[i]);
+            if (brace_expansion->hasGroups())
+            {
+                total_words += brace_expansion->size();
+                brace_words[i] = std::move(brace_expansion);
+                changes_word_count = true;
+                if (total_words > K_MaxBraceWords)
+                {
+                    error_message = "Brace expansion of `" + arguments[i] + "` produces too many words";
+                    return false;
+                }
+                continue;
+            }
+        }
+        ++total_words;
+    }
+    if (!changes_word_count)
+    {
+        return expandArguments(arguments, environment, error_message);
+    }
+
+    std::vector<std::string> expanded_words;
+    std::vector<bool> expanded_flags;
+    expanded_words.reserve(total_words);
+    expanded_flags.reserve(total_words);
+    for (size_t i = 0; i < arguments.size(); ++i)
+    {
+        bool unquoted = i < unquoted_flags.size() && unquoted_flags[i];
+        if (!brace_words[i] && expandArrayWord(arguments[i], environment, expanded_words))
+        {
+            expanded_flags.resize(expanded_words.size(), false); // Elements are not globbed
+        }
+        else if (!brace_words[i])
+        {
+            expanded_words.push_back(performExpansion(arguments[i], environment, error_message));
+            expanded_flags.push_back(unquoted);
+        }
+        else if (prepareBraceExpansion(*brace_words[i], environment, error_message))
+        {
+            std::string word;
+            while (brace_words[i]->next(word))
+            {
+                expanded_words.push_back(word);
+                expanded_flags.push_back(true);
+            }
+        }
+        if (!error_message.empty())
+        {
+            return false;
+        }
+    }
+    arguments = std::move(expanded_words);
+    unquoted_flags = std::move(expanded_flags);
+    return true;
+}
+
+bool Expansion::prepareBraceExpansion(BraceExpansion& brace_expansion, const Environment& environment,
+                                      std::string& error_message)
+{
+    error_message = "";
+    return brace_expansion.transformText([&](std::string& text)
+    {
+        if (text.find_first_of("$\\") != std::string::npos)
+        {
+            text = performExpansion(text, environment, error_message);
+        }
+        return error_message.empty();
+    });
+}
+
+void Expansion::expandPathnames(std::vector<std::string>& words, const std::vector<bool>& glob_flags)
+{
+    bool any_pattern = false;
+    for (size_t i = 0; i < words.size() && i < glob_flags.size(); ++i)
+    {
+        if (glob_flags[i] && GlobPattern::hasWildcards(words[i]))
+        {
+            any_pattern = true;
+            break;
+        }
+    }
+    if (!any_pattern)
+    {
+        return; // Common case: nothing to expand, no copies
+    }
+
+    std::vector<std::string> expanded_words;
+    expanded_words.reserve(words.size());
+    for (size_t i = 0; i < words.size(); ++i)
+    {
+        if (i < glob_flags.size() && glob_flags[i] && GlobPattern::hasWildcards(words[i]))
+        {
+            std::vector<std::string> matches = perform_globbing(words[i]);
+            if (!matches.empty())
+            {
+                expanded_words.insert(expanded_words.end(), std::make_move_iterator(matches.begin()),
+                                      std::make_move_iterator(matches.end()));
+                continue;
+            }
+            words[i] = GlobPattern::unescape(words[i]); // `"a*"b*` with no match stays `a*b*`
+        }
+        expanded_words.push_back(std::move(words[i]));
+    }
+    words = std::move(expanded_words);
+}
+
+bool Expansion::evaluateSubscript(const std::string& subscript, const Environment& environment, long long& index,
+                                  std::string& error_message)
+{
+    // The subscript may be a number, `$NAME`, or a bare variable name (as in `${arr[i]}`)
+    std::string value = subscript;
+    if (Environment::isValidVariableName(value))
+    {
+        value = environment.getVariable(value).value_or("0");
+    }
+    else if (value.find('$') != std::string::npos)
+    {
+        value = performExpansion(value, environment, error_message);
+        if (!error_message.empty())
+        {
+            return false;
+        }
+    }
+    try
+    {
+        size_t processed_chars = 0;
+        index = std::stoll(value, &processed_chars);
+        if (processed_chars == value.length())
+        {
+            return true;
+        }
+    }
+    catch (const std::exception&)
+    {
+    }
+    error_message = "Bad array subscript: " + subscript;
+    return false;
+}
+
+bool Expansion::expandArrayWord(const std::string& word, const Environment& environment, std::vector<std::string>& words)
+{
+    if (word.size() < 7 || word.compare(0, 2, "${") != 0 || word.compare(word.size() - 4, 4, "[@]}") != 0)
+    {
+        return false;
+    }
+    std::string name = word.substr(2, word.size() - 6);
+    if (!Environment::isValidVariableName(name))
+    {
+        return false;
+    }
+    const std::vector<std::string>* array = environment.getArray(name);
+    if (array)
+    {
+        words.insert(words.end(), array->begin(), array->end());
+    }
+    else if (std::optional<std::string> value = environment.getVariable(name))
+    {
+        words.push_back(*value); // A scalar behaves like a one-element array
+    }
+    return true;
+}
+
+size_t Expansion::findParameterEnd(const std::string& text, size_t open_pos)
+{
+    size_t depth = 1;
+    for (size_t i = open_pos + 1; i < text.length(); ++i)
+    {
+        if (text[i] == '\\')
+        {
+            ++i;
+        }
+        else if (text[i] == '$' && i + 1 < text.length() && text[i + 1] == '{')
+        {
+            ++depth;
+            ++i;
+        }
+        else if (text[i] == '}' && --depth == 0)
+        {
+            return i;
+        }
+    }
+    return std::string::npos;
+}
+
+namespace
+{
+// Length of the parameter reference at the start of `parameter`: NAME, NAME[...] or `?`.
+size_t parameter_reference_length(const std::string& parameter)
+{
+    if (!parameter.empty() && parameter[0] == '?')
+    {
+        return 1;
+    }
+    size_t name_end = 0;
+    while (name_end < parameter.length() &&
+           (std::isalnum(static_cast<unsigned char>(parameter[name_end])) || parameter[name_end] == '_'))
+    {
+        ++name_end;
+    }
+    if (name_end > 0 && name_end < parameter.length() && parameter[name_end] == '[')
+    {
+        size_t close_pos = parameter.find(']', name_end);
+        if (close_pos != std::string::npos)
+        {
+            return close_pos + 1;
+        }
+    }
+    return name_end;
+}
+
+// Finds the first unescaped `separator` at or after start_pos, skipping nested `${...}`.
+size_t find_operand_separator(const std::string& text, size_t start_pos, char separator)
+{
+    for (size_t i = start_pos; i < text.length(); ++i)
+    {
+        if (text[i] == '\\')
+        {
+            ++i;
+        }
+        else if (text[i] == '$' && i + 1 < text.length() && text[i + 1] == '{')
+        {
+            size_t close_pos = g1_tinyshell::Expansion::findParameterEnd(text, i + 1);
+            if (close_pos == std::string::npos)
+            {
+                return std::string::npos;
+            }
+            i = close_pos;
+        }
+        else if (text[i] == separator)
+        {
+            return i;
+        }
+    }
+    return std::string::npos;
+}
+
+// Length of the shortest (or longest) prefix of `text` matched by `pattern`, or npos.
+size_t match_prefix(const GlobPattern& pattern, const std::string& text, size_t start_pos, bool longest)
+{
+    if (pattern.isLiteral())
+    {
+        const std::string& literal = pattern.getLiteralText();
+        return text.compare(start_pos, literal.length(), literal) == 0 ? literal.length() : std::string::npos;
+    }
+    size_t available = text.length() - start_pos;
+    std::string candidate;
+    candidate.reserve(available);
+    for (size_t k = 0; k <= available; ++k)
+    {
+        size_t length = longest ? available - k : k;
+        candidate.assign(text, start_pos, length);
+        if (pattern.matches(candidate))
+        {
+            return length;
+        }
+    }
+    return std::string::npos;
+}
+
+// Start of the shortest (or longest) suffix of `text` matched by `pattern`, or npos.
+size_t match_suffix(const GlobPattern& pattern, const std::string& text, bool longest)
+{
+    if (pattern.isLiteral())
+    {
+        const std::string& literal = pattern.getLiteralText();
+        return (literal.length() <= text.length() &&
+                text.compare(text.length() - literal.length(), literal.length(), literal) == 0)
+                   ? text.length() - literal.length()
+                   : std::string::npos;
+    }
+    std::string candidate;
+    candidate.reserve(text.length());
+    for (size_t k = 0; k <= text.length(); ++k)
+    {
+        size_t start_pos = longest ? k : text.length() - k;
+        candidate.assign(text, start_pos, std::string::npos);
+        if (pattern.matches(candidate))
+        {
+            return start_pos;
+        }
+    }
+    return std::string::npos;
+}
+
+// `${v/pattern/replacement}` and its `//` (all), `/#` (prefix) and `/%` (suffix) forms.
+// Each match is the longest one starting at the leftmost possible position.
+std::string replace_pattern(const std::string& text, const GlobPattern& pattern, const std::string& replacement,
+                            char mode)
+{
+    if (mode == '%')
+    {
+        size_t start_pos = match_suffix(pattern, text, true);
+        return start_pos == std::string::npos ? text : text.substr(0, start_pos) + replacement;
+    }
+    if (mode == '#')
+    {
+        size_t length = match_prefix(pattern, text, 0, true);
+        return length == std::string::npos ? text : replacement + text.substr(length);
+    }
+
+    std::string result;
+    size_t position = 0;
+    if (pattern.isLiteral())
+    {
+        const std::string& literal = pattern.getLiteralText();
+        size_t found = text.find(literal);
+        while (found != std::string::npos)
+        {
+            result.append(text, position, found - position);
+            result += replacement;
+            position = found + literal.length();
+            if (mode != '/')
+            {
+                break;
+            }
+            found = text.find(literal, position);
+        }
+        result.append(text, position, std::string::npos);
+        return result;
+    }
+
+    while (position < text.length())
+    {
+        size_t length = match_prefix(pattern, text, position, true);
+        if (length == std::string::npos || length == 0)
+        {
+            result += text[position++];
+            continue;
+        }
+        result += replacement;
+        position += length;
+        if (mode != '/')
+        {
+            break;
+        }
+    }
+    result.append(text, position, std::string::npos);
+    return result;
+}
+}
+
+std::optional<std::string> Expansion::lookupParameter(const std::string& reference, bool want_length,
+                                                      const Environment& environment, std::string& error_message)
+{
+    size_t bracket_pos = reference.find('[');
+    if (bracket_pos == std::string::npos)
+    {
+        std::optional<std::string> value = environment.getVariable(reference);
+        if (want_length)
+        {
+            return std::to_string(value ? value->length() : 0);
+        }
+        return value;
+    }
+
+    std::string subscript = reference.substr(bracket_pos + 1, reference.length() - bracket_pos - 2);
+    std::string name = reference.substr(0, bracket_pos);
+    const std::vector<std::string>* array = environment.getArray(name);
+    std::optional<std::string> scalar_value;
+    if (!array)
+    {
+        scalar_value = environment.getVariable(name);
+    }
+    size_t element_count = array ? array->size() : (scalar_value ? 1 : 0);
+
+    if (subscript == "@" || subscript == "*")
+    {
+        if (want_length)
+        {
+            return std::to_string(element_count);
+        }
+        if (!array)
+        {
+            return scalar_value;
+        }
+        std::string joined;
+        for (size_t i = 0; i < array->size(); ++i)
+        {
+            if (i > 0)
+            {
+                joined += ' ';
+            }
+            joined += (*array)[i];
+        }
+        return joined;
+    }
+
+    long long index = 0;
+    if (!evaluateSubscript(subscript, environment, index, error_message))
+    {
+        return std::nullopt;
+    }
+    if (index < 0)
+    {
+        index += static_cast<long long>(element_count); // Negative subscripts count from the end
+    }
+    std::optional<std::string> element;
+    if (index >= 0 && static_cast<size_t>(index) < element_count)
+    {
+        element = array ? (*array)[index] : *scalar_value;
+    }
+    if (want_length)
+    {
+        return std::to_string(element ? element->length() : 0);
+    }
+    return element;
+}
+
+std::string Expansion::expandBracedParameter(const std::string& parameter, const Environment& environment,
+                                             std::string& error_message)
+{
+    bool want_length = parameter.length() > 1 && parameter[0] == '#';
+    std::string body = want_length ? parameter.substr(1) : parameter;
+    size_t reference_length = parameter_reference_length(body);
+    if (reference_length == 0 || (want_length && reference_length != body.length()))
+    {
+        error_message = "Bad substitution: ${" + parameter + "}";
+        return "";
+    }
+
+    std::optional<std::string> value =
+        lookupParameter(body.substr(0, reference_length), want_length, environment, error_message);
+    if (!error_message.empty() || reference_length == body.length())
+    {
+        return value.value_or("");
+    }
+
+    // Operators. Operands are expanded only when they are used.
+    std::string operation = body.substr(reference_length);
+    bool colon = operation[0] == ':' && operation.length() > 1 && std::strchr("-+?=", operation[1]);
+    char op = operation[colon ? 1 : 0];
+    auto expand_operand = [&](size_t start_pos, size_t end_pos)
+    {
+        return performExpansion(operation.substr(start_pos, end_pos - start_pos), environment, error_message);
+    };
+
+    if (op == '-' || op == '+' || op == '?' || op == '=')
+    {
+        bool is_set = value.has_value() && !(colon && value->empty());
+        if (op == '=')
+        {
+            error_message = "${" + parameter + "}: assignment in expansion is not supported; use setvar";
+            return "";
+        }
+        if (op == '+')
+        {
+            return is_set ? expand_operand(colon ? 2 : 1, operation.length()) : "";
+        }
+        if (is_set)
+        {
+            return *value;
+        }
+        if (op == '-')
+        {
+            return expand_operand(colon ? 2 : 1, operation.length());
+        }
+        std::string message = expand_operand(colon ? 2 : 1, operation.length());
+        if (error_message.empty())
+        {
+            error_message = body.substr(0, reference_length) + ": " +
+                            (message.empty() ? "parameter null or not set" : message);
+        }
+        return "";
+    }
+
+    // With NAME[@] / NAME[*], pattern operators apply to each element and `:` slices elements
+    std::string reference = body.substr(0, reference_length);
+    const std::vector<std::string>* elements = nullptr;
+    if (reference_length > 3 && (reference.compare(reference_length - 3, 3, "[@]") == 0 ||
+                                 reference.compare(reference_length - 3, 3, "[*]") == 0))
+    {
+        elements = environment.getArray(reference.substr(0, reference_length - 3));
+    }
+    std::string text = value.value_or("");
+    auto join_transformed = [&](auto transform)
+    {
+        if (!elements)
+        {
+            return transform(text);
+        }
+        std::string joined;
+        for (size_t i = 0; i < elements->size(); ++i)
+        {
+            if (i > 0)
+            {
+                joined += ' ';
+            }
+            joined += transform((*elements)[i]);
+        }
+        return joined;
+    };
+
+    if (op == '#' || op == '%')
+    {
+        bool longest = operation.length() > 1 && operation[1] == op;
+        std::string pattern_text = expand_operand(longest ? 2 : 1, operation.length());
+        if (!error_message.empty())
+        {
+            return "";
+        }
+        GlobPattern pattern(pattern_text); // Compiled once, even for every element of an array
+        return join_transformed([&](const std::string& item)
+        {
+            if (op == '#')
+            {
+                size_t length = match_prefix(pattern, item, 0, longest);
+                return length == std::string::npos ? item : item.substr(length);
+            }
+            size_t start_pos = match_suffix(pattern, item, longest);
+            return start_pos == std::string::npos ? item : item.substr(0, start_pos);
+        });
+    }
+
+    if (op == '/')
+    {
+        char mode = (operation.length() > 1 && std::strchr("/#%", operation[1])) ? operation[1] : '\0';
+        size_t pattern_start = mode ? 2 : 1;
+        size_t separator_pos = find_operand_separator(operation, pattern_start, '/');
+        std::string pattern_text = expand_operand(pattern_start, separator_pos == std::string::npos
+                                                                      ? operation.length()
+                                                                      : separator_pos);
+        std::string replacement = (separator_pos == std::string::npos)
+                                      ? ""
+                                      : expand_operand(separator_pos + 1, operation.length());
+        if (!error_message.empty())
+        {
+            return "";
+        }
+        if (pattern_text.empty())
+        {
+            return join_transformed([](const std::string& item) { return item; });
+        }
+        GlobPattern pattern(pattern_text);
+        return join_transformed([&](const std::string& item)
+        {
+            return replace_pattern(item, pattern, replacement, mode);
+        });
+    }
+
+    if (op == ':')
+    {
+        // `${v:offset}` / `${v:offset:length}` count characters (elements for NAME[@]);
+        // negative values count from the end (write `${v: -2}` so it is not read as `:-`)
+        size_t separator_pos = find_operand_separator(operation, 1, ':');
+        auto evaluate = [&](size_t start_pos, size_t end_pos, long long& number)
+        {
+            std::string operand = operation.substr(start_pos, end_pos - start_pos);
+            operand.erase(0, operand.find_first_not_of(" \t("));
+            operand.erase(operand.find_last_not_of(" \t)") + 1);
+            return evaluateSubscript(operand.empty() ? "0" : operand, environment, number, error_message);
+        };
+        long long total = static_cast<long long>(elements ? elements->size() : text.length());
+        long long offset = 0;
+        if (!evaluate(1, separator_pos == std::string::npos ? operation.length() : separator_pos, offset))
+        {
+            return "";
+        }
+        if (offset < 0)
+        {
+            offset += total;
+        }
+        if (offset < 0 || offset > total)
+        {
+            return "";
+        }
+        long long length = total - offset;
+        if (separator_pos != std::string::npos)
+        {
+            if (!evaluate(separator_pos + 1, operation.length(), length))
+            {
+                return "";
+            }
+            if (length < 0)
+            {
+                length += total - offset; // Negative length: stop that many before the end
+                if (length < 0)
+                {
+                    error_message = "${" + parameter + "}: substring expression < 0";
+                    return "";
+                }
+            }
+        }
+        length = std::min(length, total - offset);
+        if (!elements)
+        {
+            return text.substr(static_cast<size_t>(offset), static_cast<size_t>(length));
+        }
+        std::string joined;
+        for (long long i = offset; i < offset + length; ++i)
+        {
+            if (i > offset)
+            {
+                joined += ' ';
+            }
+            joined += (*elements)[i];
+        }
+        return joined;
+    }
+
+    error_message = "Bad substitution: ${" + parameter + "}";
+    return "";
+}
+
 std::string Expansion::performExpansion(const std::string& word, const Environment& environment, std::string& error_message)
 {
+    if (word.find_first_of("$\\") == std::string::npos)
+    {
+        return word; // Nothing to expand: skip the stream (hot in loop bodies)
+    }
     std::stringstream result_stream;
 
     for (size_t i = 0; i < word.length(); ++i)
@@ -68,14 +699,20 @@ std::string Expansion::performExpansion(const std::string& word, const Environme
             if (start_pos < word.length() && word[start_pos] == '{')
             {
                 start_pos++; // Bỏ qua '{'
-                size_t end_brace_pos = word.find('}', start_pos);
+                size_t end_brace_pos = findParameterEnd(word, start_pos - 1);
                 if (end_brace_pos == std::string::npos)
                 {
                     error_message = "Unclosed variable expansion brace starting at index " + std::to_string(i);
                     return ""; // Lỗi mở rộng
                 }
-                var_name = word.substr(start_pos, end_brace_pos - start_pos);
+                std::string parameter = word.substr(start_pos, end_brace_pos - start_pos);
                 i = end_brace_pos; // Di chuyển index qua '}'
+                result_stream << expandBracedParameter(parameter, environment, error_message);
+                if (!error_message.empty())
+                {
+                    return "";
+                }
+                continue;
             }
             else if (start_pos < word.length() && word[start_pos] == '?')
             {
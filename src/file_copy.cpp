@@ -0,0 +1,143 @@
+#include "../include/file_copy.hpp"
+#include <cerrno>
+#include <cstddef>
+#include <vector>
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace g1_tinyshell
+{
+
+namespace
+{
+constexpr size_t K_KernelCopyChunk = 1 << 30;  // Per copy_file_range/sendfile call
+constexpr size_t K_SpliceChunk = 1 << 20;      // Bounded by the pipe's capacity anyway
+constexpr size_t K_FallbackBufferSize = 1 << 20;
+
+enum class TransferResult
+{
+    Done,
+    Unsupported, // The first call failed in a way that means "try another method"
+    Failed
+};
+
+// Calls `transfer(chunk)` until it returns 0 (end of input).
+template <typename Transfer>
+TransferResult transfer_all(Transfer transfer, size_t chunk, uint64_t& bytes_copied)
+{
+    bool first_call = true;
+    while (true)
+    {
+        ssize_t moved = transfer(chunk);
+        if (moved > 0)
+        {
+            bytes_copied += static_cast<uint64_t>(moved);
+            first_call = false;
+            continue;
+        }
+        if (moved == 0)
+        {
+            return TransferResult::Done;
+        }
+        if (errno == EINTR || errno == EAGAIN)
+        {
+            continue;
+        }
+        // EINVAL/EXDEV/ENOSYS/EOPNOTSUPP: not possible between these descriptors (e.g. across
+        // filesystems on old kernels, an O_APPEND destination, a special file).
+        // EBADF is included for the O_APPEND case.
+        bool unsupported = errno == EINVAL || errno == EXDEV || errno == ENOSYS || errno == EOPNOTSUPP ||
+                           errno == EBADF;
+        return (first_call && unsupported) ? TransferResult::Unsupported : TransferResult::Failed;
+    }
+}
+
+bool write_all(int fd, const char* data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t written = write(fd, data, size);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+}
+
+bool copy_descriptor_data(int source_fd, int destination_fd, uint64_t& bytes_copied)
+{
+    bytes_copied = 0;
+    struct stat source_stat;
+    struct stat destination_stat;
+    if (fstat(source_fd, &source_stat) != 0 || fstat(destination_fd, &destination_stat) != 0)
+    {
+        return false;
+    }
+    if (S_ISDIR(source_stat.st_mode))
+    {
+        errno = EISDIR;
+        return false;
+    }
+
+    TransferResult result = TransferResult::Unsupported;
+    if (S_ISREG(source_stat.st_mode) && S_ISREG(destination_stat.st_mode))
+    {
+        result = transfer_all([&](size_t chunk)
+        {
+            return copy_file_range(source_fd, nullptr, destination_fd, nullptr, chunk, 0);
+        }, K_KernelCopyChunk, bytes_copied);
+    }
+    if (result == TransferResult::Unsupported && (S_ISFIFO(source_stat.st_mode) || S_ISFIFO(destination_stat.st_mode)))
+    {
+        result = transfer_all([&](size_t chunk)
+        {
+            return splice(source_fd, nullptr, destination_fd, nullptr, chunk, SPLICE_F_MOVE | SPLICE_F_MORE);
+        }, K_SpliceChunk, bytes_copied);
+    }
+    if (result == TransferResult::Unsupported && S_ISREG(source_stat.st_mode))
+    {
+        result = transfer_all([&](size_t chunk)
+        {
+            return sendfile(destination_fd, source_fd, nullptr, chunk);
+        }, K_KernelCopyChunk, bytes_copied);
+    }
+    if (result != TransferResult::Unsupported)
+    {
+        return result == TransferResult::Done;
+    }
+
+    std::vector<char> buffer(K_FallbackBufferSize);
+    while (true)
+    {
+        ssize_t bytes_read = read(source_fd, buffer.data(), buffer.size());
+        if (bytes_read == 0)
+        {
+            return true;
+        }
+        if (bytes_read < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        if (!write_all(destination_fd, buffer.data(), static_cast<size_t>(bytes_read)))
+        {
+            return false;
+        }
+        bytes_copied += static_cast<uint64_t>(bytes_read);
+    }
+}
+
+}
@@ -0,0 +1,316 @@
+#include "../include/glob_pattern.hpp"
+#include "../include/expansion.hpp" // findParameterEnd
+#include <cstring>
+
+namespace g1_tinyshell
+{
+
+constexpr const char* K_EscapedPatternChars = "*?[|{}";
+
+GlobPattern::GlobPattern(const std::string& pattern)
+    : m_hasStar(false), m_anchoredStart(true), m_anchoredEnd(true), m_isLiteral(true)
+{
+    Segment current_segment;
+
+    for (size_t i = 0; i < pattern.length(); ++i)
+    {
+        char c = pattern[i];
+        if (c == '*')
+        {
+            if (!m_hasStar && current_segment.empty() && m_segments.empty())
+            {
+                m_anchoredStart = false;
+            }
+            m_hasStar = true;
+            m_isLiteral = false;
+            if (!current_segment.empty())
+            {
+                m_segments.push_back(std::move(current_segment));
+                current_segment.clear();
+            }
+            continue;
+        }
+        if (c == '?')
+        {
+            current_segment.push_back({ElementType::AnyChar, '\0', 0});
+            m_isLiteral = false;
+            continue;
+        }
+        if (c == '[')
+        {
+            size_t end_pos = parseCharClass(pattern, i);
+            if (end_pos != 0)
+            {
+                current_segment.push_back({ElementType::CharClass, '\0', m_charClasses.size() - 1});
+                m_isLiteral = false;
+                i = end_pos - 1;
+                continue;
+            }
+            // Unclosed '[' is an ordinary character
+        }
+        if (c == '\\' && i + 1 < pattern.length())
+        {
+            c = pattern[++i];
+        }
+        current_segment.push_back({ElementType::Literal, c, 0});
+        m_literalText += c;
+    }
+
+    if (!current_segment.empty())
+    {
+        m_segments.push_back(std::move(current_segment));
+    }
+    else if (m_hasStar)
+    {
+        m_anchoredEnd = false; // Pattern ended with '*'
+    }
+    if (!m_isLiteral)
+    {
+        m_literalText.clear();
+    }
+}
+
+bool GlobPattern::matches(const std::string& text) const
+{
+    if (!m_hasStar)
+    {
+        // No '*': exactly one fixed-width run (or the empty pattern)
+        if (m_segments.empty())
+        {
+            return text.empty();
+        }
+        return m_segments[0].size() == text.length() && matchSegmentAt(m_segments[0], text, 0);
+    }
+
+    size_t begin = 0;
+    size_t end = text.length();
+    size_t first_segment = 0;
+    size_t last_segment = m_segments.size();
+
+    if (m_anchoredStart && first_segment < last_segment)
+    {
+        const Segment& prefix = m_segments[first_segment];
+        if (prefix.size() > end || !matchSegmentAt(prefix, text, 0))
+        {
+            return false;
+        }
+        begin = prefix.size();
+        ++first_segment;
+    }
+    if (m_anchoredEnd && first_segment < last_segment)
+    {
+        const Segment& suffix = m_segments[last_segment - 1];
+        if (suffix.size() > end - begin || !matchSegmentAt(suffix, text, end - suffix.size()))
+        {
+            return false;
+        }
+        end -= suffix.size();
+        --last_segment;
+    }
+
+    // Middle runs: leftmost occurrence is always safe since any '*' can absorb the rest.
+    for (size_t s = first_segment; s < last_segment; ++s)
+    {
+        const Segment& segment = m_segments[s];
+        bool found = false;
+        while (begin + segment.size() <= end)
+        {
+            if (matchSegmentAt(segment, text, begin))
+            {
+                found = true;
+                break;
+            }
+            ++begin;
+        }
+        if (!found)
+        {
+            return false;
+        }
+        begin += segment.size();
+    }
+    return true;
+}
+
+bool GlobPattern::isLiteral() const
+{
+    return m_isLiteral;
+}
+
+const std::string& GlobPattern::getLiteralText() const
+{
+    return m_literalText;
+}
+
+bool GlobPattern::startsWithLiteralDot() const
+{
+    return m_anchoredStart && !m_segments.empty() && m_segments[0][0].type == ElementType::Literal &&
+           m_segments[0][0].literal == '.';
+}
+
+bool GlobPattern::hasWildcards(const std::string& pattern)
+{
+    return pattern.find_first_of("*?[") != std::string::npos;
+}
+
+std::string GlobPattern::escape(const std::string& text, bool& found)
+{
+    found = false;
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        if (text[i] == '\\' && i + 1 < text.size())
+        {
+            escaped.append(text, i++, 2);
+            continue;
+        }
+        if (text[i] == '$' && i + 1 < text.size() && text[i + 1] == '{')
+        {
+            size_t close_pos = Expansion::findParameterEnd(text, i + 1);
+            if (close_pos != std::string::npos)
+            {
+                escaped.append(text, i, close_pos + 1 - i); // `${A[0]}` keeps its brackets
+                i = close_pos;
+                continue;
+            }
+        }
+        if (std::strchr(K_EscapedPatternChars, text[i]))
+        {
+            escaped += '\\';
+            found = true;
+        }
+        escaped += text[i];
+    }
+    return escaped;
+}
+
+std::string GlobPattern::unescape(const std::string& pattern)
+{
+    std::string text;
+    text.reserve(pattern.size());
+    for (size_t i = 0; i < pattern.size(); ++i)
+    {
+        if (pattern[i] == '\\' && i + 1 < pattern.size() && std::strchr(K_EscapedPatternChars, pattern[i + 1]))
+        {
+            ++i;
+        }
+        text += pattern[i];
+    }
+    return text;
+}
+
+bool GlobPattern::matchSegmentAt(const Segment& segment, const std::string& text, size_t position) const
+{
+    for (size_t i = 0; i < segment.size(); ++i)
+    {
+        if (!matchElement(segment[i], static_cast<unsigned char>(text[position + i])))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool GlobPattern::matchElement(const Element& element, unsigned char c) const
+{
+    switch (element.type)
+    {
+        case ElementType::Literal:   return static_cast<unsigned char>(element.literal) == c;
+        case ElementType::AnyChar:   return true;
+        case ElementType::CharClass: return m_charClasses[element.class_index].test(c);
+    }
+    return false;
+}
+
+// Parses `[...]` starting at start_pos ('['). Supports ranges, and '!' or '^' for negation;
+// a ']' right after the opening (or negation) is literal.
+size_t GlobPattern::parseCharClass(const std::string& pattern, size_t start_pos)
+{
+    size_t i = start_pos + 1;
+    bool negate = false;
+    if (i < pattern.length() && (pattern[i] == '!' || pattern[i] == '^'))
+    {
+        negate = true;
+        ++i;
+    }
+
+    std::bitset<256> char_class;
+    bool first = true;
+    while (i < pattern.length() && (pattern[i] != ']' || first))
+    {
+        first = false;
+        unsigned char range_start = static_cast<unsigned char>(pattern[i]);
+        if (range_start == '\\' && i + 1 < pattern.length())
+        {
+            range_start = static_cast<unsigned char>(pattern[++i]);
+        }
+        if (i + 2 < pattern.length() && pattern[i + 1] == '-' && pattern[i + 2] != ']')
+        {
+            size_t end_pos = i + 2;
+            if (pattern[end_pos] == '\\' && end_pos + 1 < pattern.length())
+            {
+                ++end_pos; // An escaped endpoint stands for itself, as in fnmatch()
+            }
+            unsigned char range_end = static_cast<unsigned char>(pattern[end_pos]);
+            for (unsigned int ch = range_start; ch <= range_end; ++ch)
+            {
+                char_class.set(ch);
+            }
+            i = end_pos + 1;
+        }
+        else
+        {
+            char_class.set(range_start);
+            ++i;
+        }
+    }
+    if (i >= pattern.length())
+    {
+        return 0; // No closing ']'
+    }
+    if (negate)
+    {
+        char_class.flip();
+    }
+    m_charClasses.push_back(char_class);
+    return i + 1;
+}
+
+void PatternDispatcher::addPattern(const std::string& pattern, size_t target)
+{
+    GlobPattern compiled(pattern);
+    if (compiled.isLiteral())
+    {
+        // emplace keeps the earliest target if the same literal appears twice
+        m_literalTargets.emplace(compiled.getLiteralText(), target);
+    }
+    else
+    {
+        m_wildcardTargets.emplace_back(std::move(compiled), target);
+    }
+}
+
+std::optional<size_t> PatternDispatcher::find(const std::string& text) const
+{
+    std::optional<size_t> literal_target;
+    auto it = m_literalTargets.find(text);
+    if (it != m_literalTargets.end())
+    {
+        literal_target = it->second;
+    }
+
+    for (const auto& wildcard : m_wildcardTargets)
+    {
+        if (literal_target.has_value() && wildcard.second >= literal_target.value())
+        {
+            break; // The literal hit comes first
+        }
+        if (wildcard.first.matches(text))
+        {
+            return wildcard.second;
+        }
+    }
+    return literal_target;
+}
+
+}
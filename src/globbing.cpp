@@ -1,65 +1,245 @@
 #include "globbing.hpp"
-#include <windows.h>
-#include <string>
-#include <vector>
-#include <iostream>
+#include "directory_cache.hpp"
+#include "glob_pattern.hpp"
+#include "work_stealing_pool.hpp"
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
-bool match_pattern_simple(const char *text, const char *pattern) {
-    while (*pattern) {
-        if (*pattern == '?') {
-            if (!*text) return false;
-            text++;
-            pattern++;
-        } else if (*pattern == '*') {
-            pattern++;
-            if (!*pattern) return true;
-            while (*text) {
-                if (match_pattern_simple(text, pattern)) return true;
-                text++;
-            }
-            return false;
+namespace {
+
+// Kernel record layout for getdents64 (not exported by older libc headers).
+struct LinuxDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+
+constexpr size_t K_DirentBufferSize = 1 << 20; // 1 MiB: ~30k entries per syscall
+
+// Splits a pattern into its non-empty path components.
+std::vector<std::string> split_path_components(const std::string& pattern) {
+    std::vector<std::string> components;
+    size_t start_pos = 0;
+    while (start_pos < pattern.length()) {
+        size_t slash_pos = pattern.find('/', start_pos);
+        if (slash_pos == std::string::npos) slash_pos = pattern.length();
+        if (slash_pos > start_pos) {
+            components.push_back(pattern.substr(start_pos, slash_pos - start_pos));
+        }
+        start_pos = slash_pos + 1;
+    }
+    return components;
+}
+
+// True if the entry is (or, for symlinks and unknown types, resolves to) a directory.
+// `name` is resolved relative to dir_fd (AT_FDCWD for paths relative to the cwd).
+bool entry_is_directory(int dir_fd, const std::string& name, unsigned char type) {
+    if (type == DT_DIR) return true;
+    if (type != DT_LNK && type != DT_UNKNOWN) return false;
+    struct stat st;
+    return fstatat(dir_fd, name.c_str(), &st, 0) == 0 && S_ISDIR(st.st_mode);
+}
+
+// Keeps a directory fd open while child directories are still being opened relative to it.
+struct DirectoryHandle {
+    int fd;
+    explicit DirectoryHandle(int dir_fd) : fd(dir_fd) {}
+    ~DirectoryHandle() { close(fd); }
+};
+
+// Shared state of one parallel `**` walk.
+struct TreeWalk {
+    const g1_tinyshell::GlobPattern* entry_pattern = nullptr; // nullptr: every entry qualifies
+    bool directories_only = false;
+    bool match_hidden = false;
+    g1_tinyshell::WorkStealingPool* pool = nullptr;
+    std::mutex results_mutex;
+    std::vector<std::string> results;
+};
+
+// Lists one directory, emits qualifying entries and queues each non-hidden subdirectory
+// as a new task. Children are opened with openat() relative to this directory's fd.
+// Symlinks to directories are matched but not descended into.
+void walk_directory(TreeWalk& walk, const std::shared_ptr<DirectoryHandle>& parent, const std::string& name,
+                    const std::string& path) {
+    int dir_fd = -1;
+    if (parent) {
+        dir_fd = openat(parent->fd, name.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    }
+    if (dir_fd < 0) {
+        // Root of the walk, or openat failed (e.g. EMFILE): resolve by path
+        dir_fd = open(path.empty() ? "." : path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dir_fd < 0) return;
+    }
+    auto handle = std::make_shared<DirectoryHandle>(dir_fd);
+
+    std::vector<DirectoryEntry> entries;
+    read_directory_entries(dir_fd, entries);
+
+    std::vector<std::string> local_results;
+    for (const DirectoryEntry& entry : entries) {
+        bool hidden = entry.name[0] == '.';
+        bool is_real_directory = entry.type == DT_DIR;
+        if (entry.type == DT_UNKNOWN) {
+            struct stat st;
+            is_real_directory = fstatat(dir_fd, entry.name.c_str(), &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+        }
+        if (is_real_directory && !hidden) {
+            std::string child_path = path + entry.name + "/";
+            walk.pool->submit([&walk, handle, child_name = entry.name, child_path]() {
+                walk_directory(walk, handle, child_name, child_path);
+            });
+        }
+
+        if (hidden && !walk.match_hidden) continue;
+        if (walk.entry_pattern && !walk.entry_pattern->matches(entry.name)) continue;
+        if (walk.directories_only) {
+            if (!is_real_directory && !entry_is_directory(dir_fd, entry.name, entry.type)) continue;
+            local_results.push_back(path + entry.name + "/");
         } else {
-            if (*text != *pattern) return false;
-            text++;
-            pattern++;
+            local_results.push_back(path + entry.name);
         }
     }
-    return !*text;
+
+    if (!local_results.empty()) {
+        std::lock_guard<std::mutex> lock(walk.results_mutex);
+        walk.results.insert(walk.results.end(), std::make_move_iterator(local_results.begin()),
+                            std::make_move_iterator(local_results.end()));
+    }
 }
 
-std::vector<std::string> perform_globbing(const std::string& pattern) {
-    std::vector<std::string> matches;
-    WIN32_FIND_DATAW find_data;
-    HANDLE hFind = INVALID_HANDLE_VALUE;
+// Runs a parallel walk from every base path and returns the unsorted results.
+std::vector<std::string> walk_directory_trees(const std::vector<std::string>& base_paths, TreeWalk& walk) {
+    g1_tinyshell::WorkStealingPool pool;
+    walk.pool = &pool;
+    for (const std::string& base_path : base_paths) {
+        pool.submit([&walk, base_path]() { walk_directory(walk, nullptr, "", base_path); });
+    }
+    pool.wait();
+    return std::move(walk.results);
+}
 
-    std::wstring wpattern(pattern.begin(), pattern.end());
+} // namespace
 
-    hFind = FindFirstFileW(wpattern.c_str(), &find_data);
+bool read_directory_entries(int dir_fd, std::vector<DirectoryEntry>& entries) {
+    // One buffer per thread: parallel walks read many small directories
+    thread_local std::vector<char> buffer(K_DirentBufferSize);
+    while (true) {
+        long bytes_read = syscall(SYS_getdents64, dir_fd, buffer.data(), buffer.size());
+        if (bytes_read < 0) return false;
+        if (bytes_read == 0) return true;
 
-    if (hFind == INVALID_HANDLE_VALUE) {
+        for (long offset = 0; offset < bytes_read;) {
+            const LinuxDirent64* record = reinterpret_cast<const LinuxDirent64*>(buffer.data() + offset);
+            offset += record->d_reclen;
+            const char* name = record->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                continue;
+            }
+            entries.push_back({name, record->d_type});
+        }
+    }
+}
+
+std::vector<std::string> perform_globbing(const std::string& pattern) {
+    std::vector<std::string> matches;
+    if (!g1_tinyshell::GlobPattern::hasWildcards(pattern)) {
         return matches;
     }
 
-    do {
-        if (wcscmp(find_data.cFileName, L".") != 0 && wcscmp(find_data.cFileName, L"..") != 0) {
-            std::wstring wfilename = find_data.cFileName;
-            int len = WideCharToMultiByte(CP_ACP, 0, wfilename.c_str(), -1, NULL, 0, NULL, NULL);
-            if (len > 0) {
-                 std::string filename(len - 1, 0);
-                 WideCharToMultiByte(CP_ACP, 0, wfilename.c_str(), -1, &filename[0], len, NULL, NULL);
-                 matches.push_back(filename);
+    std::vector<std::string> components = split_path_components(pattern);
+    bool trailing_slash = !pattern.empty() && pattern.back() == '/';
+    bool seen_wildcard = false;
+    bool verify_existence = false; // Literal components after a wildcard are not checked while walking
+
+    // Paths built so far, each ending in '/' (or empty for the current directory)
+    std::vector<std::string> current_paths = {(!pattern.empty() && pattern[0] == '/') ? "/" : ""};
+
+    for (size_t i = 0; i < components.size() && !current_paths.empty(); ++i) {
+        const std::string& component = components[i];
+        bool last_component = i + 1 == components.size();
+        bool needs_directory = !last_component || trailing_slash;
+        std::string separator = needs_directory ? "/" : "";
+
+        if (!g1_tinyshell::GlobPattern::hasWildcards(component)) {
+            for (std::string& path : current_paths) {
+                path += component + separator;
+            }
+            verify_existence = verify_existence || seen_wildcard;
+            continue;
+        }
+        seen_wildcard = true;
+
+        if (component == "**") {
+            // `**` matches zero or more directory levels. When exactly one component follows,
+            // it is matched during the walk itself so every directory is read only once.
+            TreeWalk walk;
+            bool fuse_next = i + 2 == components.size();
+            std::unique_ptr<g1_tinyshell::GlobPattern> next_pattern;
+            if (fuse_next) {
+                next_pattern = std::make_unique<g1_tinyshell::GlobPattern>(components[i + 1]);
+                walk.entry_pattern = next_pattern.get();
+                walk.match_hidden = next_pattern->startsWithLiteralDot();
+                walk.directories_only = trailing_slash;
             } else {
-                 std::cerr << "Globbing Warning: Failed to convert filename." << std::endl;
+                walk.directories_only = needs_directory;
+            }
+
+            std::vector<std::string> walk_results = walk_directory_trees(current_paths, walk);
+            if (!fuse_next && !last_component) {
+                // Zero levels: the base directories themselves are also candidates
+                walk_results.insert(walk_results.end(), current_paths.begin(), current_paths.end());
+            }
+            current_paths = std::move(walk_results);
+            if (fuse_next) {
+                if (!g1_tinyshell::GlobPattern::hasWildcards(components[i + 1])) {
+                    verify_existence = false; // Literal names were matched against real entries
+                }
+                ++i;
+            }
+            continue;
+        }
+
+        g1_tinyshell::GlobPattern compiled(component);
+        bool match_hidden = compiled.startsWithLiteralDot();
+        std::vector<std::string> next_paths;
+
+        for (const std::string& base_path : current_paths) {
+            // Listings come from the shared cache, so repeated globs over a directory stay in memory
+            std::shared_ptr<const g1_tinyshell::DirectoryCache::EntryList> entries =
+                g1_tinyshell::DirectoryCache::instance().getEntries(base_path.empty() ? "." : base_path);
+            if (!entries) continue;
+
+            for (const DirectoryEntry& entry : *entries) {
+                if (entry.name[0] == '.' && !match_hidden) continue;
+                if (!compiled.matches(entry.name)) continue;
+                if (needs_directory && !entry_is_directory(AT_FDCWD, base_path + entry.name, entry.type)) continue;
+                next_paths.push_back(base_path + entry.name + separator);
             }
         }
-    } while (FindNextFileW(hFind, &find_data) != 0);
+        current_paths = std::move(next_paths);
+    }
 
-    FindClose(hFind);
+    for (std::string& path : current_paths) {
+        struct stat st;
+        if (verify_existence && lstat(path.c_str(), &st) != 0) continue;
+        matches.push_back(std::move(path));
+    }
     std::sort(matches.begin(), matches.end());
     return matches;
 }
 
 bool match_pattern(const std::string& text, const std::string& pattern) {
-     return match_pattern_simple(text.c_str(), pattern.c_str());
-}
\ No newline at end of file
+    return g1_tinyshell::GlobPattern(pattern).matches(text);
+}
@@ -0,0 +1,163 @@
+#include "../include/history_expansion.hpp"
+#include <cctype>
+#include <cstring>
+
+namespace g1_tinyshell
+{
+
+namespace
+{
+bool is_blank(char c)
+{
+    return std::isspace(static_cast<unsigned char>(c)) != 0;
+}
+
+bool ends_event_word(char c)
+{
+    return is_blank(c) || std::strchr(";&|()<>'\"`", c) != nullptr;
+}
+
+std::string last_word(const std::string& command)
+{
+    size_t end = command.find_last_not_of(" \t");
+    if (end == std::string::npos)
+    {
+        return "";
+    }
+    size_t start = command.find_last_of(" \t", end);
+    start = (start == std::string::npos) ? 0 : start + 1;
+    return command.substr(start, end + 1 - start);
+}
+
+// `^old^new[^rest]`; returns false with `error` set if the previous command has no `old`.
+bool substitute_previous(const std::string& line, size_t separator, const HistoryStore& history,
+                         std::string& expanded, std::string& error)
+{
+    std::string old_text = line.substr(1, separator - 1);
+    size_t end = line.find('^', separator + 1);
+    std::string new_text = line.substr(separator + 1, end == std::string::npos ? std::string::npos : end - separator - 1);
+    std::string previous = history.empty() ? "" : history.at(history.size() - 1);
+    size_t position = previous.find(old_text);
+    if (old_text.empty() || history.empty() || position == std::string::npos)
+    {
+        error = "^" + old_text + "^" + new_text + ": Substitution failed";
+        return false;
+    }
+    expanded = previous.replace(position, old_text.size(), new_text);
+    if (end != std::string::npos)
+    {
+        expanded += line.substr(end + 1);
+    }
+    return true;
+}
+}
+
+bool expand_history(const std::string& line, const HistoryStore& history, std::string& expanded, std::string& error)
+{
+    if (line.empty() || (line.find('!') == std::string::npos && line[0] != '^'))
+    {
+        expanded = line;
+        return true;
+    }
+    size_t separator = line.find('^', 1);
+    if (line[0] == '^' && separator != std::string::npos)
+    {
+        return substitute_previous(line, separator, history, expanded, error);
+    }
+
+    expanded.clear();
+    size_t count = history.size();
+    bool in_single_quotes = false;
+    bool in_double_quotes = false;
+    for (size_t i = 0; i < line.size(); ++i)
+    {
+        char c = line[i];
+        if (in_single_quotes)
+        {
+            in_single_quotes = (c != '\'');
+            expanded += c;
+            continue;
+        }
+        if (c == '\\' && i + 1 < line.size())
+        {
+            expanded += c;
+            expanded += line[++i];
+            continue;
+        }
+        if (c == '\'' && !in_double_quotes)
+        {
+            in_single_quotes = true;
+        }
+        else if (c == '"')
+        {
+            in_double_quotes = !in_double_quotes;
+        }
+        else if (c == '#' && !in_double_quotes && (i == 0 || is_blank(line[i - 1])))
+        {
+            expanded.append(line, i, std::string::npos);
+            break;
+        }
+        bool literal = c != '!' || i + 1 >= line.size() || is_blank(line[i + 1]) || std::strchr("=(\"", line[i + 1]) ||
+                       (i > 0 && line[i - 1] == '$') || (i > 1 && line[i - 1] == '{' && line[i - 2] == '$');
+        if (literal)
+        {
+            expanded += c;
+            continue;
+        }
+
+        size_t event_start = i;
+        char next = line[i + 1];
+        bool found = false;
+        size_t index = 0;
+        if (next == '!' || next == '$')
+        {
+            found = count > 0;
+            index = count - 1;
+            ++i;
+        }
+        else if (std::isdigit(static_cast<unsigned char>(next)) ||
+                 (next == '-' && i + 2 < line.size() && std::isdigit(static_cast<unsigned char>(line[i + 2]))))
+        {
+            size_t j = (next == '-') ? i + 2 : i + 1;
+            size_t number = 0;
+            for (; j < line.size() && std::isdigit(static_cast<unsigned char>(line[j])) && number <= count; ++j)
+            {
+                number = number * 10 + static_cast<size_t>(line[j] - '0');
+            }
+            found = number >= 1 && number <= count;
+            index = (next == '-') ? count - number : number - 1;
+            i = j - 1;
+        }
+        else if (next == '?')
+        {
+            size_t end = line.find('?', i + 2);
+            std::string text = line.substr(i + 2, end == std::string::npos ? std::string::npos : end - i - 2);
+            found = history.searchBackward(text, count, index);
+            i = (end == std::string::npos) ? line.size() - 1 : end;
+        }
+        else
+        {
+            size_t j = i + 1;
+            while (j < line.size() && !ends_event_word(line[j]))
+            {
+                ++j;
+            }
+            if (j == i + 1)
+            {
+                expanded += c; // `!;` and the like
+                continue;
+            }
+            found = history.searchPrefix(line.substr(i + 1, j - i - 1), count, index);
+            i = j - 1;
+        }
+        if (!found)
+        {
+            error = line.substr(event_start, i + 1 - event_start) + ": Event not found";
+            return false;
+        }
+        expanded += (next == '$') ? last_word(history.at(index)) : history.at(index);
+    }
+    return true;
+}
+
+}
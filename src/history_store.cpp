@@ -0,0 +1,710 @@
+#include "../include/history_store.hpp"
+#include "../include/tinyshell_globals.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <string_view>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_set>
+
+namespace g1_tinyshell
+{
+
+namespace
+{
+std::string encode_command(const std::string& command)
+{
+    std::string encoded;
+    encoded.reserve(command.size());
+    for (char c : command)
+    {
+        if (c == '\\')
+        {
+            encoded += "\\\\";
+        }
+        else if (c == '\n')
+        {
+            encoded += "\\n";
+        }
+        else
+        {
+            encoded += c;
+        }
+    }
+    return encoded;
+}
+
+// Skips a record's timestamp: returns the still-encoded command and shortens `length` to it.
+// Lines without a timestamp (a hand-written or imported file) get time 0.
+const char* split_record(const char* record, size_t& length, int64_t& timestamp)
+{
+    timestamp = 0;
+    size_t digits = 0;
+    while (digits < length && record[digits] >= '0' && record[digits] <= '9')
+    {
+        timestamp = timestamp * 10 + (record[digits] - '0');
+        ++digits;
+    }
+    if (digits > 0 && digits < length && record[digits] == '\t')
+    {
+        length -= digits + 1;
+        return record + digits + 1;
+    }
+    timestamp = 0;
+    return record;
+}
+
+bool needs_decoding(const char* text, size_t length)
+{
+    return std::memchr(text, '\\', length) != nullptr;
+}
+
+std::string decode_command(const char* text, size_t length)
+{
+    std::string command;
+    command.reserve(length);
+    for (size_t i = 0; i < length; ++i)
+    {
+        if (text[i] == '\\' && i + 1 < length)
+        {
+            ++i;
+            command += (text[i] == 'n') ? '\n' : text[i];
+        }
+        else
+        {
+            command += text[i];
+        }
+    }
+    return command;
+}
+
+// Equal commands have equal encodings, so the encoded bytes are hashed, eight at a time.
+// Never 0, which marks a free CommandTable slot.
+uint64_t hash_command(const char* encoded, size_t length)
+{
+    uint64_t hash = 0x9e3779b97f4a7c15ULL ^ length;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, encoded + i, 8);
+        hash = (hash ^ word) * 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 32;
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, encoded + i, length - i);
+    hash = (hash ^ tail) * 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 29;
+    return hash | 1;
+}
+
+bool write_all(int fd, const char* data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t written = write(fd, data, size);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+// Rewrites `path` with the newest use of its `keep` most recently used commands. Runs on the
+// compaction thread, with its own lock descriptor: flock() locks belong to the open file, so
+// sharing the appender's would not exclude it.
+void compact_history_file(const std::string& path, size_t keep)
+{
+    int lock_fd = ::open((path + ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (lock_fd < 0 || flock(lock_fd, LOCK_EX) != 0)
+    {
+        if (lock_fd >= 0)
+        {
+            close(lock_fd);
+        }
+        return;
+    }
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat file_stat;
+    if (fd >= 0 && fstat(fd, &file_stat) == 0 && file_stat.st_size > 0)
+    {
+        size_t size = static_cast<size_t>(file_stat.st_size);
+        void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED)
+        {
+            // Walk back record by record (the last byte is a newline), keeping first sightings
+            const char* data = static_cast<const char*>(map);
+            std::unordered_set<std::string_view> seen;
+            std::vector<std::pair<size_t, size_t>> kept; // Record ranges, newest first
+            size_t end = size;
+            size_t records = 0;
+            while (end > 0 && kept.size() < keep)
+            {
+                const void* newline = end > 1 ? memrchr(data, '\n', end - 1) : nullptr;
+                size_t start = newline ? static_cast<size_t>(static_cast<const char*>(newline) - data) + 1 : 0;
+                size_t length = end - 1 - start;
+                int64_t timestamp;
+                const char* text = split_record(data + start, length, timestamp);
+                if (seen.emplace(text, length).second)
+                {
+                    kept.emplace_back(start, end);
+                }
+                end = start;
+                ++records;
+            }
+            if (end > 0 || kept.size() < records)
+            {
+                std::string contents;
+                contents.reserve(size - end);
+                for (auto it = kept.rbegin(); it != kept.rend(); ++it)
+                {
+                    contents.append(data + it->first, it->second - it->first);
+                }
+                std::string temp_path = path + ".compact." + std::to_string(getpid());
+                int temp_fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+                if (temp_fd >= 0)
+                {
+                    bool written = write_all(temp_fd, contents.data(), contents.size()) && fsync(temp_fd) == 0;
+                    close(temp_fd);
+                    if (!written || rename(temp_path.c_str(), path.c_str()) != 0)
+                    {
+                        unlink(temp_path.c_str());
+                    }
+                }
+            }
+            munmap(map, size);
+        }
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    flock(lock_fd, LOCK_UN);
+    close(lock_fd);
+}
+}
+
+void HistoryStore::CommandTable::reserve(size_t count)
+{
+    size_t capacity = 16;
+    unsigned shift = 60;
+    while (capacity < 2 * count)
+    {
+        capacity <<= 1;
+        --shift;
+    }
+    if (capacity <= m_hashes.size())
+    {
+        return;
+    }
+    m_shift = shift;
+    std::vector<uint64_t> hashes(capacity, 0);
+    std::vector<uint32_t> values(capacity);
+    hashes.swap(m_hashes);
+    values.swap(m_values);
+    for (size_t i = 0; i < hashes.size(); ++i)
+    {
+        if (hashes[i] != 0)
+        {
+            size_t slot = slotOf(hashes[i]);
+            m_hashes[slot] = hashes[i];
+            m_values[slot] = values[i];
+        }
+    }
+}
+
+uint32_t& HistoryStore::CommandTable::emplace(uint64_t hash, uint32_t value, bool& inserted)
+{
+    if (2 * (m_count + 1) > m_hashes.size())
+    {
+        reserve(m_count + 1);
+    }
+    size_t slot = slotOf(hash);
+    inserted = (m_hashes[slot] == 0);
+    if (inserted)
+    {
+        m_hashes[slot] = hash;
+        m_values[slot] = value;
+        ++m_count;
+    }
+    return m_values[slot];
+}
+
+uint32_t* HistoryStore::CommandTable::find(uint64_t hash)
+{
+    if (m_hashes.empty())
+    {
+        return nullptr;
+    }
+    size_t slot = slotOf(hash);
+    return m_hashes[slot] == hash ? &m_values[slot] : nullptr;
+}
+
+void HistoryStore::CommandTable::erase(uint64_t hash)
+{
+    if (m_hashes.empty())
+    {
+        return;
+    }
+    size_t mask = m_hashes.size() - 1;
+    size_t slot = slotOf(hash);
+    if (m_hashes[slot] != hash)
+    {
+        return;
+    }
+    // Shift later members of the probe run back, so lookups never stop at a hole too early
+    size_t next = slot;
+    while (true)
+    {
+        next = (next + 1) & mask;
+        if (m_hashes[next] == 0)
+        {
+            break;
+        }
+        size_t home = m_hashes[next] >> m_shift;
+        if (((next - home) & mask) >= ((next - slot) & mask))
+        {
+            m_hashes[slot] = m_hashes[next];
+            m_values[slot] = m_values[next];
+            slot = next;
+        }
+    }
+    m_hashes[slot] = 0;
+    --m_count;
+}
+
+// The slot holding `hash`, or the free slot where it belongs (linear probing).
+size_t HistoryStore::CommandTable::slotOf(uint64_t hash) const
+{
+    size_t mask = m_hashes.size() - 1;
+    size_t slot = hash >> m_shift;
+    while (m_hashes[slot] != 0 && m_hashes[slot] != hash)
+    {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+HistoryStore::HistoryStore()
+    : m_fd(-1), m_lockFd(-1), m_map(nullptr), m_mapSize(0), m_sessionPopped(0),
+      m_maxEntries(K_DefaultHistorySize), m_maxFileEntries(K_DefaultHistoryFileSize), m_fileRecords(0),
+      m_compacting(false), m_indexReady(true), m_stopping(false)
+{
+}
+
+HistoryStore::~HistoryStore()
+{
+    m_stopping = true;
+    if (m_indexBuilder.joinable())
+    {
+        m_indexBuilder.join();
+    }
+    if (m_compaction.joinable())
+    {
+        m_compaction.join();
+    }
+    if (m_map)
+    {
+        munmap(const_cast<char*>(m_map), m_mapSize);
+    }
+    if (m_fd >= 0)
+    {
+        close(m_fd);
+    }
+    if (m_lockFd >= 0)
+    {
+        close(m_lockFd);
+    }
+}
+
+void HistoryStore::setMaxEntries(size_t max_entries)
+{
+    m_maxEntries = max_entries;
+}
+
+bool HistoryStore::open(const std::string& path, size_t max_file_entries)
+{
+    m_path = path;
+    m_maxFileEntries = max_file_entries;
+    m_lockFd = ::open((path + ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    int fd = ::open(path.c_str(), O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0 || m_lockFd < 0)
+    {
+        int error_number = errno;
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        if (m_lockFd >= 0)
+        {
+            close(m_lockFd);
+            m_lockFd = -1;
+        }
+        errno = error_number;
+        return false;
+    }
+    m_fd = fd;
+
+    // Commands are hashed while their bytes are in cache, for the de-duplication below
+    std::vector<uint64_t> hashes;
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0)
+    {
+        size_t size = static_cast<size_t>(file_stat.st_size);
+        void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED)
+        {
+            m_map = static_cast<const char*>(map);
+            m_mapSize = size;
+            madvise(map, size, MADV_SEQUENTIAL);
+            // Index only whole records: a shell may be appending right now
+            size_t position = 0;
+            while (position < size)
+            {
+                const void* newline = std::memchr(m_map + position, '\n', size - position);
+                if (!newline)
+                {
+                    break;
+                }
+                m_offsets.push_back(position);
+                size_t length = static_cast<size_t>(static_cast<const char*>(newline) - m_map) - position;
+                int64_t timestamp;
+                const char* text = split_record(m_map + position, length, timestamp);
+                hashes.push_back(hash_command(text, length));
+                position = static_cast<size_t>(static_cast<const char*>(newline) - m_map) + 1;
+            }
+            m_offsets.push_back(position);
+            madvise(map, size, MADV_RANDOM);
+        }
+    }
+    m_fileRecords = mappedCount();
+
+    // Newest first, so each command is kept at its last use and older records stop mattering
+    // once the limit is reached
+    std::vector<uint32_t> live;
+    m_latest.reserve(std::min(mappedCount(), m_maxEntries));
+    for (size_t record = mappedCount(); record-- > 0 && live.size() < m_maxEntries;)
+    {
+        bool inserted;
+        uint32_t newer = m_latest.emplace(hashes[record], static_cast<uint32_t>(record), inserted);
+        if (!inserted)
+        {
+            size_t length;
+            size_t newer_length;
+            int64_t timestamp;
+            const char* text = mappedText(static_cast<uint32_t>(record), length, timestamp);
+            const char* newer_text = mappedText(newer, newer_length, timestamp);
+            if (newer_length == length && std::memcmp(newer_text, text, length) == 0)
+            {
+                continue; // Run again later
+            }
+        }
+        live.push_back(static_cast<uint32_t>(record));
+    }
+    std::reverse(live.begin(), live.end());
+    m_live.assign(live.begin(), live.end());
+
+    if (m_fileRecords > m_maxFileEntries + m_maxFileEntries / 4)
+    {
+        startCompaction();
+    }
+    if (!live.empty())
+    {
+        m_indexReady = false;
+        m_indexBuilder = std::thread(&HistoryStore::buildIndex, this, std::move(live));
+    }
+    return true;
+}
+
+void HistoryStore::add(const std::string& command)
+{
+    int64_t now = static_cast<int64_t>(std::time(nullptr));
+    std::string encoded = encode_command(command);
+    if (m_fd >= 0)
+    {
+        appendRecord(std::to_string(now) + "\t" + encoded + "\n");
+    }
+    std::lock_guard<std::mutex> lock(m_indexMutex);
+    uint32_t sequence = static_cast<uint32_t>(mappedCount() + m_sessionPopped + m_sessionEntries.size());
+    bool inserted;
+    uint32_t& latest = m_latest.emplace(hash_command(encoded.data(), encoded.size()), sequence, inserted);
+    if (!inserted)
+    {
+        // The earlier use leaves the history, unless the hash merely collided
+        uint32_t previous = latest;
+        auto it = std::lower_bound(m_live.begin(), m_live.end(), previous);
+        if (it != m_live.end() && *it == previous && entry(previous).second == command)
+        {
+            m_live.erase(it);
+            if (m_indexReady)
+            {
+                m_index.remove(previous, command.data(), command.size());
+            }
+            else if (previous < mappedCount())
+            {
+                m_supersededRecords.push_back(previous); // The builder indexes it anyway
+            }
+            if (previous >= mappedCount())
+            {
+                std::string().swap(m_sessionEntries[previous - mappedCount() - m_sessionPopped].second);
+            }
+        }
+        latest = sequence;
+    }
+    m_sessionEntries.emplace_back(now, command);
+    m_live.push_back(sequence);
+    if (m_indexReady)
+    {
+        m_index.add(sequence, command.data(), command.size());
+    }
+
+    while (m_live.size() > m_maxEntries)
+    {
+        uint64_t hash = entryHash(m_live.front());
+        uint32_t* latest_use = m_latest.find(hash);
+        if (latest_use && *latest_use == m_live.front())
+        {
+            m_latest.erase(hash);
+        }
+        m_live.pop_front();
+    }
+    while (!m_sessionEntries.empty() && (m_live.empty() || mappedCount() + m_sessionPopped < m_live.front()))
+    {
+        m_sessionEntries.pop_front();
+        ++m_sessionPopped;
+    }
+}
+
+size_t HistoryStore::size() const
+{
+    return m_live.size();
+}
+
+bool HistoryStore::empty() const
+{
+    return m_live.empty();
+}
+
+std::string HistoryStore::at(size_t index) const
+{
+    return entry(m_live[index]).second;
+}
+
+int64_t HistoryStore::timestampAt(size_t index) const
+{
+    return entry(m_live[index]).first;
+}
+
+bool HistoryStore::searchBackward(const std::string& pattern, size_t before, size_t& match) const
+{
+    return findBackward(pattern, false, before, match);
+}
+
+bool HistoryStore::searchPrefix(const std::string& prefix, size_t before, size_t& match) const
+{
+    return findBackward(prefix, true, before, match);
+}
+
+size_t HistoryStore::mappedCount() const
+{
+    return m_offsets.empty() ? 0 : m_offsets.size() - 1;
+}
+
+std::pair<int64_t, std::string> HistoryStore::entry(uint32_t sequence) const
+{
+    if (sequence >= mappedCount())
+    {
+        return m_sessionEntries[sequence - mappedCount() - m_sessionPopped];
+    }
+    size_t length;
+    int64_t timestamp;
+    const char* text = mappedText(sequence, length, timestamp);
+    return {timestamp, needs_decoding(text, length) ? decode_command(text, length) : std::string(text, length)};
+}
+
+// The still-encoded command of a mapped record.
+const char* HistoryStore::mappedText(uint32_t record, size_t& length, int64_t& timestamp) const
+{
+    length = m_offsets[record + 1] - 1 - m_offsets[record]; // Without the newline
+    return split_record(m_map + m_offsets[record], length, timestamp);
+}
+
+uint64_t HistoryStore::entryHash(uint32_t sequence) const
+{
+    if (sequence >= mappedCount())
+    {
+        std::string encoded = encode_command(m_sessionEntries[sequence - mappedCount() - m_sessionPopped].second);
+        return hash_command(encoded.data(), encoded.size());
+    }
+    size_t length;
+    int64_t timestamp;
+    const char* text = mappedText(sequence, length, timestamp);
+    return hash_command(text, length);
+}
+
+bool HistoryStore::entryMatches(uint32_t sequence, const std::string& pattern, bool prefix) const
+{
+    const char* text;
+    size_t length;
+    std::string decoded;
+    if (sequence >= mappedCount())
+    {
+        const std::string& command = m_sessionEntries[sequence - mappedCount() - m_sessionPopped].second;
+        text = command.data();
+        length = command.size();
+    }
+    else
+    {
+        int64_t timestamp;
+        text = mappedText(sequence, length, timestamp);
+        if (needs_decoding(text, length))
+        {
+            decoded = decode_command(text, length);
+            text = decoded.data();
+            length = decoded.size();
+        }
+    }
+    if (prefix)
+    {
+        return length >= pattern.size() && std::memcmp(text, pattern.data(), pattern.size()) == 0;
+    }
+    return memmem(text, length, pattern.data(), pattern.size()) != nullptr;
+}
+
+bool HistoryStore::findBackward(const std::string& pattern, bool prefix, size_t before, size_t& match) const
+{
+    before = std::min(before, size());
+    if (pattern.empty() || before == 0)
+    {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_indexMutex);
+    if (m_indexReady && (prefix || pattern.size() >= 3))
+    {
+        auto end = m_live.begin() + static_cast<std::ptrdiff_t>(before);
+        uint32_t sequence = m_live[before - 1] + 1;
+        while (prefix ? m_index.previousPrefixCandidate(pattern, sequence, sequence)
+                      : m_index.previousCandidate(pattern, sequence, sequence))
+        {
+            if (sequence < m_live.front())
+            {
+                return false;
+            }
+            // Candidates include entries that were run again later
+            auto it = std::lower_bound(m_live.begin(), end, sequence);
+            if (it != end && *it == sequence && entryMatches(sequence, pattern, prefix))
+            {
+                match = static_cast<size_t>(it - m_live.begin());
+                return true;
+            }
+        }
+        return false;
+    }
+    // Short patterns match often, so the scan stops early; long ones land here only while the
+    // index is still being built
+    for (size_t index = before; index-- > 0;)
+    {
+        if (entryMatches(m_live[index], pattern, prefix))
+        {
+            match = index;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Runs on m_indexBuilder: indexes the mapped records kept, then whatever was added meanwhile.
+void HistoryStore::buildIndex(std::vector<uint32_t> records)
+{
+    TrigramIndex index;
+    for (size_t i = 0; i < records.size() && !m_stopping; ++i)
+    {
+        size_t length;
+        int64_t timestamp;
+        const char* text = mappedText(records[i], length, timestamp);
+        if (needs_decoding(text, length))
+        {
+            std::string command = decode_command(text, length);
+            index.add(records[i], command.data(), command.size());
+        }
+        else
+        {
+            index.add(records[i], text, length);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_indexMutex);
+    for (size_t k = 0; k < m_sessionEntries.size(); ++k)
+    {
+        const std::string& command = m_sessionEntries[k].second; // Empty once run again
+        index.add(static_cast<uint32_t>(mappedCount() + m_sessionPopped + k), command.data(), command.size());
+    }
+    for (uint32_t record : m_supersededRecords)
+    {
+        std::string command = entry(record).second;
+        index.remove(record, command.data(), command.size());
+    }
+    std::vector<uint32_t>().swap(m_supersededRecords);
+    m_index = std::move(index);
+    m_indexReady = true;
+}
+
+void HistoryStore::appendRecord(const std::string& record)
+{
+    // A shared lock: a compaction cannot swap the file between the check and the write
+    bool locked = flock(m_lockFd, LOCK_SH) == 0;
+    struct stat path_stat;
+    struct stat fd_stat;
+    if (stat(m_path.c_str(), &path_stat) != 0 || fstat(m_fd, &fd_stat) != 0 || path_stat.st_ino != fd_stat.st_ino ||
+        path_stat.st_dev != fd_stat.st_dev)
+    {
+        int fd = ::open(m_path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+        if (fd >= 0)
+        {
+            close(m_fd);
+            m_fd = fd;
+        }
+    }
+    write_all(m_fd, record.data(), record.size()); // One write(): whole records, even when shells race
+    if (locked)
+    {
+        flock(m_lockFd, LOCK_UN);
+    }
+
+    if (++m_fileRecords > m_maxFileEntries + m_maxFileEntries / 4)
+    {
+        startCompaction();
+    }
+}
+
+void HistoryStore::startCompaction()
+{
+    if (m_compacting.exchange(true))
+    {
+        return;
+    }
+    if (m_compaction.joinable())
+    {
+        m_compaction.join(); // The previous run has finished (m_compacting was false)
+    }
+    m_fileRecords = m_maxFileEntries;
+    m_compaction = std::thread([this, path = m_path, keep = m_maxFileEntries]()
+    {
+        compact_history_file(path, keep);
+        m_compacting = false;
+    });
+}
+
+}
@@ -1,4 +1,6 @@
 #include "../include/lexer.hpp"
+#include "../include/expansion.hpp" // findParameterEnd
+#include "../include/glob_pattern.hpp"
 #include <iostream>
 #include <cctype>
 #include <unordered_map>
@@ -10,17 +12,18 @@ const std::unordered_map<std::string, TokenType> K_Keywords = {
     {"if", TokenType::If}, {"then", TokenType::Then}, {"elif", TokenType::Elif},
     {"else", TokenType::Else}, {"fi", TokenType::Fi}, {"while", TokenType::While},
     {"do", TokenType::Do}, {"done", TokenType::Done}, {"for", TokenType::For},
-    {"in", TokenType::In}
+    {"in", TokenType::In}, {"case", TokenType::Case}, {"esac", TokenType::Esac}
 };
 
 Lexer::Lexer(const std::string& input)
-    : m_input(input), m_currentPosition(0), m_errorMessage("") {}
+    : m_input(input), m_currentPosition(0), m_errorMessage(""), m_previousWordEnd(std::string::npos) {}
 
 std::vector<Token> Lexer::tokenize()
 {
     std::vector<Token> tokens;
     m_errorMessage = "";
     m_currentPosition = 0;
+    m_previousWordEnd = std::string::npos;
 
     while (!isAtEnd())
     {
@@ -38,13 +41,28 @@ std::vector<Token> Lexer::tokenize()
         }
         if (current_char == '\'' || current_char == '"')
         {
-            tokens.push_back(processQuotedString(current_char));
+            pushWordToken(tokens, processQuotedString(current_char));
+        }
+        else if (isAtDoubledOperator())
+        {
+            tokens.push_back(processOperatorOrRedirect());
         }
         else if (isSpecialChar(current_char))
         {
             TokenType type = TokenType::Error;
             std::string val_str(1, current_char);
+            if (current_char == ';' && m_currentPosition + 1 < m_input.length() &&
+                m_input[m_currentPosition + 1] == ';')
+            {
+                tokens.push_back({TokenType::DoubleSemicolon, ";;", m_currentPosition});
+                advance();
+                advance();
+                continue;
+            }
             if (current_char == ';') type = TokenType::Semicolon;
+            else if (current_char == '(') type = TokenType::LeftParen;
+            else if (current_char == ')') type = TokenType::RightParen;
+            else if (current_char == '<') type = TokenType::RedirectIn;
 
             if (type != TokenType::Error)
             {
@@ -59,9 +77,9 @@ std::vector<Token> Lexer::tokenize()
         else
         {
             if (current_char == '$') {
-                tokens.push_back(processVariable());
+                pushWordToken(tokens, processVariable());
             } else {
-                tokens.push_back(processWord());
+                pushWordToken(tokens, processWord());
             }
         }
 
@@ -80,6 +98,82 @@ std::vector<Token> Lexer::tokenize()
     return tokens;
 }
 
+namespace
+{
+bool is_name_char(char c)
+{
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+// Turns a trailing, unescaped `$NAME` into `${NAME}`, so text appended to it stays separate.
+void delimit_trailing_variable(std::string& value)
+{
+    size_t name_start = value.size();
+    while (name_start > 0 && is_name_char(value[name_start - 1]))
+    {
+        --name_start;
+    }
+    if (name_start == value.size() || name_start == 0 || value[name_start - 1] != '$' ||
+        std::isdigit(static_cast<unsigned char>(value[name_start])))
+    {
+        return;
+    }
+    size_t backslashes = 0;
+    while (backslashes + 1 < name_start && value[name_start - 2 - backslashes] == '\\')
+    {
+        ++backslashes;
+    }
+    if (backslashes % 2 == 0)
+    {
+        value.insert(name_start, "{");
+        value += '}';
+    }
+}
+}
+
+void Lexer::pushWordToken(std::vector<Token>& tokens, Token token)
+{
+    bool word_like = token.type == TokenType::Word || token.type == TokenType::Variable;
+    if (word_like && !tokens.empty() && m_previousWordEnd == token.position &&
+        (tokens.back().type == TokenType::Word || tokens.back().type == TokenType::Variable))
+    {
+        m_wordPieces.emplace_back(token.value, token.quoted);
+        bool any_quoted = false;
+        bool unquoted_patterns = false;
+        for (const auto& piece : m_wordPieces)
+        {
+            bool has_patterns = false;
+            GlobPattern::escape(piece.first, has_patterns);
+            any_quoted = any_quoted || piece.second;
+            unquoted_patterns = unquoted_patterns || (!piece.second && has_patterns);
+        }
+        Token& previous = tokens.back();
+        previous.type = TokenType::Word;
+        previous.quoted = any_quoted && !unquoted_patterns;
+        previous.value.clear();
+        for (const auto& piece : m_wordPieces)
+        {
+            bool has_patterns = false;
+            std::string text = (piece.second && unquoted_patterns) ? GlobPattern::escape(piece.first, has_patterns)
+                                                                   : piece.first;
+            if (!text.empty() && is_name_char(text[0]))
+            {
+                delimit_trailing_variable(previous.value);
+            }
+            previous.value += text;
+        }
+    }
+    else
+    {
+        if (word_like)
+        {
+            m_wordPieces.assign(1, {token.value, token.quoted});
+        }
+        tokens.push_back(std::move(token));
+    }
+    m_previousWordEnd = word_like ? m_currentPosition : std::string::npos;
+}
+
 Token Lexer::processWord()
 {
     size_t start_pos = m_currentPosition;
@@ -87,8 +181,10 @@ Token Lexer::processWord()
     while (!isAtEnd())
     {
         char current_char = peek();
-        if (isWhitespace(current_char) || isSpecialChar(current_char) ||
-            current_char == '#' || current_char == '\'' || current_char == '"' || current_char == '$')
+        // A '$' that starts the word did not begin a variable (`$1`, lone `$`): keep it literally
+        if (isWhitespace(current_char) || isSpecialChar(current_char) || isAtDoubledOperator() ||
+            current_char == '#' || current_char == '\'' || current_char == '"' ||
+            (current_char == '$' && m_currentPosition != start_pos))
         {
             break;
         }
@@ -104,6 +200,16 @@ Token Lexer::processWord()
     return {TokenType::Word, word_value, start_pos};
 }
 
+// Single '&' and '|' are left inside words so external commands still see them.
+Token Lexer::processOperatorOrRedirect()
+{
+    size_t start_pos = m_currentPosition;
+    std::string op_value;
+    op_value += advance();
+    op_value += advance();
+    return {TokenType::Operator, op_value, start_pos};
+}
+
 Token Lexer::processVariable()
 {
     size_t start_pos = m_currentPosition;
@@ -112,18 +218,18 @@ Token Lexer::processVariable()
     std::string var_name_or_special;
     char next_char = peek();
 
+    if (next_char == '(') {
+        m_currentPosition = start_pos;
+        return processCommandSubstitution();
+    }
     if (next_char == '{') {
-        advance();
-        size_t name_start = m_currentPosition;
-        while(!isAtEnd() && peek() != '}') {
-            advance();
-        }
-        if (isAtEnd() || peek() != '}') {
+        size_t close_pos = Expansion::findParameterEnd(m_input, m_currentPosition); // Operands may nest `${...}`
+        if (close_pos == std::string::npos) {
             m_errorMessage = "Lexer error: Unclosed variable brace for ${";
             return {TokenType::Error, m_errorMessage, start_pos};
         }
-        var_name_or_special = m_input.substr(name_start, m_currentPosition - name_start);
-        advance();
+        var_name_or_special = m_input.substr(m_currentPosition + 1, close_pos - m_currentPosition - 1);
+        m_currentPosition = close_pos + 1;
     } else if (next_char == '?') {
         var_name_or_special = "?";
         advance();
@@ -143,7 +249,48 @@ Token Lexer::processVariable()
          m_errorMessage = "Lexer error: Empty variable name.";
          return {TokenType::Error, m_errorMessage, start_pos};
     }
-    return {TokenType::Variable, var_name_or_special, start_pos};
+    // Keep the original `$NAME` / `${NAME}` text; Expansion resolves it later.
+    return {TokenType::Variable, m_input.substr(start_pos, m_currentPosition - start_pos), start_pos};
+}
+
+Token Lexer::processCommandSubstitution()
+{
+    size_t start_pos = m_currentPosition;
+    advance(); // '$'
+    advance(); // '('
+    size_t command_start = m_currentPosition;
+    size_t depth = 1;
+    while (!isAtEnd())
+    {
+        char current_char = advance();
+        if (current_char == '\'' || current_char == '"')
+        {
+            // Parentheses inside quotes do not count
+            while (!isAtEnd() && peek() != current_char)
+            {
+                if (current_char == '"' && peek() == '\\' && m_currentPosition + 1 < m_input.length())
+                {
+                    advance();
+                }
+                advance();
+            }
+            if (!isAtEnd())
+            {
+                advance();
+            }
+        }
+        else if (current_char == '(')
+        {
+            ++depth;
+        }
+        else if (current_char == ')' && --depth == 0)
+        {
+            std::string command = m_input.substr(command_start, m_currentPosition - 1 - command_start);
+            return {TokenType::CommandSubstitution, command, start_pos};
+        }
+    }
+    m_errorMessage = "Lexer error: Unclosed command substitution $(";
+    return {TokenType::Error, m_errorMessage, start_pos};
 }
 
 Token Lexer::processQuotedString(char quote_char)
@@ -167,22 +314,31 @@ Token Lexer::processQuotedString(char quote_char)
             }
             char next_char = peek();
 
+            // `\$` and `\\` are kept escaped so Expansion produces them literally
             if (quote_char == '"') {
-                if (next_char == '"' || next_char == '\\' || next_char == '$') {
+                if (next_char == '"') {
                     value += advance();
                 } else {
                     value += '\\';
                     value += advance();
                 }
             } else {
-                if (next_char == quote_char || next_char == '\\') {
+                if (next_char == quote_char) {
                     value += advance();
+                } else if (next_char == '\\') {
+                    value += "\\\\";
+                    advance();
                 } else {
-                    value += '\\';
+                    value += "\\\\";
                     value += advance();
                 }
             }
         }
+        else if (quote_char == '\'' && current_char == '$')
+        {
+            value += '\\'; // Nothing is expanded inside single quotes
+            value += advance();
+        }
         else if (current_char == quote_char)
         {
             advance();
@@ -200,7 +356,7 @@ Token Lexer::processQuotedString(char quote_char)
         m_errorMessage = "Lexer error: Unclosed quote: " + std::string(1, quote_char);
         return {TokenType::Error, m_errorMessage, start_pos};
     }
-    return {TokenType::Word, value, start_pos};
+    return {TokenType::Word, value, start_pos, true};
 }
 
 Token Lexer::processComment()
@@ -236,10 +392,24 @@ bool Lexer::isWhitespace(char c) const
     return std::isspace(static_cast<unsigned char>(c));
 }
 
+bool Lexer::isOperatorChar(char c) const
+{
+    return c == '&' || c == '|';
+}
+
+bool Lexer::isAtDoubledOperator() const
+{
+    return isOperatorChar(peek()) && m_currentPosition + 1 < m_input.length() &&
+           m_input[m_currentPosition + 1] == peek();
+}
+
 bool Lexer::isSpecialChar(char c) const
 {
     switch (c) {
         case ';':
+        case '(':
+        case ')':
+        case '<':
             return true;
         default:
             return false;
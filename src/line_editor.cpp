@@ -0,0 +1,933 @@
+#include "../include/line_editor.hpp"
+#include "../include/builtins.hpp"
+#include "../include/directory_cache.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <iostream>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace g1_tinyshell
+{
+
+namespace
+{
+// Keys decoded from escape sequences; plain bytes are returned as themselves
+constexpr int K_KeyNone = 0;
+constexpr int K_KeyEndOfInput = -1;
+constexpr int K_KeyEscape = 256;
+constexpr int K_KeyUp = 257;
+constexpr int K_KeyDown = 258;
+constexpr int K_KeyLeft = 259;
+constexpr int K_KeyRight = 260;
+constexpr int K_KeyHome = 261;
+constexpr int K_KeyEnd = 262;
+constexpr int K_KeyDelete = 263;
+constexpr int K_KeyWordLeft = 264;
+constexpr int K_KeyWordRight = 265;
+
+constexpr int K_EscapeTimeoutMs = 50;      // A lone Esc is not followed by the rest of a sequence
+constexpr size_t K_MaxListedWithoutAsking = 100;
+
+constexpr int control(char c)
+{
+    return c & 0x1f;
+}
+
+bool is_blank(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+bool is_continuation_byte(char c)
+{
+    return (static_cast<unsigned char>(c) & 0xc0) == 0x80;
+}
+
+size_t next_boundary(const std::string& text, size_t position)
+{
+    ++position;
+    while (position < text.size() && is_continuation_byte(text[position]))
+    {
+        ++position;
+    }
+    return position;
+}
+
+size_t previous_boundary(const std::string& text, size_t position)
+{
+    --position;
+    while (position > 0 && is_continuation_byte(text[position]))
+    {
+        --position;
+    }
+    return position;
+}
+
+// Bytes in the UTF-8 sequence a lead byte starts (1 for ASCII and malformed bytes).
+size_t sequence_length(char lead_byte)
+{
+    unsigned char lead = static_cast<unsigned char>(lead_byte);
+    return (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xe ? 3 : (lead >> 3) == 0x1e ? 4 : 1;
+}
+
+// Continuation bytes still missing from the last sequence of `text`.
+size_t missing_continuation_bytes(const std::string& text)
+{
+    if (text.empty())
+    {
+        return 0;
+    }
+    size_t lead = text.size();
+    while (lead > 0 && text.size() - lead < 4)
+    {
+        --lead;
+        if (!is_continuation_byte(text[lead]))
+        {
+            break;
+        }
+    }
+    size_t present = text.size() - lead;
+    size_t expected = sequence_length(text[lead]);
+    return expected > present ? expected - present : 0;
+}
+
+// Decodes the code point at `position`; a malformed byte stands for itself.
+uint32_t decode_at(const std::string& text, size_t position, size_t& length)
+{
+    unsigned char lead = static_cast<unsigned char>(text[position]);
+    size_t expected = sequence_length(text[position]);
+    if (expected <= 1 || position + expected > text.size())
+    {
+        length = 1;
+        return lead;
+    }
+    uint32_t code_point = lead & (0x7f >> expected);
+    for (size_t i = 1; i < expected; ++i)
+    {
+        if (!is_continuation_byte(text[position + i]))
+        {
+            length = 1;
+            return lead;
+        }
+        code_point = (code_point << 6) | (static_cast<unsigned char>(text[position + i]) & 0x3f);
+    }
+    length = expected;
+    return code_point;
+}
+
+// Columns a code point takes: control characters are shown as ^X, combining marks take
+// none and East Asian wide characters and emoji take two.
+size_t code_point_width(uint32_t code_point)
+{
+    if (code_point < 0x20 || code_point == 0x7f)
+    {
+        return 2;
+    }
+    if ((code_point >= 0x0300 && code_point <= 0x036f) || (code_point >= 0x200b && code_point <= 0x200f) ||
+        (code_point >= 0xfe00 && code_point <= 0xfe0f))
+    {
+        return 0;
+    }
+    if ((code_point >= 0x1100 && code_point <= 0x115f) || (code_point >= 0x2e80 && code_point <= 0xa4cf) ||
+        (code_point >= 0xac00 && code_point <= 0xd7a3) || (code_point >= 0xf900 && code_point <= 0xfaff) ||
+        (code_point >= 0xfe30 && code_point <= 0xfe4f) || (code_point >= 0xff00 && code_point <= 0xff60) ||
+        (code_point >= 0xffe0 && code_point <= 0xffe6) || (code_point >= 0x1f300 && code_point <= 0x1f64f) ||
+        (code_point >= 0x1f900 && code_point <= 0x1f9ff) || (code_point >= 0x20000 && code_point <= 0x3fffd))
+    {
+        return 2;
+    }
+    return 1;
+}
+
+size_t text_width(const std::string& text, size_t begin, size_t end)
+{
+    size_t width = 0;
+    for (size_t position = begin; position < end;)
+    {
+        size_t length;
+        width += code_point_width(decode_at(text, position, length));
+        position += length;
+    }
+    return width;
+}
+
+// Width of a prompt, not counting `ESC [ ... m` color sequences.
+size_t prompt_width(const std::string& prompt)
+{
+    std::string visible;
+    for (size_t i = 0; i < prompt.size(); ++i)
+    {
+        if (prompt[i] == '\x1b' && i + 1 < prompt.size() && prompt[i + 1] == '[')
+        {
+            i += 2;
+            while (i < prompt.size() && !(prompt[i] >= 0x40 && prompt[i] <= 0x7e))
+            {
+                ++i;
+            }
+            continue;
+        }
+        visible += prompt[i];
+    }
+    return text_width(visible, 0, visible.size());
+}
+
+void append_display(std::string& output, const std::string& text, size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; ++i)
+    {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c < 0x20 || c == 0x7f)
+        {
+            output += '^';
+            output += static_cast<char>(c ^ 0x40);
+        }
+        else
+        {
+            output += text[i];
+        }
+    }
+}
+
+size_t terminal_columns()
+{
+    struct winsize size;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_col > 0)
+    {
+        return size.ws_col;
+    }
+    return 80;
+}
+
+bool is_word_byte(char c)
+{
+    unsigned char byte = static_cast<unsigned char>(c);
+    return byte >= 0x80 || std::isalnum(byte) || c == '_';
+}
+
+// The lexer takes `\ ` literally, so names with special characters are double-quoted instead.
+// The quote is left open while the name is still incomplete, as more may follow.
+std::string quote_word(const std::string& word, bool complete)
+{
+    if (word.find_first_of(" \t\\'\"$&;|()<>*?[]{}#`!") == std::string::npos)
+    {
+        return word;
+    }
+    std::string quoted = "\"";
+    for (char c : word)
+    {
+        if (c == '"' || c == '$' || c == '\\')
+        {
+            quoted += '\\';
+        }
+        quoted += c;
+    }
+    return complete ? quoted + '"' : quoted;
+}
+
+bool starts_with(const std::string& text, const std::string& prefix)
+{
+    return text.compare(0, prefix.size(), prefix) == 0;
+}
+
+// Puts the terminal in raw mode for the lifetime of the object.
+class RawMode
+{
+public:
+    RawMode()
+    {
+        m_active = tcgetattr(STDIN_FILENO, &m_saved) == 0;
+        if (m_active)
+        {
+            struct termios raw = m_saved;
+            raw.c_iflag &= ~static_cast<tcflag_t>(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+            raw.c_cflag |= CS8;
+            raw.c_lflag &= ~static_cast<tcflag_t>(ECHO | ICANON | IEXTEN | ISIG);
+            // c_oflag is left alone: OPOST still turns each "\n" written into "\r\n"
+            raw.c_cc[VMIN] = 1;
+            raw.c_cc[VTIME] = 0;
+            m_active = tcsetattr(STDIN_FILENO, TCSADRAIN, &raw) == 0;
+        }
+    }
+
+    ~RawMode()
+    {
+        if (m_active)
+        {
+            tcsetattr(STDIN_FILENO, TCSADRAIN, &m_saved);
+        }
+    }
+
+    bool active() const
+    {
+        return m_active;
+    }
+
+private:
+    struct termios m_saved;
+    bool m_active;
+};
+}
+
+LineEditor::LineEditor(const HistoryStore& history, const Environment& environment)
+    : m_history(history), m_environment(environment), m_promptWidth(0), m_cursor(0), m_historyIndex(0),
+      m_listOnTab(false), m_inputPosition(0)
+{
+}
+
+bool LineEditor::readLine(const std::string& prompt, std::string& line)
+{
+    m_commands.requestRefresh(); // Revalidated while the user types
+    RawMode raw_mode;
+    if (!raw_mode.active())
+    {
+        std::cout << prompt << std::flush;
+        return static_cast<bool>(std::getline(std::cin, line));
+    }
+
+    m_prompt = prompt;
+    m_promptWidth = prompt_width(prompt);
+    m_buffer.clear();
+    m_cursor = 0;
+    m_historyIndex = m_history.size();
+    m_draft.clear();
+    m_listOnTab = false;
+    refresh();
+
+    int pending_key = K_KeyNone; // Handed back by the reverse search
+    while (true)
+    {
+        int key = (pending_key != K_KeyNone) ? pending_key : readKey();
+        pending_key = K_KeyNone;
+        if (key != '\t')
+        {
+            m_listOnTab = false;
+        }
+
+        if (key == K_KeyEndOfInput || (key == control('D') && m_buffer.empty()))
+        {
+            if (m_buffer.empty())
+            {
+                return false;
+            }
+            key = '\r'; // Input ended after some text: run it
+        }
+        if (key == '\r' || key == '\n')
+        {
+            m_cursor = m_buffer.size();
+            refresh();
+            writeOutput("\n");
+            line = m_buffer;
+            return true;
+        }
+
+        if (key == '\t')
+        {
+            complete();
+        }
+        else if (key == control('C'))
+        {
+            writeOutput("^C\n");
+            m_buffer.clear();
+            m_cursor = 0;
+            m_historyIndex = m_history.size();
+        }
+        else if (key == control('D') || key == K_KeyDelete)
+        {
+            if (m_cursor < m_buffer.size())
+            {
+                m_buffer.erase(m_cursor, next_boundary(m_buffer, m_cursor) - m_cursor);
+            }
+        }
+        else if (key == 127 || key == control('H'))
+        {
+            if (m_cursor > 0)
+            {
+                size_t previous = previous_boundary(m_buffer, m_cursor);
+                m_buffer.erase(previous, m_cursor - previous);
+                m_cursor = previous;
+            }
+        }
+        else if (key == K_KeyLeft || key == control('B'))
+        {
+            m_cursor = (m_cursor > 0) ? previous_boundary(m_buffer, m_cursor) : 0;
+        }
+        else if (key == K_KeyRight || key == control('F'))
+        {
+            m_cursor = (m_cursor < m_buffer.size()) ? next_boundary(m_buffer, m_cursor) : m_cursor;
+        }
+        else if (key == K_KeyHome || key == control('A'))
+        {
+            m_cursor = 0;
+        }
+        else if (key == K_KeyEnd || key == control('E'))
+        {
+            m_cursor = m_buffer.size();
+        }
+        else if (key == K_KeyWordLeft || key == K_KeyWordRight)
+        {
+            moveWord(key == K_KeyWordRight);
+        }
+        else if (key == control('K'))
+        {
+            m_buffer.erase(m_cursor);
+        }
+        else if (key == control('U'))
+        {
+            m_buffer.erase(0, m_cursor);
+            m_cursor = 0;
+        }
+        else if (key == control('W'))
+        {
+            deletePreviousWord();
+        }
+        else if (key == K_KeyUp || key == control('P'))
+        {
+            if (m_historyIndex > 0)
+            {
+                if (m_historyIndex == m_history.size())
+                {
+                    m_draft = m_buffer;
+                }
+                showHistoryEntry(m_historyIndex - 1);
+            }
+        }
+        else if (key == K_KeyDown || key == control('N'))
+        {
+            if (m_historyIndex < m_history.size())
+            {
+                showHistoryEntry(m_historyIndex + 1);
+            }
+        }
+        else if (key == control('R'))
+        {
+            pending_key = reverseSearch();
+        }
+        else if (key == control('L'))
+        {
+            writeOutput("\x1b[H\x1b[2J");
+        }
+        else if (key >= 0x20 && key < 256 && key != 127)
+        {
+            // Take the rest of a UTF-8 sequence, and whatever else is already buffered (a paste),
+            // so the line is redrawn once
+            std::string text(1, static_cast<char>(key));
+            char byte;
+            while (m_inputPosition < m_input.size() &&
+                   static_cast<unsigned char>(m_input[m_inputPosition]) >= 0x20 && m_input[m_inputPosition] != 127)
+            {
+                readByte(byte, 0);
+                text += byte;
+            }
+            for (size_t missing = missing_continuation_bytes(text); missing > 0 && readByte(byte, K_EscapeTimeoutMs); --missing)
+            {
+                text += byte;
+            }
+            insertText(text);
+        }
+        refresh();
+    }
+}
+
+int LineEditor::readKey()
+{
+    char byte;
+    if (!readByte(byte, -1))
+    {
+        return K_KeyEndOfInput;
+    }
+    if (byte != '\x1b')
+    {
+        return static_cast<unsigned char>(byte);
+    }
+    char next;
+    if (!readByte(next, K_EscapeTimeoutMs))
+    {
+        return K_KeyEscape;
+    }
+    if (next == 'b' || next == 'B')
+    {
+        return K_KeyWordLeft;
+    }
+    if (next == 'f' || next == 'F')
+    {
+        return K_KeyWordRight;
+    }
+    if (next != '[' && next != 'O')
+    {
+        return K_KeyNone;
+    }
+
+    // CSI / SS3: parameters, then a final byte (`ESC [ 3 ~`, `ESC [ 1 ; 5 C`, `ESC O H`)
+    std::string parameters;
+    char final_byte;
+    while (true)
+    {
+        if (!readByte(final_byte, K_EscapeTimeoutMs))
+        {
+            return K_KeyEscape;
+        }
+        if (final_byte >= 0x40 && final_byte <= 0x7e)
+        {
+            break;
+        }
+        parameters += final_byte;
+    }
+    bool control_modifier = parameters.size() > 2 && parameters.compare(parameters.size() - 2, 2, ";5") == 0;
+    switch (final_byte)
+    {
+        case 'A': return K_KeyUp;
+        case 'B': return K_KeyDown;
+        case 'C': return control_modifier ? K_KeyWordRight : K_KeyRight;
+        case 'D': return control_modifier ? K_KeyWordLeft : K_KeyLeft;
+        case 'H': return K_KeyHome;
+        case 'F': return K_KeyEnd;
+        case '~':
+        {
+            int number = std::atoi(parameters.c_str());
+            if (number == 1 || number == 7)
+            {
+                return K_KeyHome;
+            }
+            if (number == 4 || number == 8)
+            {
+                return K_KeyEnd;
+            }
+            return number == 3 ? K_KeyDelete : K_KeyNone;
+        }
+        default: return K_KeyNone;
+    }
+}
+
+// Serves bytes from m_input, refilling it with one read(). A negative timeout waits forever.
+bool LineEditor::readByte(char& byte, int timeout_ms)
+{
+    if (m_inputPosition >= m_input.size())
+    {
+        if (timeout_ms >= 0)
+        {
+            struct pollfd input = {STDIN_FILENO, POLLIN, 0};
+            if (poll(&input, 1, timeout_ms) <= 0)
+            {
+                return false;
+            }
+        }
+        char chunk[4096];
+        ssize_t count;
+        do
+        {
+            count = ::read(STDIN_FILENO, chunk, sizeof(chunk));
+        } while (count < 0 && errno == EINTR);
+        if (count <= 0)
+        {
+            return false;
+        }
+        m_input.assign(chunk, static_cast<size_t>(count));
+        m_inputPosition = 0;
+    }
+    byte = m_input[m_inputPosition++];
+    return true;
+}
+
+// Redraws the prompt and the part of the line around the cursor that fits the terminal.
+void LineEditor::refresh(const std::string& prompt, size_t prompt_width)
+{
+    size_t columns = terminal_columns();
+    size_t available = (columns > prompt_width + 1) ? columns - prompt_width - 1 : 1;
+
+    size_t start = 0;
+    size_t cursor_width = text_width(m_buffer, 0, m_cursor);
+    while (cursor_width > available)
+    {
+        size_t length;
+        cursor_width -= code_point_width(decode_at(m_buffer, start, length));
+        start += length;
+    }
+    size_t end = start;
+    size_t width = 0;
+    while (end < m_buffer.size())
+    {
+        size_t length;
+        size_t character_width = code_point_width(decode_at(m_buffer, end, length));
+        if (width + character_width > available)
+        {
+            break;
+        }
+        width += character_width;
+        end += length;
+    }
+
+    std::string output = "\r" + prompt;
+    append_display(output, m_buffer, start, end);
+    output += "\x1b[0K\r";
+    size_t cursor_column = prompt_width + cursor_width;
+    if (cursor_column > 0)
+    {
+        output += "\x1b[" + std::to_string(cursor_column) + "C";
+    }
+    writeOutput(output);
+}
+
+void LineEditor::refresh()
+{
+    refresh(m_prompt, m_promptWidth);
+}
+
+void LineEditor::writeOutput(const std::string& text)
+{
+    const char* data = text.data();
+    size_t size = text.size();
+    while (size > 0)
+    {
+        ssize_t written = ::write(STDOUT_FILENO, data, size);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+}
+
+void LineEditor::insertText(const std::string& text)
+{
+    m_buffer.insert(m_cursor, text);
+    m_cursor += text.size();
+}
+
+void LineEditor::moveWord(bool forward)
+{
+    if (forward)
+    {
+        while (m_cursor < m_buffer.size() && !is_word_byte(m_buffer[m_cursor]))
+        {
+            ++m_cursor;
+        }
+        while (m_cursor < m_buffer.size() && is_word_byte(m_buffer[m_cursor]))
+        {
+            ++m_cursor;
+        }
+    }
+    else
+    {
+        while (m_cursor > 0 && !is_word_byte(m_buffer[m_cursor - 1]))
+        {
+            --m_cursor;
+        }
+        while (m_cursor > 0 && is_word_byte(m_buffer[m_cursor - 1]))
+        {
+            --m_cursor;
+        }
+    }
+}
+
+// Ctrl-W: back to the previous blank, like a terminal's werase.
+void LineEditor::deletePreviousWord()
+{
+    size_t start = m_cursor;
+    while (start > 0 && is_blank(m_buffer[start - 1]))
+    {
+        --start;
+    }
+    while (start > 0 && !is_blank(m_buffer[start - 1]))
+    {
+        --start;
+    }
+    m_buffer.erase(start, m_cursor - start);
+    m_cursor = start;
+}
+
+void LineEditor::showHistoryEntry(size_t index)
+{
+    m_historyIndex = index;
+    m_buffer = (index == m_history.size()) ? m_draft : m_history.at(index);
+    m_cursor = m_buffer.size();
+}
+
+// Ctrl-R. Each key is one HistoryStore::searchBackward() step, which the trigram index
+// answers without scanning the history. Returns the key that ended the search, for the
+// caller to handle (Enter runs the match), or K_KeyNone.
+int LineEditor::reverseSearch()
+{
+    std::string original = m_buffer;
+    size_t original_cursor = m_cursor;
+    std::string pattern;
+    size_t match = m_history.size();
+    bool failed = false;
+    while (true)
+    {
+        std::string label = std::string(failed ? "(failed reverse-i-search)`" : "(reverse-i-search)`") + pattern + "': ";
+        refresh(label, text_width(label, 0, label.size()));
+        int key = readKey();
+
+        size_t before;
+        if (key == control('R'))
+        {
+            before = match; // The next older match
+        }
+        else if (key == 127 || key == control('H'))
+        {
+            if (!pattern.empty())
+            {
+                pattern.erase(previous_boundary(pattern, pattern.size()));
+            }
+            before = m_history.size();
+        }
+        else if (key >= 0x20 && key < 256)
+        {
+            pattern += static_cast<char>(key);
+            before = (match < m_history.size()) ? match + 1 : match; // The current match may still do
+        }
+        else if (key == control('G') || key == control('C'))
+        {
+            m_buffer = original;
+            m_cursor = original_cursor;
+            return K_KeyNone;
+        }
+        else
+        {
+            if (match < m_history.size())
+            {
+                m_historyIndex = match;
+            }
+            return key;
+        }
+
+        size_t found;
+        failed = !pattern.empty() && !m_history.searchBackward(pattern, before, found);
+        if (!pattern.empty() && !failed)
+        {
+            match = found;
+            m_buffer = m_history.at(found);
+            m_cursor = m_buffer.find(pattern);
+        }
+    }
+}
+
+void LineEditor::complete()
+{
+    // The word before the cursor starts after the last blank or operator outside quotes
+    size_t word_start = 0;
+    std::string word;
+    char quote = 0;
+    for (size_t i = 0; i < m_cursor; ++i)
+    {
+        char c = m_buffer[i];
+        if (c == '\\' && quote != '\'' && i + 1 < m_cursor)
+        {
+            word += m_buffer[++i];
+        }
+        else if (quote != 0 ? c == quote : (c == '"' || c == '\''))
+        {
+            quote = (quote != 0) ? 0 : c;
+        }
+        else if (quote == 0 && (is_blank(c) || std::strchr(";|&()<>", c)))
+        {
+            word_start = i + 1;
+            word.clear();
+        }
+        else
+        {
+            word += c;
+        }
+    }
+    std::vector<std::string> candidates;
+    bool is_variable = !word.empty() && word[0] == '$';
+    size_t hidden_prefix = 0; // Not shown when candidates are listed
+    if (is_variable)
+    {
+        bool braced = starts_with(word, "${");
+        std::string prefix = word.substr(braced ? 2 : 1);
+        std::vector<std::string> names;
+        Environment::VariableSnapshot snapshot = m_environment.takeSnapshot();
+        for (const auto& variable : *snapshot.variables)
+        {
+            names.push_back(variable.first);
+        }
+        for (const auto& array : *snapshot.arrays)
+        {
+            names.push_back(array.first);
+        }
+        for (char** entry = environ; *entry; ++entry)
+        {
+            const char* equals = std::strchr(*entry, '=');
+            names.emplace_back(*entry, equals ? static_cast<size_t>(equals - *entry) : std::strlen(*entry));
+        }
+        for (const std::string& name : names)
+        {
+            if (starts_with(name, prefix))
+            {
+                candidates.push_back(braced ? "${" + name + "}" : "$" + name);
+            }
+        }
+    }
+    else if (isCommandPosition(word_start) && word.find('/') == std::string::npos)
+    {
+        for (const std::string& name : Builtins::getBuiltinNames())
+        {
+            if (starts_with(name, word))
+            {
+                candidates.push_back(name);
+            }
+        }
+        m_commands.snapshot()->complete(word, candidates);
+    }
+    else
+    {
+        size_t slash = word.rfind('/');
+        std::string directory_part = (slash == std::string::npos) ? "" : word.substr(0, slash + 1);
+        std::string name_prefix = word.substr(directory_part.size());
+        std::string directory = directory_part.empty() ? "." : directory_part;
+        const char* home = std::getenv("HOME");
+        if (starts_with(directory_part, "~/") && home)
+        {
+            directory = home + directory_part.substr(1);
+        }
+        hidden_prefix = directory_part.size();
+        std::shared_ptr<const DirectoryCache::EntryList> entries = DirectoryCache::instance().getEntries(directory);
+        for (size_t i = 0; entries && i < entries->size(); ++i)
+        {
+            const DirectoryEntry& entry = (*entries)[i];
+            if (!starts_with(entry.name, name_prefix) || (entry.name[0] == '.' && name_prefix.empty()))
+            {
+                continue;
+            }
+            bool is_directory = entry.type == DT_DIR;
+            if (entry.type == DT_LNK || entry.type == DT_UNKNOWN)
+            {
+                struct stat entry_stat;
+                is_directory = stat((directory + "/" + entry.name).c_str(), &entry_stat) == 0 && S_ISDIR(entry_stat.st_mode);
+            }
+            candidates.push_back(directory_part + entry.name + (is_directory ? "/" : ""));
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+    if (candidates.empty())
+    {
+        writeOutput("\a");
+        return;
+    }
+
+    std::string completion = candidates.front();
+    for (const std::string& candidate : candidates)
+    {
+        size_t length = 0;
+        while (length < completion.size() && length < candidate.size() && completion[length] == candidate[length])
+        {
+            ++length;
+        }
+        completion.resize(length);
+    }
+    if (missing_continuation_bytes(completion) > 0)
+    {
+        completion.erase(previous_boundary(completion, completion.size())); // Never stop inside a character
+    }
+    if (candidates.size() == 1 || completion.size() > word.size())
+    {
+        bool finished = candidates.size() == 1 && completion.back() != '/';
+        std::string text = is_variable ? completion : quote_word(completion, candidates.size() == 1);
+        if (finished && !is_variable)
+        {
+            text += ' ';
+        }
+        m_buffer.replace(word_start, m_cursor - word_start, text);
+        m_cursor = word_start + text.size();
+        m_listOnTab = candidates.size() > 1; // The next Tab lists what is left
+        return;
+    }
+    if (m_listOnTab)
+    {
+        listCandidates(candidates, hidden_prefix);
+        return;
+    }
+    writeOutput("\a");
+    m_listOnTab = true;
+}
+
+bool LineEditor::isCommandPosition(size_t word_start) const
+{
+    size_t end = word_start;
+    while (end > 0 && is_blank(m_buffer[end - 1]))
+    {
+        --end;
+    }
+    if (end == 0 || std::strchr(";|&(", m_buffer[end - 1]))
+    {
+        return true;
+    }
+    // After a keyword that itself starts a command: `if make`, `then ./run`, `! grep`
+    size_t start = end;
+    while (start > 0 && !is_blank(m_buffer[start - 1]) && !std::strchr(";|&()<>", m_buffer[start - 1]))
+    {
+        --start;
+    }
+    static const char* const K_CommandKeywords[] = {"if", "then", "else", "elif", "while", "do", "!"};
+    std::string previous = m_buffer.substr(start, end - start);
+    for (const char* keyword : K_CommandKeywords)
+    {
+        if (previous == keyword)
+        {
+            return isCommandPosition(start);
+        }
+    }
+    return false;
+}
+
+// Prints the candidates below the line in columns, sorted down each column like `ls`.
+void LineEditor::listCandidates(const std::vector<std::string>& candidates, size_t hidden_prefix)
+{
+    if (candidates.size() > K_MaxListedWithoutAsking)
+    {
+        writeOutput("\nDisplay all " + std::to_string(candidates.size()) + " possibilities? (y or n)");
+        int key = readKey();
+        if (key != 'y' && key != 'Y')
+        {
+            writeOutput("\n");
+            return;
+        }
+    }
+    size_t width = 0;
+    for (const std::string& candidate : candidates)
+    {
+        width = std::max(width, text_width(candidate, hidden_prefix, candidate.size()));
+    }
+    width += 2;
+    size_t per_row = std::max<size_t>(1, terminal_columns() / width);
+    size_t rows = (candidates.size() + per_row - 1) / per_row;
+    std::string output = "\n";
+    for (size_t row = 0; row < rows; ++row)
+    {
+        for (size_t column = 0; column < per_row; ++column)
+        {
+            size_t index = column * rows + row;
+            if (index >= candidates.size())
+            {
+                break;
+            }
+            const std::string& candidate = candidates[index];
+            output.append(candidate, hidden_prefix, std::string::npos);
+            if (column + 1 < per_row && index + rows < candidates.size())
+            {
+                output.append(width - text_width(candidate, hidden_prefix, candidate.size()), ' ');
+            }
+        }
+        output += "\n";
+    }
+    writeOutput(output);
+}
+
+}
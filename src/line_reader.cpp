@@ -0,0 +1,83 @@
+#include "../include/line_reader.hpp"
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+namespace g1_tinyshell
+{
+
+LineReader::LineReader(int fd, size_t buffer_size)
+    : m_fd(fd), m_buffer(buffer_size), m_begin(0), m_end(0), m_atEof(false), m_hasError(false)
+{
+}
+
+bool LineReader::nextLine(std::string& line)
+{
+    size_t search_from = m_begin;
+    while (true)
+    {
+        const char* newline = static_cast<const char*>(
+            std::memchr(m_buffer.data() + search_from, '\n', m_end - search_from));
+        if (newline)
+        {
+            size_t newline_pos = newline - m_buffer.data();
+            line.assign(m_buffer.data() + m_begin, newline_pos - m_begin);
+            m_begin = newline_pos + 1;
+            return true;
+        }
+        size_t scanned = m_end - m_begin; // Bytes already known to hold no '\n'
+        if (!fillBuffer())
+        {
+            if (m_begin == m_end)
+            {
+                return false;
+            }
+            line.assign(m_buffer.data() + m_begin, m_end - m_begin);
+            m_begin = m_end;
+            return true;
+        }
+        search_from = m_begin + scanned;
+    }
+}
+
+bool LineReader::hasError() const
+{
+    return m_hasError;
+}
+
+bool LineReader::fillBuffer()
+{
+    if (m_atEof)
+    {
+        return false;
+    }
+    if (m_begin > 0)
+    {
+        std::memmove(m_buffer.data(), m_buffer.data() + m_begin, m_end - m_begin);
+        m_end -= m_begin;
+        m_begin = 0;
+    }
+    if (m_end == m_buffer.size())
+    {
+        m_buffer.resize(m_buffer.size() * 2); // A single line longer than the buffer
+    }
+
+    while (true)
+    {
+        ssize_t bytes_read = read(m_fd, m_buffer.data() + m_end, m_buffer.size() - m_end);
+        if (bytes_read > 0)
+        {
+            m_end += bytes_read;
+            return true;
+        }
+        if (bytes_read < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        m_hasError = bytes_read < 0;
+        m_atEof = true;
+        return false;
+    }
+}
+
+}
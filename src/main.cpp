@@ -1,4 +1,5 @@
 #include "../include/shell_core.hpp"
+#include "../include/output_sink.hpp"
 #include <iostream>
 
 int main(int argc, char* argv[])
@@ -10,6 +11,10 @@ int main(int argc, char* argv[])
     // Set locale for potential wide character support if needed later
     // std::setlocale(LC_ALL, "");
 
+    // Builtins write through OutputSink and every spawn flushes first, so the iostreams do
+    // not need to stay synchronized with C stdio.
+    std::ios::sync_with_stdio(false);
+
     // Create the main shell core object
     g1_tinyshell::ShellCore tinyshell_core;
 
@@ -20,6 +25,7 @@ int main(int argc, char* argv[])
     }
     catch (const std::exception& e)
     {
+        g1_tinyshell::OutputSink::flushAll();
         std::cerr << "Tinyshell: Unhandled exception: " << e.what() << std::endl;
         return 1; // Return error code on unhandled exception
     }
@@ -0,0 +1,123 @@
+#include "../include/output_sink.hpp"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <unistd.h>
+
+namespace g1_tinyshell
+{
+
+namespace
+{
+std::map<int, std::unique_ptr<OutputSink>>& sink_registry()
+{
+    static std::map<int, std::unique_ptr<OutputSink>> sinks;
+    return sinks;
+}
+}
+
+OutputSink& OutputSink::forDescriptor(int fd)
+{
+    std::unique_ptr<OutputSink>& sink = sink_registry()[fd];
+    if (!sink)
+    {
+        sink = std::make_unique<OutputSink>(fd);
+    }
+    return *sink;
+}
+
+OutputSink& OutputSink::standardOutput()
+{
+    static OutputSink& sink = forDescriptor(STDOUT_FILENO);
+    return sink;
+}
+
+void OutputSink::flushAll()
+{
+    std::cout.flush();
+    std::cerr.flush();
+    for (auto& fd_sink : sink_registry())
+    {
+        fd_sink.second->flush();
+    }
+}
+
+OutputSink::OutputSink(int fd, size_t buffer_size)
+    : m_fd(fd), m_buffer(buffer_size), m_used(0), m_lineBuffered(isatty(fd) == 1)
+{
+}
+
+OutputSink::~OutputSink()
+{
+    flush();
+}
+
+void OutputSink::write(const char* data, size_t size)
+{
+    if (size > m_buffer.size() - m_used)
+    {
+        flush();
+        if (size >= m_buffer.size())
+        {
+            writeAll(data, size); // Large blocks (file contents) skip the copy
+            return;
+        }
+    }
+    std::memcpy(m_buffer.data() + m_used, data, size);
+    m_used += size;
+    if (m_lineBuffered && std::memchr(data, '\n', size))
+    {
+        flush();
+    }
+}
+
+void OutputSink::put(char c)
+{
+    if (m_used == m_buffer.size())
+    {
+        flush();
+    }
+    m_buffer[m_used++] = c;
+    if (m_lineBuffered && c == '\n')
+    {
+        flush();
+    }
+}
+
+OutputSink& OutputSink::operator<<(const char* text)
+{
+    write(text, std::strlen(text));
+    return *this;
+}
+
+void OutputSink::flush()
+{
+    if (m_used > 0)
+    {
+        size_t pending = m_used;
+        m_used = 0;
+        writeAll(m_buffer.data(), pending);
+    }
+}
+
+void OutputSink::writeAll(const char* data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t written = ::write(m_fd, data, size);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return; // Reader gone or disk full: drop the output like a failed stdio stream
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+}
+
+}
@@ -1,4 +1,5 @@
 #include "../include/parser_ast.hpp"
+#include "../include/expansion.hpp" // findParameterEnd
 #include <stdexcept> // For potential errors, though we use setError
 #include <algorithm> // Ensure this is included for std::remove_if
 #include <string>    // Ensure std::to_string is available
@@ -48,11 +49,9 @@ const std::string& Parser::getErrorMessage() const
 AstNodePtr Parser::parseCommandSequence()
 {
     auto sequence_node = std::make_shared<CommandSequenceNode>();
-    while (!isAtEnd() && currentToken().type != TokenType::EndOfInput &&
-           currentToken().type != TokenType::Fi && currentToken().type != TokenType::Else &&
-           currentToken().type != TokenType::Elif && currentToken().type != TokenType::Done)
+    while (!isSequenceEnd())
     {
-        AstNodePtr command = parseCommand();
+        AstNodePtr command = parseAndOrList();
         if (!command)
         {
             // Error occurred during command parsing
@@ -65,16 +64,12 @@ AstNodePtr Parser::parseCommandSequence()
         {
             // Consume semicolon, continue if more commands in sequence
             advanceToken(); // Consume the semicolon
-            if (isAtEnd() || currentToken().type == TokenType::EndOfInput ||
-                currentToken().type == TokenType::Fi || currentToken().type == TokenType::Else ||
-                currentToken().type == TokenType::Elif || currentToken().type == TokenType::Done)
+            if (isSequenceEnd())
             {
                 break; // End of sequence/block after semicolon
             }
         }
-        else if (isAtEnd() || currentToken().type == TokenType::EndOfInput ||
-                 currentToken().type == TokenType::Fi || currentToken().type == TokenType::Else ||
-                 currentToken().type == TokenType::Elif || currentToken().type == TokenType::Done)
+        else if (isSequenceEnd())
         {
             break; // Natural end of sequence/block
         }
@@ -90,11 +85,54 @@ AstNodePtr Parser::parseCommandSequence()
     return sequence_node;
 }
 
-// Parses a single command unit (Simple, If, While, For)
+// Parses lists like: cmd1 && cmd2 || cmd3
+AstNodePtr Parser::parseAndOrList()
+{
+    AstNodePtr first_command = parseCommand();
+    if (!first_command || !matchToken(TokenType::Operator))
+    {
+        return first_command; // Plain command: no list node needed
+    }
+
+    auto and_or_node = std::make_shared<AndOrListNode>();
+    and_or_node->commands.push_back(first_command);
+    while (matchToken(TokenType::Operator))
+    {
+        std::string op_value = currentToken().value;
+        and_or_node->operators.push_back(op_value == "&&" ? AndOrOperator::And : AndOrOperator::Or);
+        advanceToken(); // Consume '&&' / '||'
+
+        if (isSequenceEnd() || matchToken(TokenType::Semicolon))
+        {
+            setError("Expected command after '" + op_value + "'");
+            return nullptr;
+        }
+        AstNodePtr command = parseCommand();
+        if (!command) return nullptr;
+        and_or_node->commands.push_back(command);
+    }
+    return and_or_node;
+}
+
+// Parses a single command unit (Simple, If, While, For, Subshell), optionally negated with '!'
 AstNodePtr Parser::parseCommand()
 {
     if (isAtEnd()) return nullptr;
 
+    if (currentToken().type == TokenType::Word && currentToken().value == "!")
+    {
+        advanceToken(); // Consume '!'
+        if (isSequenceEnd() || matchToken(TokenType::Semicolon) || matchToken(TokenType::Operator))
+        {
+            setError("Expected command after '!'");
+            return nullptr;
+        }
+        auto not_node = std::make_shared<NotNode>();
+        not_node->command = parseCommand();
+        if (!not_node->command) return nullptr;
+        return not_node;
+    }
+
     switch (currentToken().type)
     {
         case TokenType::If:
@@ -103,6 +141,10 @@ AstNodePtr Parser::parseCommand()
             return parseWhileCommand();
         case TokenType::For:
             return parseForCommand();
+        case TokenType::LeftParen:
+            return parseSubshellCommand();
+        case TokenType::Case:
+            return parseCaseCommand();
         case TokenType::Word:
         case TokenType::Variable: // Variables might start a command name after expansion
             // Assume it's a simple command if it starts with a word or variable
@@ -127,20 +169,62 @@ AstNodePtr Parser::parseSimpleCommand()
     advanceToken();
 
     // Collect arguments until a semicolon, EOI, or control flow keyword
-    while (!isAtEnd() && currentToken().type != TokenType::EndOfInput &&
-           currentToken().type != TokenType::Semicolon &&
-           currentToken().type != TokenType::Fi && currentToken().type != TokenType::Else &&
-           currentToken().type != TokenType::Elif && currentToken().type != TokenType::Done &&
+    while (!isSequenceEnd() && currentToken().type != TokenType::Semicolon &&
+           currentToken().type != TokenType::Operator &&
            currentToken().type != TokenType::Then && // Should be handled by control flow parsers
            currentToken().type != TokenType::Do)
     {
         // For now, treat all subsequent words/variables as arguments
         // Redirection/piping would need more complex handling here
-        if (currentToken().type == TokenType::Word || currentToken().type == TokenType::Variable)
+        // Keywords that cannot end the command ('in', 'if', ...) are plain words in argument position.
+        TokenType arg_type = currentToken().type;
+        if (arg_type == TokenType::Word || arg_type == TokenType::Variable || arg_type == TokenType::In ||
+            arg_type == TokenType::If || arg_type == TokenType::While || arg_type == TokenType::For ||
+            arg_type == TokenType::Case)
         {
+            // `setvar [-a] NAME[i]=value` is an assignment, not a pattern
+            bool is_assignment = command_node->command == "setvar" &&
+                                 (command_node->arguments.empty() ||
+                                  (command_node->arguments.size() == 1 && command_node->arguments[0] == "-a"));
             command_node->arguments.push_back(currentToken().value);
+            command_node->glob_arguments.push_back(!currentToken().quoted && !is_assignment);
             advanceToken();
         }
+        else if (arg_type == TokenType::LeftParen && !command_node->arguments.empty() &&
+                 !command_node->arguments.back().empty() && command_node->arguments.back().back() == '=')
+        {
+            // Array literal `name=( words... )`: the builtin receives "name=(", the words and ")"
+            command_node->arguments.back() += '(';
+            advanceToken();
+            while (!isAtEnd() && currentToken().type != TokenType::RightParen)
+            {
+                TokenType element_type = currentToken().type;
+                if (element_type != TokenType::Word && element_type != TokenType::Variable)
+                {
+                    setError("Unexpected token in array literal: " + currentToken().value);
+                    return nullptr;
+                }
+                command_node->arguments.push_back(currentToken().value);
+                command_node->glob_arguments.push_back(!currentToken().quoted);
+                advanceToken();
+            }
+            if (!expectToken(TokenType::RightParen, "array literal")) return nullptr;
+            command_node->arguments.push_back(")");
+            command_node->glob_arguments.push_back(false);
+            advanceToken();
+        }
+        else if (arg_type == TokenType::RedirectIn)
+        {
+            // No input redirection for simple commands yet; external commands still see the '<'
+            command_node->arguments.push_back(currentToken().value);
+            command_node->glob_arguments.push_back(false);
+            advanceToken();
+        }
+        else if (arg_type == TokenType::CommandSubstitution)
+        {
+            setError("Command substitution $(...) is only supported as the list of a 'for' loop");
+            return nullptr;
+        }
         else
         {
             // Unexpected token within a simple command
@@ -219,6 +303,18 @@ AstNodePtr Parser::parseWhileCommand()
     if (!expectToken(TokenType::Done, "while body")) return nullptr;
     advanceToken(); // Consume 'done'
 
+    if (matchToken(TokenType::RedirectIn))
+    {
+        advanceToken(); // Consume '<'
+        if (currentToken().type != TokenType::Word && currentToken().type != TokenType::Variable)
+        {
+            setError("Expected file name after 'done <', found: " + currentToken().value);
+            return nullptr;
+        }
+        while_node->input_file = currentToken().value;
+        advanceToken();
+    }
+
     return while_node;
 }
 
@@ -236,12 +332,51 @@ AstNodePtr Parser::parseForCommand()
     if (!expectToken(TokenType::In, "for variable")) return nullptr;
     advanceToken(); // Consume 'in'
 
+    if (matchToken(TokenType::RedirectIn))
+    {
+        // `for v in <file`: one iteration per line of the file
+        advanceToken();
+        if (currentToken().type != TokenType::Word && currentToken().type != TokenType::Variable)
+        {
+            setError("Expected file name after '<' in 'for' list, found: " + currentToken().value);
+            return nullptr;
+        }
+        for_node->line_file = currentToken().value;
+        advanceToken();
+    }
+    else if (matchToken(TokenType::CommandSubstitution))
+    {
+        // `for v in $(command)`: one iteration per line of the command's output
+        Lexer command_lexer(currentToken().value);
+        std::vector<Token> command_tokens = command_lexer.tokenize();
+        if (!command_tokens.empty() && command_tokens.back().type == TokenType::Error)
+        {
+            setError("In command substitution: " + command_tokens.back().value);
+            return nullptr;
+        }
+        Parser command_parser(command_tokens);
+        for_node->line_command = command_parser.parse();
+        if (!for_node->line_command)
+        {
+            setError("In command substitution: " + command_parser.getErrorMessage());
+            return nullptr;
+        }
+        advanceToken();
+    }
+
     // Collect words for the list until 'do' or ';'
     while (!isAtEnd() && currentToken().type != TokenType::Do && currentToken().type != TokenType::Semicolon)
     {
+        if (!for_node->line_file.empty() || for_node->line_command)
+        {
+            setError("A '<file' or '$(command)' list must be the only item of a 'for' list, found: " +
+                     currentToken().value);
+            return nullptr;
+        }
         if (currentToken().type == TokenType::Word || currentToken().type == TokenType::Variable)
         {
             for_node->word_list.push_back(currentToken().value);
+            for_node->glob_words.push_back(!currentToken().quoted);
             advanceToken();
         }
         else
@@ -270,6 +405,127 @@ AstNodePtr Parser::parseForCommand()
     return for_node;
 }
 
+AstNodePtr Parser::parseSubshellCommand()
+{
+    auto subshell_node = std::make_shared<SubshellNode>();
+    if (!expectToken(TokenType::LeftParen, "subshell")) return nullptr;
+    advanceToken(); // Consume '('
+
+    subshell_node->body = parseCommandSequence();
+    if (!subshell_node->body) return nullptr;
+
+    if (!expectToken(TokenType::RightParen, "subshell body")) return nullptr;
+    advanceToken(); // Consume ')'
+
+    return subshell_node;
+}
+
+// Parses: case WORD in [(]pat[|pat]...) commands ;; ... esac
+AstNodePtr Parser::parseCaseCommand()
+{
+    auto case_node = std::make_shared<CaseNode>();
+    if (!expectToken(TokenType::Case, "case statement")) return nullptr;
+    advanceToken(); // Consume 'case'
+
+    if (!matchToken(TokenType::Word) && !matchToken(TokenType::Variable))
+    {
+        setError("Expected word after 'case', found: " + currentToken().value);
+        return nullptr;
+    }
+    case_node->word = currentToken().value;
+    advanceToken(); // Consume word
+
+    if (!expectToken(TokenType::In, "case word")) return nullptr;
+    advanceToken(); // Consume 'in'
+
+    while (!isAtEnd() && !matchToken(TokenType::Esac))
+    {
+        CaseClause clause;
+        if (matchToken(TokenType::LeftParen))
+        {
+            advanceToken(); // Optional '(' before the pattern list
+        }
+
+        // Patterns are words separated by '|' (a lone '|' stays inside the word token).
+        // A quoted pattern is one literal; the lexer escaped the quoted parts of mixed words.
+        while (!isAtEnd() && !matchToken(TokenType::RightParen))
+        {
+            if (!matchToken(TokenType::Word) && !matchToken(TokenType::Variable))
+            {
+                setError("Expected pattern in case clause, found: " + currentToken().value);
+                return nullptr;
+            }
+            if (currentToken().quoted)
+            {
+                bool escaped = false;
+                clause.patterns.push_back(GlobPattern::escape(currentToken().value, escaped));
+                advanceToken();
+                continue;
+            }
+            const std::string& pattern_word = currentToken().value;
+            size_t start_pos = 0;
+            for (size_t i = 0; i <= pattern_word.length(); ++i)
+            {
+                if (i < pattern_word.length() && pattern_word[i] == '\\')
+                {
+                    ++i; // `\|` is a literal bar
+                }
+                else if (i < pattern_word.length() && pattern_word[i] == '$' && i + 1 < pattern_word.length() &&
+                         pattern_word[i + 1] == '{')
+                {
+                    size_t close_pos = Expansion::findParameterEnd(pattern_word, i + 1);
+                    i = (close_pos == std::string::npos) ? pattern_word.length() - 1 : close_pos;
+                }
+                else if (i == pattern_word.length() || pattern_word[i] == '|')
+                {
+                    if (i > start_pos)
+                    {
+                        clause.patterns.push_back(pattern_word.substr(start_pos, i - start_pos));
+                    }
+                    start_pos = i + 1;
+                }
+            }
+            advanceToken();
+        }
+        if (clause.patterns.empty())
+        {
+            setError("Expected pattern in case clause, found: " + currentToken().value);
+            return nullptr;
+        }
+        if (!expectToken(TokenType::RightParen, "case pattern")) return nullptr;
+        advanceToken(); // Consume ')'
+
+        clause.body = parseCommandSequence();
+        if (!clause.body) return nullptr;
+
+        size_t clause_index = case_node->clauses.size();
+        for (const std::string& pattern : clause.patterns)
+        {
+            if (pattern.find('$') != std::string::npos)
+            {
+                case_node->has_dynamic_patterns = true;
+            }
+            case_node->dispatcher.addPattern(pattern, clause_index);
+        }
+        case_node->clauses.push_back(std::move(clause));
+
+        if (matchToken(TokenType::DoubleSemicolon))
+        {
+            advanceToken(); // Consume ';;'
+        }
+        else if (!matchToken(TokenType::Esac))
+        {
+            setError("Expected ';;' or 'esac' after case clause, found: " + currentToken().value);
+            return nullptr;
+        }
+    }
+
+    if (!expectToken(TokenType::Esac, "case statement")) return nullptr;
+    advanceToken(); // Consume 'esac'
+
+    return case_node;
+}
+
 // --- Token manipulation helpers ---
 
 const Token& Parser::currentToken() const
@@ -326,6 +582,10 @@ bool Parser::expectToken(TokenType type, const std::string& error_context)
             case TokenType::For: expected_type_str = "'for'"; break;
             case TokenType::In: expected_type_str = "'in'"; break;
             case TokenType::Semicolon: expected_type_str = "';'"; break; // Corrected string literal
+            case TokenType::LeftParen: expected_type_str = "'('"; break;
+            case TokenType::RightParen: expected_type_str = "')'"; break;
+            case TokenType::Case: expected_type_str = "'case'"; break;
+            case TokenType::Esac: expected_type_str = "'esac'"; break;
             default: expected_type_str = "specific token";
         }
         // Ensure std::to_string is available and used correctly
@@ -343,6 +603,29 @@ bool Parser::isAtEnd() const
     return m_currentTokenIndex >= m_tokens.size() || m_tokens[m_currentTokenIndex].type == TokenType::EndOfInput;
 }
 
+bool Parser::isSequenceEnd() const
+{
+    if (isAtEnd())
+    {
+        return true;
+    }
+    switch (currentToken().type)
+    {
+        case TokenType::Then:
+        case TokenType::Fi:
+        case TokenType::Else:
+        case TokenType::Elif:
+        case TokenType::Do:
+        case TokenType::Done:
+        case TokenType::RightParen:
+        case TokenType::DoubleSemicolon:
+        case TokenType::Esac:
+            return true;
+        default:
+            return false;
+    }
+}
+
 void Parser::setError(const std::string& message)
 {
     if (m_errorMessage.empty()) // Only record the first error
@@ -0,0 +1,375 @@
+#include "../include/printf_format.hpp"
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+namespace g1_tinyshell
+{
+
+namespace
+{
+constexpr size_t K_MaxCachedFormats = 256;
+
+// Decodes the escape starting at text[i] (a backslash) into `output` and moves i past it.
+// In %b arguments octal escapes are written \0NNN. Returns false for `\c` (stop all output).
+bool append_escape(const std::string& text, size_t& i, std::string& output, bool in_argument)
+{
+    char c = (i + 1 < text.length()) ? text[i + 1] : '\0';
+    i += 2;
+    switch (c)
+    {
+        case 'a': output += '\a'; return true;
+        case 'b': output += '\b'; return true;
+        case 'f': output += '\f'; return true;
+        case 'n': output += '\n'; return true;
+        case 'r': output += '\r'; return true;
+        case 't': output += '\t'; return true;
+        case 'v': output += '\v'; return true;
+        case '\\': output += '\\'; return true;
+        case '"': output += '"'; return true;
+        case '\'': output += '\''; return true;
+        case 'c':
+            return false;
+        case 'x':
+        {
+            int value = 0;
+            size_t digits = 0;
+            while (digits < 2 && i < text.length() && std::isxdigit(static_cast<unsigned char>(text[i])))
+            {
+                value = value * 16 + (std::isdigit(static_cast<unsigned char>(text[i])) ? text[i] - '0'
+                                                                                        : (text[i] | 0x20) - 'a' + 10);
+                ++i;
+                ++digits;
+            }
+            if (digits > 0)
+            {
+                output += static_cast<char>(value);
+                return true;
+            }
+            break;
+        }
+        default:
+            if (c >= '0' && c <= '7')
+            {
+                // \NNN in formats, \0NNN in %b arguments
+                size_t max_digits = (in_argument && c == '0') ? 3 : 2;
+                int value = in_argument && c == '0' ? 0 : c - '0';
+                for (size_t digits = 0; digits < max_digits && i < text.length() && text[i] >= '0' && text[i] <= '7';
+                     ++digits)
+                {
+                    value = value * 8 + (text[i++] - '0');
+                }
+                output += static_cast<char>(value);
+                return true;
+            }
+            break;
+    }
+    if (c == '\0' && i > text.length())
+    {
+        output += '\\'; // Trailing backslash
+        i = text.length();
+        return true;
+    }
+    output += '\\';
+    output += c;
+    return true;
+}
+
+// Parses a numeric argument: decimal, 0x hex, 0 octal, or 'c / "c for a character code.
+template <typename Number, typename Parse>
+Number parse_number(const std::string& text, Parse parse, std::string& error_message)
+{
+    if (text.empty())
+    {
+        return 0;
+    }
+    if ((text[0] == '\'' || text[0] == '"') && text.length() > 1)
+    {
+        return static_cast<Number>(static_cast<unsigned char>(text[1]));
+    }
+    errno = 0;
+    char* end = nullptr;
+    Number value = parse(text.c_str(), &end);
+    if (end == text.c_str() || *end != '\0')
+    {
+        error_message = "printf: " + text + ": invalid number";
+    }
+    else if (errno == ERANGE)
+    {
+        error_message = "printf: " + text + ": Numerical result out of range";
+    }
+    return value;
+}
+
+// snprintf into `output` with the optional `*` width and precision in front of the value.
+template <typename Value>
+void append_formatted(std::string& output, const char* spec, const std::vector<int>& star_values, Value value)
+{
+    char buffer[256];
+    int length = 0;
+    auto print = [&](char* destination, size_t size)
+    {
+        switch (star_values.size())
+        {
+            case 0: return std::snprintf(destination, size, spec, value);
+            case 1: return std::snprintf(destination, size, spec, star_values[0], value);
+            default: return std::snprintf(destination, size, spec, star_values[0], star_values[1], value);
+        }
+    };
+    length = print(buffer, sizeof(buffer));
+    if (length < 0)
+    {
+        return;
+    }
+    if (static_cast<size_t>(length) < sizeof(buffer))
+    {
+        output.append(buffer, length);
+        return;
+    }
+    size_t old_size = output.size();
+    output.resize(old_size + length + 1);
+    print(&output[old_size], length + 1);
+    output.resize(old_size + length);
+}
+}
+
+std::shared_ptr<const PrintfFormat> PrintfFormat::get(const std::string& format)
+{
+    static std::mutex cache_mutex;
+    static std::unordered_map<std::string, std::shared_ptr<const PrintfFormat>> cache;
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    auto it = cache.find(format);
+    if (it != cache.end())
+    {
+        return it->second;
+    }
+    if (cache.size() >= K_MaxCachedFormats)
+    {
+        cache.clear(); // Formats built from changing data would otherwise grow it forever
+    }
+    auto compiled = std::make_shared<const PrintfFormat>(format);
+    cache.emplace(format, compiled);
+    return compiled;
+}
+
+PrintfFormat::PrintfFormat(const std::string& format)
+    : m_consumesArguments(false), m_stopsOutput(false)
+{
+    std::string literal;
+    auto flush_literal = [&]()
+    {
+        if (!literal.empty())
+        {
+            m_ops.push_back({OpType::Literal, std::move(literal)});
+            literal.clear();
+        }
+    };
+
+    for (size_t i = 0; i < format.length();)
+    {
+        if (format[i] == '\\')
+        {
+            if (!append_escape(format, i, literal, false))
+            {
+                m_stopsOutput = true; // Nothing after `\c` is ever printed
+                break;
+            }
+            continue;
+        }
+        if (format[i] != '%')
+        {
+            literal += format[i++];
+            continue;
+        }
+        if (i + 1 < format.length() && format[i + 1] == '%')
+        {
+            literal += '%';
+            i += 2;
+            continue;
+        }
+
+        // %[flags][width][.precision]conversion
+        Op op{OpType::Conversion, "%"};
+        size_t pos = i + 1;
+        while (pos < format.length() && std::strchr("-+ #0", format[pos]))
+        {
+            op.text += format[pos++];
+        }
+        if (pos < format.length() && format[pos] == '*')
+        {
+            op.width_from_arg = true;
+            op.text += format[pos++];
+        }
+        while (pos < format.length() && std::isdigit(static_cast<unsigned char>(format[pos])))
+        {
+            op.text += format[pos++];
+        }
+        if (pos < format.length() && format[pos] == '.')
+        {
+            op.text += format[pos++];
+            if (pos < format.length() && format[pos] == '*')
+            {
+                op.precision_from_arg = true;
+                op.text += format[pos++];
+            }
+            while (pos < format.length() && std::isdigit(static_cast<unsigned char>(format[pos])))
+            {
+                op.text += format[pos++];
+            }
+        }
+        while (pos < format.length() && std::strchr("hlLjzt", format[pos]))
+        {
+            ++pos; // Length modifiers are accepted and ignored: every integer is 64-bit
+        }
+        if (pos >= format.length() || !std::strchr("diouxXcsbeEfFgGaA", format[pos]))
+        {
+            m_errorMessage = "printf: " + format.substr(i, pos + 1 - i) + ": invalid conversion";
+            literal.append(format, i, pos + 1 - i);
+            i = pos + 1;
+            continue;
+        }
+        op.conversion = format[pos];
+        if (std::strchr("diouxX", op.conversion))
+        {
+            op.text += "ll";
+        }
+        op.text += (op.conversion == 'b') ? 's' : op.conversion;
+        flush_literal();
+        m_ops.push_back(std::move(op));
+        m_consumesArguments = true;
+        i = pos + 1;
+    }
+    flush_literal();
+}
+
+bool PrintfFormat::format(const std::vector<std::string>& args, size_t first_arg, std::string& output,
+                          std::string& error_message) const
+{
+    error_message = m_errorMessage;
+    size_t next_arg = first_arg;
+    do
+    {
+        for (const Op& op : m_ops)
+        {
+            if (op.type == OpType::Literal)
+            {
+                output += op.text;
+            }
+            else if (!appendConversion(op, args, next_arg, output, error_message))
+            {
+                return error_message.empty();
+            }
+        }
+    } while (m_consumesArguments && !m_stopsOutput && next_arg < args.size());
+    return error_message.empty();
+}
+
+bool PrintfFormat::appendConversion(const Op& op, const std::vector<std::string>& args, size_t& next_arg,
+                                    std::string& output, std::string& error_message) const
+{
+    static const std::string K_MissingArgument;
+    auto take_argument = [&]() -> const std::string&
+    {
+        return next_arg < args.size() ? args[next_arg++] : K_MissingArgument;
+    };
+    auto record_error = [&](const std::string& message)
+    {
+        if (error_message.empty())
+        {
+            error_message = message;
+        }
+    };
+
+    std::vector<int> star_values;
+    if (op.width_from_arg || op.precision_from_arg)
+    {
+        star_values.reserve(2);
+        for (int k = 0; k < (op.width_from_arg ? 1 : 0) + (op.precision_from_arg ? 1 : 0); ++k)
+        {
+            std::string message;
+            star_values.push_back(static_cast<int>(parse_number<long long>(
+                take_argument(), [](const char* s, char** e) { return std::strtoll(s, e, 0); }, message)));
+            if (!message.empty())
+            {
+                record_error(message);
+            }
+        }
+    }
+
+    std::string message;
+    switch (op.conversion)
+    {
+        case 's':
+            append_formatted(output, op.text.c_str(), star_values, take_argument().c_str());
+            break;
+        case 'b':
+        {
+            const std::string& argument = take_argument();
+            std::string decoded;
+            bool keep_going = true;
+            for (size_t i = 0; i < argument.length() && keep_going;)
+            {
+                if (argument[i] == '\\')
+                {
+                    keep_going = append_escape(argument, i, decoded, true);
+                }
+                else
+                {
+                    decoded += argument[i++];
+                }
+            }
+            append_formatted(output, op.text.c_str(), star_values, decoded.c_str());
+            if (!keep_going)
+            {
+                return false; // `\c`: no further output at all
+            }
+            break;
+        }
+        case 'c':
+        {
+            const std::string& argument = take_argument();
+            append_formatted(output, op.text.c_str(), star_values, argument.empty() ? 0 : argument[0]);
+            break;
+        }
+        case 'd':
+        case 'i':
+            append_formatted(output, op.text.c_str(), star_values,
+                             parse_number<long long>(take_argument(),
+                                                     [](const char* s, char** e) { return std::strtoll(s, e, 0); },
+                                                     message));
+            break;
+        case 'o':
+        case 'u':
+        case 'x':
+        case 'X':
+        {
+            const std::string& argument = take_argument();
+            // Negative values wrap as in C: printf %x -1 prints ffffffffffffffff
+            unsigned long long value =
+                (!argument.empty() && argument[0] == '-')
+                    ? static_cast<unsigned long long>(parse_number<long long>(
+                          argument, [](const char* s, char** e) { return std::strtoll(s, e, 0); }, message))
+                    : parse_number<unsigned long long>(
+                          argument, [](const char* s, char** e) { return std::strtoull(s, e, 0); }, message);
+            append_formatted(output, op.text.c_str(), star_values, value);
+            break;
+        }
+        default: // Floating point
+            append_formatted(output, op.text.c_str(), star_values,
+                             parse_number<double>(take_argument(),
+                                                  [](const char* s, char** e) { return std::strtod(s, e); }, message));
+            break;
+    }
+    if (!message.empty())
+    {
+        record_error(message);
+    }
+    return true;
+}
+
+}
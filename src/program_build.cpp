@@ -0,0 +1,287 @@
+#include "../include/program_build.hpp"
+#include "../include/build_cache.hpp"
+#include "../include/output_sink.hpp"
+#include "../include/work_stealing_pool.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace g1_tinyshell
+{
+
+namespace
+{
+#ifdef _WIN32
+constexpr const char* K_ExecutableName = "program.exe";
+#else
+constexpr const char* K_ExecutableName = "program";
+#endif
+constexpr const char* K_ObjectName = "object.o";
+
+// SIGINT/SIGQUIT stay ignored while any run_program() call is waiting (compiles run in parallel).
+std::mutex g_interrupt_mutex;
+size_t g_interrupt_waiters = 0;
+struct sigaction g_saved_interrupt;
+struct sigaction g_saved_quit;
+
+class InterruptShield
+{
+public:
+    InterruptShield()
+    {
+        std::lock_guard<std::mutex> lock(g_interrupt_mutex);
+        if (g_interrupt_waiters++ == 0)
+        {
+            struct sigaction ignore {};
+            ignore.sa_handler = SIG_IGN;
+            sigemptyset(&ignore.sa_mask);
+            sigaction(SIGINT, &ignore, &g_saved_interrupt);
+            sigaction(SIGQUIT, &ignore, &g_saved_quit);
+        }
+    }
+
+    ~InterruptShield()
+    {
+        std::lock_guard<std::mutex> lock(g_interrupt_mutex);
+        if (--g_interrupt_waiters == 0)
+        {
+            sigaction(SIGINT, &g_saved_interrupt, nullptr);
+            sigaction(SIGQUIT, &g_saved_quit, nullptr);
+        }
+    }
+};
+
+std::string absolute_path(const std::string& path)
+{
+    char resolved[PATH_MAX];
+    return realpath(path.c_str(), resolved) ? std::string(resolved) : path;
+}
+
+std::string current_directory()
+{
+    char cwd[PATH_MAX];
+    return getcwd(cwd, sizeof(cwd)) ? std::string(cwd) : std::string();
+}
+
+// Compiles one translation unit into its cached object; returns the entry directory.
+std::string compile_unit(const ProgramBuild& build, const std::string& compiler_identity, const std::string& cwd,
+                         const std::string& source, int& status, std::string& error)
+{
+    BuildCache& cache = BuildCache::instance();
+    std::string source_hash = BuildCache::hashFile(source);
+    if (source_hash.empty())
+    {
+        status = 1;
+        error = build.compiler + ": Cannot read `" + source + "`: " + std::strerror(errno);
+        return "";
+    }
+    // The path and cwd take part because quoted includes and relative -I flags resolve from them
+    std::vector<std::string> key_parts = {"object", compiler_identity, absolute_path(source), cwd, source_hash};
+    key_parts.insert(key_parts.end(), build.compile_flags.begin(), build.compile_flags.end());
+    std::string key = BuildCache::hashStrings(key_parts);
+
+    std::string entry = cache.find(key);
+    if (!entry.empty())
+    {
+        return entry;
+    }
+    std::string cache_error;
+    entry = cache.store(key, [&](const std::string& staging_directory, std::string&)
+    {
+        // -MD records the headers the cache must revalidate
+        std::vector<std::string> argv = {build.compiler};
+        argv.insert(argv.end(), build.compile_flags.begin(), build.compile_flags.end());
+        argv.insert(argv.end(), {"-c", source, "-o", staging_directory + "/" + K_ObjectName,
+                                 "-MD", "-MF", staging_directory + "/" + K_BuildDependencyFile});
+        status = run_program(argv);
+        return status == 0;
+    }, cache_error);
+    if (entry.empty())
+    {
+        if (status == 0)
+        {
+            status = 1;
+            error = build.compiler + ": " + cache_error;
+        }
+        else if (status < 0)
+        {
+            status = 127;
+            error = build.compiler + ": Cannot run compiler: " + std::strerror(errno);
+        }
+        else
+        {
+            error = build.compiler + ": Compilation of `" + source + "` failed (exit code: " + std::to_string(status) + ")";
+        }
+    }
+    return entry;
+}
+}
+
+int run_program(const std::vector<std::string>& argv)
+{
+    std::vector<char*> raw_argv;
+    for (const std::string& arg : argv)
+    {
+        raw_argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    raw_argv.push_back(nullptr);
+
+    InterruptShield shield;
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    sigset_t default_signals;
+    sigemptyset(&default_signals);
+    sigaddset(&default_signals, SIGINT);
+    sigaddset(&default_signals, SIGQUIT);
+    posix_spawnattr_setsigdefault(&attributes, &default_signals);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGDEF);
+
+    pid_t pid;
+    int spawn_error = posix_spawnp(&pid, raw_argv[0], nullptr, &attributes, raw_argv.data(), environ);
+    posix_spawnattr_destroy(&attributes);
+    if (spawn_error != 0)
+    {
+        errno = spawn_error;
+        return -1;
+    }
+    int wait_status = 0;
+    while (waitpid(pid, &wait_status, 0) < 0)
+    {
+        if (errno != EINTR)
+        {
+            return -1;
+        }
+    }
+    return WIFEXITED(wait_status) ? WEXITSTATUS(wait_status) : 128 + WTERMSIG(wait_status);
+}
+
+std::string build_program(const ProgramBuild& build, int& status, std::string& error)
+{
+    status = 0;
+    for (const std::string& source : build.sources)
+    {
+        struct stat source_stat;
+        if (stat(source.c_str(), &source_stat) != 0 || !S_ISREG(source_stat.st_mode))
+        {
+            status = 1;
+            error = build.compiler + ": Source file not found or is not a regular file: " + source;
+            return "";
+        }
+    }
+    BuildCache& cache = BuildCache::instance();
+    std::string compiler_identity = cache.compilerIdentity(build.compiler);
+    if (compiler_identity.empty())
+    {
+        status = 127;
+        error = build.compiler + ": Compiler not found in PATH";
+        return "";
+    }
+    std::string cwd = current_directory();
+
+    // Compiler diagnostics go straight to the terminal, after our own buffered output
+    OutputSink::flushAll();
+    std::vector<std::string> objects(build.sources.size());
+    std::vector<int> statuses(build.sources.size(), 0);
+    std::vector<std::string> errors(build.sources.size());
+    if (build.sources.size() == 1)
+    {
+        objects[0] = compile_unit(build, compiler_identity, cwd, build.sources[0], statuses[0], errors[0]);
+    }
+    else
+    {
+        WorkStealingPool pool(std::min(WorkStealingPool::defaultThreadCount(), build.sources.size()));
+        for (size_t i = 0; i < build.sources.size(); ++i)
+        {
+            pool.submit([&, i]()
+            {
+                objects[i] = compile_unit(build, compiler_identity, cwd, build.sources[i], statuses[i], errors[i]);
+            });
+        }
+        pool.wait();
+    }
+    for (size_t i = 0; i < build.sources.size(); ++i)
+    {
+        if (objects[i].empty())
+        {
+            status = statuses[i];
+            for (const std::string& unit_error : errors)
+            {
+                error += (error.empty() || unit_error.empty() ? "" : "\n") + unit_error;
+            }
+            return "";
+        }
+    }
+
+    // The link is keyed by what it consumes: object contents, flags and the contents of other inputs.
+    // An object entry keeps its name when an included header changes and it is recompiled,
+    // so the name alone would hand back the old executable.
+    std::vector<std::string> key_parts = {"executable", compiler_identity, cwd};
+    for (const std::string& object : objects)
+    {
+        std::string object_hash = BuildCache::hashFile(object + "/" + K_ObjectName);
+        if (object_hash.empty())
+        {
+            status = 1;
+            error = build.compiler + ": Cannot read `" + object + "/" + K_ObjectName + "`: " + std::strerror(errno);
+            return "";
+        }
+        key_parts.push_back(object_hash);
+    }
+    for (const std::string& item : build.link_items)
+    {
+        key_parts.push_back(item);
+        struct stat item_stat;
+        if (item[0] != '-' && stat(item.c_str(), &item_stat) == 0 && S_ISREG(item_stat.st_mode))
+        {
+            key_parts.push_back(BuildCache::hashFile(item));
+        }
+    }
+    std::string key = BuildCache::hashStrings(key_parts);
+    std::string entry = cache.find(key);
+    if (entry.empty())
+    {
+        std::string cache_error;
+        entry = cache.store(key, [&](const std::string& staging_directory, std::string&)
+        {
+            std::vector<std::string> argv = {build.compiler, "-o", staging_directory + "/" + K_ExecutableName};
+            for (const std::string& object : objects)
+            {
+                argv.push_back(object + "/" + K_ObjectName);
+            }
+            argv.insert(argv.end(), build.link_items.begin(), build.link_items.end());
+            status = run_program(argv);
+            return status == 0;
+        }, cache_error);
+        if (entry.empty())
+        {
+            if (status < 0)
+            {
+                status = 127;
+                error = build.compiler + ": Cannot run compiler: " + std::strerror(errno);
+            }
+            else if (status > 0)
+            {
+                error = build.compiler + ": Linking failed (exit code: " + std::to_string(status) + ")";
+            }
+            else
+            {
+                status = 1;
+                error = build.compiler + ": " + cache_error;
+            }
+            return "";
+        }
+    }
+    return entry + "/" + K_ExecutableName;
+}
+
+}
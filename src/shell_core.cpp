@@ -1,27 +1,85 @@
 #include "../include/shell_core.hpp"
+#include "../include/history_expansion.hpp"
+#include "../include/output_sink.hpp"
 #include <iostream>
 #include <string>
 #include <filesystem>
 #include <cstdlib> // For getenv
 #include <algorithm> // Added for std::all_of
+#include <cerrno>
+#include <cstring>
+#include <unistd.h> // isatty
 
 namespace g1_tinyshell
 {
 
+namespace
+{
+size_t history_limit(const char* variable_name, size_t default_limit)
+{
+    const char* value = std::getenv(variable_name);
+    if (!value || !*value)
+    {
+        return default_limit;
+    }
+    char* end = nullptr;
+    unsigned long long limit = std::strtoull(value, &end, 10);
+    return (*end == '\0') ? static_cast<size_t>(limit) : default_limit;
+}
+}
+
 ShellCore::ShellCore()
     : m_environment(), // Initialize environment
       m_executor(m_environment, *this), // Initialize executor with environment and self
+      m_historyExpansion(isatty(STDIN_FILENO)),
       m_shouldExit(false)
 {
     // Initialize exit status $? to 0
     m_environment.setVariable("?", "0");
+    openHistory();
+    // As in bash, scripts keep `!` literal (`[!a]*` is a glob, not an event) unless asked otherwise
+    const char* history_expansion = std::getenv("TINYSHELL_HISTEXPAND");
+    if (history_expansion && *history_expansion)
+    {
+        m_historyExpansion = std::strcmp(history_expansion, "0") != 0;
+    }
+    const char* terminal = std::getenv("TERM");
+    if (isatty(STDIN_FILENO) && isatty(STDOUT_FILENO) && !(terminal && std::strcmp(terminal, "dumb") == 0))
+    {
+        m_lineEditor = std::make_unique<LineEditor>(m_commandHistory, m_environment);
+    }
+}
+
+void ShellCore::openHistory()
+{
+    m_commandHistory.setMaxEntries(history_limit("TINYSHELL_HISTSIZE", K_DefaultHistorySize));
+
+    // Scripts fed on stdin keep their history to themselves unless a file is named explicitly
+    std::string history_path;
+    const char* history_file = std::getenv("TINYSHELL_HISTFILE");
+    const char* home_dir = std::getenv("HOME");
+    if (history_file)
+    {
+        history_path = history_file;
+    }
+    else if (isatty(STDIN_FILENO) && home_dir && *home_dir)
+    {
+        history_path = std::string(home_dir) + "/.tinyshell_history";
+    }
+    if (history_path.empty())
+    {
+        return;
+    }
+    if (!m_commandHistory.open(history_path, history_limit("TINYSHELL_HISTFILESIZE", K_DefaultHistoryFileSize)))
+    {
+        std::cerr << "Tinyshell: Cannot open history file `" << history_path << "`: " << std::strerror(errno) << std::endl;
+    }
 }
 
 void ShellCore::run()
 {
     while (!m_shouldExit)
     {
-        displayPrompt();
         std::string line = readLine();
 
         if (line.empty()) // Handle empty input (e.g., just pressing Enter)
@@ -29,7 +87,23 @@ void ShellCore::run()
             continue;
         }
 
-        addToHistory(line);
+        if (!m_shouldExit) // Not the `exit` readLine() substitutes at end of input
+        {
+            std::string expanded = line;
+            std::string history_error;
+            if (m_historyExpansion && !expand_history(line, m_commandHistory, expanded, history_error))
+            {
+                std::cerr << "Tinyshell: " << history_error << std::endl;
+                m_environment.setVariable("?", "1");
+                continue;
+            }
+            if (expanded != line)
+            {
+                std::cout << expanded << std::endl; // Show what actually runs
+                line = std::move(expanded);
+            }
+            addToHistory(line);
+        }
 
         // --- Lexing ---
         Lexer lexer(line);
@@ -67,6 +141,7 @@ void ShellCore::run()
 
         // --- Execution ---
         ExecutionResult result = m_executor.execute(ast_root);
+        OutputSink::flushAll(); // Command boundary: builtin output is buffered until here
 
         if (!result.error_message.empty())
         {
@@ -80,6 +155,18 @@ void ShellCore::run()
 std::string ShellCore::readLine()
 {
     std::string line;
+    if (m_lineEditor)
+    {
+        std::cout << std::flush; // The editor writes to the terminal directly
+        if (m_lineEditor->readLine(promptText(), line))
+        {
+            return line;
+        }
+        std::cout << std::endl;
+        requestExit();
+        return "exit";
+    }
+    std::cout << promptText() << std::flush;
     if (!std::getline(std::cin, line))
     {
         // Handle EOF (Ctrl+D)
@@ -100,7 +187,7 @@ std::string ShellCore::readLine()
     return line;
 }
 
-void ShellCore::displayPrompt()
+std::string ShellCore::promptText() const
 {
     std::error_code ec;
     std::filesystem::path current_path = std::filesystem::current_path(ec);
@@ -115,31 +202,25 @@ void ShellCore::displayPrompt()
     }
 
     // Basic prompt without color first
-    // std::cout << "G1-HybridShell " << path_segment << " $ " << std::flush;
+    // return "G1-HybridShell " + path_segment + " $ ";
 
     // Prompt with optional color
-    std::cout << K_DefaultPromptColor << "unitedshell " << K_ResetColor
-              << K_PathPromptColor << path_segment << K_ResetColor
-              << " $ " << std::flush;
+    return std::string(K_DefaultPromptColor) + "unitedshell " + K_ResetColor +
+           K_PathPromptColor + path_segment + K_ResetColor + " $ ";
 }
 
 void ShellCore::addToHistory(const std::string& command_line)
 {
-    if (command_line.empty() || (m_commandHistory.empty() && command_line.find_first_not_of(" \t\n\v\f\r") == std::string::npos) || (!m_commandHistory.empty() && command_line == m_commandHistory.back()))
+    if (command_line.find_first_not_of(" \t\n\v\f\r") == std::string::npos)
     {
-        // Avoid adding empty lines or consecutive duplicates
+        // Avoid adding empty lines
         return;
     }
 
-    m_commandHistory.push_back(command_line);
-    // Limit history size
-    if (m_commandHistory.size() > K_MaxHistorySize)
-    {
-        m_commandHistory.pop_front();
-    }
+    m_commandHistory.add(command_line); // Moves a repeated command to the end and trims to the size limit
 }
 
-const std::deque<std::string>& ShellCore::getHistory() const
+const HistoryStore& ShellCore::getHistory() const
 {
     return m_commandHistory;
 }
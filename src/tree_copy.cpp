@@ -0,0 +1,415 @@
+#include "../include/tree_copy.hpp"
+#include "../include/file_copy.hpp"
+#include "../include/globbing.hpp" // read_directory_entries
+#include "../include/work_stealing_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/fs.h> // FICLONE
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace g1_tinyshell
+{
+
+namespace
+{
+constexpr size_t K_CopyBatchSize = 64; // Non-directory entries per pool task
+constexpr size_t K_MaxCopyThreads = 8; // Enough to keep a disk queue full without thrashing it
+
+// One directory being copied. `pending` counts the listing in progress, every queued batch
+// of files and every subdirectory not yet finished; whoever drops it to zero stamps the
+// directory's mode and times and releases the parent.
+struct CopyNode
+{
+    std::shared_ptr<CopyNode> parent;  // nullptr for an operand (resolved from the cwd)
+    std::string source_name;           // Relative to the parent's source_fd
+    std::string destination_name;      // Relative to the parent's destination_fd
+    std::string source_path;           // For messages
+    std::string destination_path;
+    int source_fd = -1;                // Open while its children still need them
+    int destination_fd = -1;
+    struct stat source_stat {};
+    dev_t created_device = 0;          // The operand's new top directory, never copied into itself
+    ino_t created_inode = 0;
+    std::atomic<size_t> pending{1};
+};
+
+struct TreeCopy
+{
+    WorkStealingPool* pool = nullptr;
+    std::mutex errors_mutex;
+    std::vector<std::string> errors;
+
+    void addMessage(std::string message)
+    {
+        std::lock_guard<std::mutex> lock(errors_mutex);
+        errors.push_back(std::move(message));
+    }
+
+    void addError(const std::string& source, const std::string& destination, int error_number)
+    {
+        addMessage("cp: Cannot copy `" + source + "` to `" + destination + "`: " + std::strerror(error_number));
+    }
+};
+
+struct FileEntry
+{
+    std::string name;
+    unsigned char type;
+};
+
+int parent_source_fd(const CopyNode& node)
+{
+    return node.parent ? node.parent->source_fd : AT_FDCWD;
+}
+
+int parent_destination_fd(const CopyNode& node)
+{
+    return node.parent ? node.parent->destination_fd : AT_FDCWD;
+}
+
+bool set_times(int dir_fd, const char* name, const struct stat& source_stat, int flags)
+{
+    struct timespec times[2] = {source_stat.st_atim, source_stat.st_mtim};
+    return utimensat(dir_fd, name, times, flags) == 0;
+}
+
+// Copies a regular file's data, mode and timestamps. Returns 0 or the errno of the failure.
+int copy_regular_file(int source_dir_fd, const char* source_name, int destination_dir_fd,
+                      const char* destination_name, int open_flags)
+{
+    int source_fd = openat(source_dir_fd, source_name, O_RDONLY | O_CLOEXEC | open_flags);
+    if (source_fd < 0)
+    {
+        return errno;
+    }
+    struct stat source_stat;
+    if (fstat(source_fd, &source_stat) != 0)
+    {
+        int error_number = errno;
+        close(source_fd);
+        return error_number;
+    }
+    int destination_fd = openat(destination_dir_fd, destination_name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                                source_stat.st_mode & 07777);
+    if (destination_fd < 0)
+    {
+        int error_number = errno;
+        close(source_fd);
+        return error_number;
+    }
+
+    int error_number = 0;
+    bool copied = false;
+#ifdef FICLONE
+    // Shares the source's extents (btrfs, XFS, bcachefs): no data is read or written at all
+    copied = ioctl(destination_fd, FICLONE, source_fd) == 0;
+#endif
+    uint64_t bytes_copied = 0;
+    if (!copied && !copy_descriptor_data(source_fd, destination_fd, bytes_copied))
+    {
+        error_number = errno;
+    }
+    // An existing destination keeps its old mode through O_CREAT, so set it explicitly
+    if (error_number == 0 && fchmod(destination_fd, source_stat.st_mode & 07777) != 0)
+    {
+        error_number = errno;
+    }
+    struct timespec times[2] = {source_stat.st_atim, source_stat.st_mtim};
+    if (error_number == 0 && futimens(destination_fd, times) != 0)
+    {
+        error_number = errno;
+    }
+    if (close(destination_fd) != 0 && error_number == 0)
+    {
+        error_number = errno; // Delayed write errors (NFS, quota) surface here
+    }
+    close(source_fd);
+    return error_number;
+}
+
+int copy_symlink(int source_dir_fd, const char* source_name, int destination_dir_fd, const char* destination_name)
+{
+    struct stat link_stat;
+    if (fstatat(source_dir_fd, source_name, &link_stat, AT_SYMLINK_NOFOLLOW) != 0)
+    {
+        return errno;
+    }
+    std::string target(static_cast<size_t>(link_stat.st_size) + 1, '\0');
+    ssize_t length = readlinkat(source_dir_fd, source_name, &target[0], target.size());
+    if (length < 0)
+    {
+        return errno;
+    }
+    target.resize(static_cast<size_t>(length));
+    if (symlinkat(target.c_str(), destination_dir_fd, destination_name) != 0)
+    {
+        if (errno != EEXIST || unlinkat(destination_dir_fd, destination_name, 0) != 0 ||
+            symlinkat(target.c_str(), destination_dir_fd, destination_name) != 0)
+        {
+            return errno;
+        }
+    }
+    set_times(destination_dir_fd, destination_name, link_stat, AT_SYMLINK_NOFOLLOW); // Best effort, like cp -p
+    return 0;
+}
+
+// FIFOs, sockets and device nodes are recreated rather than read.
+int copy_special_file(int source_dir_fd, const char* source_name, int destination_dir_fd,
+                      const char* destination_name)
+{
+    struct stat source_stat;
+    if (fstatat(source_dir_fd, source_name, &source_stat, AT_SYMLINK_NOFOLLOW) != 0)
+    {
+        return errno;
+    }
+    if (mknodat(destination_dir_fd, destination_name, source_stat.st_mode, source_stat.st_rdev) != 0)
+    {
+        return errno;
+    }
+    set_times(destination_dir_fd, destination_name, source_stat, 0);
+    return 0;
+}
+
+// Drops one reference; the last one gives the finished directory its mode and times and
+// releases its parent.
+void release_directory(TreeCopy& copy, std::shared_ptr<CopyNode> node)
+{
+    while (node && node->pending.fetch_sub(1) == 1)
+    {
+        if (node->destination_fd >= 0)
+        {
+            struct timespec times[2] = {node->source_stat.st_atim, node->source_stat.st_mtim};
+            if (fchmod(node->destination_fd, node->source_stat.st_mode & 07777) != 0 ||
+                futimens(node->destination_fd, times) != 0)
+            {
+                copy.addError(node->source_path, node->destination_path, errno);
+            }
+            close(node->destination_fd);
+            node->destination_fd = -1;
+        }
+        if (node->source_fd >= 0)
+        {
+            close(node->source_fd);
+            node->source_fd = -1;
+        }
+        node = node->parent;
+    }
+}
+
+void copy_entries(TreeCopy& copy, const CopyNode& node, const std::vector<FileEntry>& entries)
+{
+    for (const FileEntry& entry : entries)
+    {
+        const char* name = entry.name.c_str();
+        int error_number;
+        if (entry.type == DT_REG)
+        {
+            error_number = copy_regular_file(node.source_fd, name, node.destination_fd, name, O_NOFOLLOW);
+        }
+        else if (entry.type == DT_LNK)
+        {
+            error_number = copy_symlink(node.source_fd, name, node.destination_fd, name);
+        }
+        else
+        {
+            error_number = copy_special_file(node.source_fd, name, node.destination_fd, name);
+        }
+        if (error_number != 0)
+        {
+            copy.addError(node.source_path + "/" + entry.name, node.destination_path + "/" + entry.name, error_number);
+        }
+    }
+}
+
+void copy_directory(TreeCopy& copy, const std::shared_ptr<CopyNode>& node)
+{
+    // Opened only now, so queued directories do not hold descriptors
+    int no_follow = node->parent ? O_NOFOLLOW : 0;
+    node->source_fd = openat(parent_source_fd(*node), node->source_name.c_str(),
+                             O_RDONLY | O_DIRECTORY | O_CLOEXEC | no_follow);
+    if (node->source_fd < 0 || fstat(node->source_fd, &node->source_stat) != 0)
+    {
+        copy.addError(node->source_path, node->destination_path, errno);
+        release_directory(copy, node);
+        return;
+    }
+    if (node->source_stat.st_dev == node->created_device && node->source_stat.st_ino == node->created_inode)
+    {
+        release_directory(copy, node); // The copy being made, e.g. `cp -r dir dir/sub`
+        return;
+    }
+
+    // Owner-writable until the contents are in; release_directory() sets the real mode.
+    // An existing directory is merged into, as cp does.
+    if (mkdirat(parent_destination_fd(*node), node->destination_name.c_str(),
+                (node->source_stat.st_mode & 07777) | S_IRWXU) != 0 && errno != EEXIST)
+    {
+        copy.addError(node->source_path, node->destination_path, errno);
+        release_directory(copy, node);
+        return;
+    }
+    node->destination_fd = openat(parent_destination_fd(*node), node->destination_name.c_str(),
+                                  O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    struct stat destination_stat;
+    if (node->destination_fd < 0 || fstat(node->destination_fd, &destination_stat) != 0)
+    {
+        copy.addError(node->source_path, node->destination_path, errno);
+        release_directory(copy, node);
+        return;
+    }
+    if (!node->parent)
+    {
+        node->created_device = destination_stat.st_dev;
+        node->created_inode = destination_stat.st_ino;
+    }
+
+    std::vector<DirectoryEntry> entries;
+    if (!read_directory_entries(node->source_fd, entries))
+    {
+        copy.addError(node->source_path, node->destination_path, errno);
+    }
+    std::vector<FileEntry> batch;
+    for (const DirectoryEntry& entry : entries)
+    {
+        unsigned char type = entry.type;
+        if (type == DT_UNKNOWN)
+        {
+            struct stat entry_stat;
+            if (fstatat(node->source_fd, entry.name.c_str(), &entry_stat, AT_SYMLINK_NOFOLLOW) == 0)
+            {
+                type = S_ISDIR(entry_stat.st_mode) ? DT_DIR : S_ISLNK(entry_stat.st_mode) ? DT_LNK
+                     : S_ISREG(entry_stat.st_mode) ? DT_REG : DT_UNKNOWN;
+            }
+        }
+        if (type == DT_DIR)
+        {
+            auto child = std::make_shared<CopyNode>();
+            child->parent = node;
+            child->source_name = entry.name;
+            child->destination_name = entry.name;
+            child->source_path = node->source_path + "/" + entry.name;
+            child->destination_path = node->destination_path + "/" + entry.name;
+            child->created_device = node->created_device;
+            child->created_inode = node->created_inode;
+            node->pending.fetch_add(1);
+            copy.pool->submit([&copy, child]() { copy_directory(copy, child); });
+            continue;
+        }
+        batch.push_back({entry.name, type});
+        if (batch.size() == K_CopyBatchSize)
+        {
+            node->pending.fetch_add(1);
+            copy.pool->submit([&copy, node, files = std::move(batch)]()
+            {
+                copy_entries(copy, *node, files);
+                release_directory(copy, node);
+            });
+            batch.clear();
+        }
+    }
+    copy_entries(copy, *node, batch); // The remainder is not worth a task
+    release_directory(copy, node);    // The listing's own reference
+}
+
+std::string base_name_of(const std::string& path)
+{
+    size_t slash_pos = path.find_last_of('/');
+    return (slash_pos == std::string::npos) ? path : path.substr(slash_pos + 1);
+}
+}
+
+std::vector<std::string> copy_paths(const std::vector<std::string>& sources, const std::string& destination,
+                                    bool recursive)
+{
+    TreeCopy copy;
+    std::unique_ptr<WorkStealingPool> pool; // Started by the first directory tree
+
+    struct stat destination_stat;
+    bool destination_exists = stat(destination.c_str(), &destination_stat) == 0;
+    bool into_directory = destination_exists && S_ISDIR(destination_stat.st_mode);
+    if (sources.size() > 1 && !into_directory)
+    {
+        copy.addMessage("cp: Target `" + destination + "` is not a directory");
+        return std::move(copy.errors);
+    }
+
+    for (std::string source : sources)
+    {
+        while (source.length() > 1 && source.back() == '/')
+        {
+            source.pop_back();
+        }
+        std::string target = into_directory ? destination + "/" + base_name_of(source) : destination;
+
+        // Like cp, operands are followed unless copying recursively
+        struct stat source_stat;
+        if ((recursive ? lstat(source.c_str(), &source_stat) : stat(source.c_str(), &source_stat)) != 0)
+        {
+            copy.addMessage("cp: Cannot stat `" + source + "`: " + std::strerror(errno));
+            continue;
+        }
+        struct stat target_stat;
+        if (stat(target.c_str(), &target_stat) == 0 && target_stat.st_dev == source_stat.st_dev &&
+            target_stat.st_ino == source_stat.st_ino)
+        {
+            copy.addMessage("cp: `" + source + "` and `" + target + "` are the same file");
+            continue;
+        }
+
+        if (S_ISDIR(source_stat.st_mode))
+        {
+            if (!recursive)
+            {
+                copy.addMessage("cp: -r not specified; omitting directory `" + source + "`");
+                continue;
+            }
+            if (!pool)
+            {
+                pool = std::make_unique<WorkStealingPool>(
+                    std::min(WorkStealingPool::defaultThreadCount(), K_MaxCopyThreads));
+                copy.pool = pool.get();
+            }
+            auto root = std::make_shared<CopyNode>();
+            root->source_name = source;
+            root->destination_name = target;
+            root->source_path = source;
+            root->destination_path = target;
+            pool->submit([&copy, root]() { copy_directory(copy, root); });
+            continue;
+        }
+
+        int error_number;
+        if (S_ISLNK(source_stat.st_mode))
+        {
+            error_number = copy_symlink(AT_FDCWD, source.c_str(), AT_FDCWD, target.c_str());
+        }
+        else if (S_ISREG(source_stat.st_mode) || !recursive)
+        {
+            error_number = copy_regular_file(AT_FDCWD, source.c_str(), AT_FDCWD, target.c_str(), 0);
+        }
+        else
+        {
+            error_number = copy_special_file(AT_FDCWD, source.c_str(), AT_FDCWD, target.c_str());
+        }
+        if (error_number != 0)
+        {
+            copy.addError(source, target, error_number);
+        }
+    }
+
+    if (pool)
+    {
+        pool->wait();
+    }
+    return std::move(copy.errors);
+}
+
+}
@@ -0,0 +1,185 @@
+#include "../include/tree_removal.hpp"
+#include "../include/globbing.hpp" // read_directory_entries
+#include "../include/work_stealing_pool.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace g1_tinyshell
+{
+
+namespace
+{
+// One directory being emptied. `pending` counts the listing in progress plus every
+// subdirectory not yet removed; whoever drops it to zero removes the directory.
+struct RemovalNode
+{
+    std::shared_ptr<RemovalNode> parent; // nullptr for an operand (resolved from the cwd)
+    std::string name;                    // Relative to the parent's fd
+    std::string path;                    // For messages (and for operands, for removal)
+    int fd = -1;                         // Open while its children still need it
+    std::atomic<size_t> pending{1};
+};
+
+struct TreeRemoval
+{
+    WorkStealingPool* pool = nullptr;
+    std::mutex errors_mutex;
+    std::vector<std::string> errors;
+
+    void addError(const std::string& path, int error_number)
+    {
+        std::lock_guard<std::mutex> lock(errors_mutex);
+        errors.push_back("rm: Cannot remove `" + path + "`: " + std::strerror(error_number));
+    }
+};
+
+int parent_fd_of(const RemovalNode& node)
+{
+    return node.parent ? node.parent->fd : AT_FDCWD;
+}
+
+const std::string& name_in_parent(const RemovalNode& node)
+{
+    return node.parent ? node.name : node.path;
+}
+
+// Drops one reference; the last one removes the (now empty) directory and releases its parent.
+void release_directory(TreeRemoval& removal, std::shared_ptr<RemovalNode> node)
+{
+    while (node && node->pending.fetch_sub(1) == 1)
+    {
+        if (node->fd >= 0)
+        {
+            close(node->fd);
+            node->fd = -1;
+        }
+        if (unlinkat(parent_fd_of(*node), name_in_parent(*node).c_str(), AT_REMOVEDIR) != 0 && errno != ENOENT)
+        {
+            removal.addError(node->path, errno);
+        }
+        node = node->parent;
+    }
+}
+
+void empty_directory(TreeRemoval& removal, const std::shared_ptr<RemovalNode>& node)
+{
+    // Opened only now, so queued directories do not hold descriptors
+    node->fd = openat(parent_fd_of(*node), name_in_parent(*node).c_str(),
+                      O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (node->fd < 0)
+    {
+        release_directory(removal, node); // rmdir still succeeds if it is empty; otherwise it reports
+        return;
+    }
+
+    std::vector<DirectoryEntry> entries;
+    if (!read_directory_entries(node->fd, entries))
+    {
+        removal.addError(node->path, errno);
+    }
+    for (const DirectoryEntry& entry : entries)
+    {
+        bool is_directory = entry.type == DT_DIR;
+        if (entry.type == DT_UNKNOWN)
+        {
+            struct stat entry_stat;
+            is_directory = fstatat(node->fd, entry.name.c_str(), &entry_stat, AT_SYMLINK_NOFOLLOW) == 0 &&
+                           S_ISDIR(entry_stat.st_mode);
+        }
+        if (is_directory)
+        {
+            auto child = std::make_shared<RemovalNode>();
+            child->parent = node;
+            child->name = entry.name;
+            child->path = node->path + "/" + entry.name;
+            node->pending.fetch_add(1);
+            removal.pool->submit([&removal, child]() { empty_directory(removal, child); });
+        }
+        else if (unlinkat(node->fd, entry.name.c_str(), 0) != 0 && errno != ENOENT)
+        {
+            removal.addError(node->path + "/" + entry.name, errno);
+        }
+    }
+    release_directory(removal, node); // The listing's own reference
+}
+
+bool is_protected_operand(const std::string& path)
+{
+    if (path == "/")
+    {
+        return true;
+    }
+    size_t slash_pos = path.find_last_of('/');
+    std::string base_name = (slash_pos == std::string::npos) ? path : path.substr(slash_pos + 1);
+    return base_name == "." || base_name == "..";
+}
+}
+
+std::vector<std::string> remove_paths(const std::vector<std::string>& paths, bool recursive, bool force)
+{
+    TreeRemoval removal;
+    std::unique_ptr<WorkStealingPool> pool; // Started by the first directory tree
+
+    for (std::string path : paths)
+    {
+        while (path.length() > 1 && path.back() == '/')
+        {
+            path.pop_back();
+        }
+        struct stat path_stat;
+        if (lstat(path.c_str(), &path_stat) != 0)
+        {
+            if (!(force && errno == ENOENT))
+            {
+                removal.addError(path, errno);
+            }
+            continue;
+        }
+        if (!S_ISDIR(path_stat.st_mode))
+        {
+            if (unlink(path.c_str()) != 0)
+            {
+                removal.addError(path, errno);
+            }
+            continue;
+        }
+        if (!recursive)
+        {
+            if (rmdir(path.c_str()) != 0)
+            {
+                removal.addError(path, errno); // "Directory not empty": needs -r
+            }
+            continue;
+        }
+        if (is_protected_operand(path))
+        {
+            std::lock_guard<std::mutex> lock(removal.errors_mutex);
+            removal.errors.push_back("rm: Refusing to remove `" + path + "` recursively");
+            continue;
+        }
+
+        if (!pool)
+        {
+            pool = std::make_unique<WorkStealingPool>();
+            removal.pool = pool.get();
+        }
+        auto root = std::make_shared<RemovalNode>();
+        root->path = path;
+        pool->submit([&removal, root]() { empty_directory(removal, root); });
+    }
+
+    if (pool)
+    {
+        pool->wait();
+    }
+    return std::move(removal.errors);
+}
+
+}
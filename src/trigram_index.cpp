@@ -0,0 +1,147 @@
+#include "../include/trigram_index.hpp"
+#include <algorithm>
+
+namespace g1_tinyshell
+{
+
+namespace
+{
+uint32_t trigram_at(const char* text)
+{
+    return (static_cast<uint32_t>(static_cast<unsigned char>(text[0])) << 16) |
+           (static_cast<uint32_t>(static_cast<unsigned char>(text[1])) << 8) |
+           static_cast<uint32_t>(static_cast<unsigned char>(text[2]));
+}
+
+// Trigram keys leave the top byte zero; prefix keys carry their length there.
+uint32_t prefix_key(const char* text, size_t length)
+{
+    uint32_t key = static_cast<uint32_t>(length) << 24;
+    for (size_t i = 0; i < length; ++i)
+    {
+        key |= static_cast<uint32_t>(static_cast<unsigned char>(text[i])) << (16 - 8 * i);
+    }
+    return key;
+}
+}
+
+void TrigramIndex::add(uint32_t id, const char* text, size_t length)
+{
+    collectKeys(text, length);
+    for (uint32_t key : m_scratch)
+    {
+        m_postings[key].push_back(id);
+    }
+}
+
+void TrigramIndex::remove(uint32_t id, const char* text, size_t length)
+{
+    collectKeys(text, length);
+    for (uint32_t key : m_scratch)
+    {
+        auto it = m_postings.find(key);
+        if (it == m_postings.end())
+        {
+            continue;
+        }
+        std::vector<uint32_t>& list = it->second;
+        auto position = std::lower_bound(list.begin(), list.end(), id);
+        if (position != list.end() && *position == id)
+        {
+            list.erase(position);
+        }
+        if (list.empty())
+        {
+            m_postings.erase(it);
+        }
+    }
+}
+
+bool TrigramIndex::previousCandidate(const std::string& pattern, uint32_t before, uint32_t& candidate) const
+{
+    std::vector<const std::vector<uint32_t>*> lists;
+    if (!addTrigramLists(pattern, lists) || lists.empty())
+    {
+        return false;
+    }
+    return previousInAll(lists, before, candidate);
+}
+
+bool TrigramIndex::previousPrefixCandidate(const std::string& prefix, uint32_t before, uint32_t& candidate) const
+{
+    if (prefix.empty())
+    {
+        return false;
+    }
+    auto it = m_postings.find(prefix_key(prefix.data(), std::min<size_t>(prefix.size(), 3)));
+    if (it == m_postings.end())
+    {
+        return false;
+    }
+    std::vector<const std::vector<uint32_t>*> lists = {&it->second};
+    return addTrigramLists(prefix, lists) && previousInAll(lists, before, candidate);
+}
+
+bool TrigramIndex::empty() const
+{
+    return m_postings.empty();
+}
+
+// The distinct trigrams of the text, then its prefix keys.
+void TrigramIndex::collectKeys(const char* text, size_t length)
+{
+    m_scratch.clear();
+    for (size_t i = 0; i + 3 <= length; ++i)
+    {
+        m_scratch.push_back(trigram_at(text + i));
+    }
+    std::sort(m_scratch.begin(), m_scratch.end());
+    m_scratch.erase(std::unique(m_scratch.begin(), m_scratch.end()), m_scratch.end());
+    for (size_t prefix_length = 1; prefix_length <= std::min<size_t>(length, 3); ++prefix_length)
+    {
+        m_scratch.push_back(prefix_key(text, prefix_length));
+    }
+}
+
+// Adds the posting list of each trigram of `pattern`; false if some trigram occurs nowhere.
+bool TrigramIndex::addTrigramLists(const std::string& pattern, std::vector<const std::vector<uint32_t>*>& lists) const
+{
+    for (size_t i = 0; i + 3 <= pattern.size(); ++i)
+    {
+        auto it = m_postings.find(trigram_at(pattern.data() + i));
+        if (it == m_postings.end())
+        {
+            return false;
+        }
+        lists.push_back(&it->second);
+    }
+    return true;
+}
+
+bool TrigramIndex::previousInAll(std::vector<const std::vector<uint32_t>*>& lists, uint32_t before, uint32_t& candidate)
+{
+    std::sort(lists.begin(), lists.end(), [](const std::vector<uint32_t>* a, const std::vector<uint32_t>* b)
+    {
+        return a->size() != b->size() ? a->size() < b->size() : a < b; // Repeated trigrams end up adjacent
+    });
+    lists.erase(std::unique(lists.begin(), lists.end()), lists.end());
+
+    const std::vector<uint32_t>& shortest = *lists.front();
+    auto it = std::lower_bound(shortest.begin(), shortest.end(), before);
+    while (it != shortest.begin())
+    {
+        --it;
+        bool in_all = std::all_of(lists.begin() + 1, lists.end(), [id = *it](const std::vector<uint32_t>* list)
+        {
+            return std::binary_search(list->begin(), list->end(), id);
+        });
+        if (in_all)
+        {
+            candidate = *it;
+            return true;
+        }
+    }
+    return false;
+}
+
+}
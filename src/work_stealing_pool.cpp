@@ -0,0 +1,148 @@
+#include "../include/work_stealing_pool.hpp"
+
+namespace g1_tinyshell
+{
+
+constexpr size_t K_MaxPoolThreads = 32;
+
+namespace
+{
+// Identifies the pool and deque of the current worker thread, so nested submissions stay local.
+thread_local const WorkStealingPool* t_currentPool = nullptr;
+thread_local size_t t_workerIndex = 0;
+}
+
+WorkStealingPool::WorkStealingPool(size_t thread_count)
+    : m_queuedTasks(0), m_pendingTasks(0), m_nextQueue(0), m_stopping(false)
+{
+    if (thread_count == 0)
+    {
+        thread_count = defaultThreadCount();
+    }
+    for (size_t i = 0; i < thread_count; ++i)
+    {
+        m_queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    for (size_t i = 0; i < thread_count; ++i)
+    {
+        m_workers.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        m_stopping = true;
+    }
+    m_workAvailable.notify_all();
+    for (std::thread& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+void WorkStealingPool::submit(Task task)
+{
+    size_t queue_index = (t_currentPool == this) ? t_workerIndex : m_nextQueue++ % m_queues.size();
+    m_pendingTasks++;
+    m_queuedTasks++;
+    {
+        std::lock_guard<std::mutex> lock(m_queues[queue_index]->mutex);
+        m_queues[queue_index]->tasks.push_back(std::move(task));
+    }
+    {
+        // Pairs with the predicate check in workerLoop so the wakeup cannot be lost
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+    }
+    m_workAvailable.notify_one();
+}
+
+void WorkStealingPool::wait()
+{
+    std::unique_lock<std::mutex> lock(m_stateMutex);
+    m_allTasksDone.wait(lock, [this] { return m_pendingTasks.load() == 0; });
+}
+
+size_t WorkStealingPool::getThreadCount() const
+{
+    return m_workers.size();
+}
+
+size_t WorkStealingPool::defaultThreadCount()
+{
+    size_t hardware_threads = std::thread::hardware_concurrency();
+    if (hardware_threads == 0)
+    {
+        hardware_threads = 1;
+    }
+    return hardware_threads < K_MaxPoolThreads ? hardware_threads : K_MaxPoolThreads;
+}
+
+void WorkStealingPool::workerLoop(size_t worker_index)
+{
+    t_currentPool = this;
+    t_workerIndex = worker_index;
+
+    while (true)
+    {
+        Task task;
+        if (takeTask(worker_index, task))
+        {
+            try
+            {
+                task();
+            }
+            catch (...)
+            {
+                // Tasks report their own errors; never let one take down the worker
+            }
+            if (--m_pendingTasks == 0)
+            {
+                std::lock_guard<std::mutex> lock(m_stateMutex);
+                m_allTasksDone.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_stateMutex);
+        m_workAvailable.wait(lock, [this] { return m_stopping || m_queuedTasks.load() > 0; });
+        if (m_stopping && m_queuedTasks.load() == 0)
+        {
+            return;
+        }
+    }
+}
+
+bool WorkStealingPool::takeTask(size_t worker_index, Task& task)
+{
+    // Own deque first, newest task (LIFO)
+    {
+        WorkerQueue& own_queue = *m_queues[worker_index];
+        std::lock_guard<std::mutex> lock(own_queue.mutex);
+        if (!own_queue.tasks.empty())
+        {
+            task = std::move(own_queue.tasks.back());
+            own_queue.tasks.pop_back();
+            m_queuedTasks--;
+            return true;
+        }
+    }
+    // Then steal the oldest task from the other workers (FIFO)
+    for (size_t offset = 1; offset < m_queues.size(); ++offset)
+    {
+        WorkerQueue& victim_queue = *m_queues[(worker_index + offset) % m_queues.size()];
+        std::lock_guard<std::mutex> lock(victim_queue.mutex);
+        if (!victim_queue.tasks.empty())
+        {
+            task = std::move(victim_queue.tasks.front());
+            victim_queue.tasks.pop_front();
+            m_queuedTasks--;
+            return true;
+        }
+    }
+    return false;
+}
+
+}